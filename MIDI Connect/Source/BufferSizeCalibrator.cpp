@@ -0,0 +1,198 @@
+//==============================================================================
+
+#include "BufferSizeCalibrator.h"
+
+namespace {
+    const int tickMilliseconds = 50;
+    const int settleTicks = 10;   // After a buffer size change, before timing starts.
+    const int measureTicks = 40;  // How long each buffer size is timed for.
+    const int notesPerTick = 8;   // The stress pattern starts this many notes each tick...
+    const int noteTicks = 8;      // ...and holds them this long, so about 64 sound at once.
+    const int smallestBufferSize = 16;
+    const int largestBufferSize = 2048;
+
+    double now() {
+        return Time::getMillisecondCounterHiRes() / 1000.0;
+    }
+}
+
+BufferSizeCalibrator::BufferSizeCalibrator(AudioDeviceManager& manager, AudioProcessorPlayer& processorPlayer,
+                                           sfzero::SFZeroAudioProcessor& synthProcessor)
+: deviceManager (manager), player (processorPlayer), processor (synthProcessor) {
+}
+
+BufferSizeCalibrator::~BufferSizeCalibrator() {
+    onStatusChanged = nullptr;
+    onFinished = nullptr;
+    cancel();
+}
+
+void BufferSizeCalibrator::start() {
+    auto* device = deviceManager.getCurrentAudioDevice();
+    if (isRunning() || device == nullptr) {
+        return;
+    }
+
+    candidates.clear();
+    for (int size : device->getAvailableBufferSizes()) {
+        if (size >= smallestBufferSize && size <= largestBufferSize) {
+            candidates.addIfNotAlreadyThere(size);
+        }
+    }
+    if (candidates.isEmpty()) {
+        setStatus("The audio device offers no buffer sizes to try.");
+        return;
+    }
+    std::sort(candidates.begin(), candidates.end(), [](int a, int b) { return a > b; });
+
+    originalBufferSize = device->getCurrentBufferSizeSamples();
+    passedBufferSize = 0;
+    step = 0;
+    startTimer(tickMilliseconds);
+    beginStep();
+}
+
+void BufferSizeCalibrator::cancel() {
+    if (!isRunning()) {
+        return;
+    }
+    stopTimer();
+    allNotesOff();
+    setBufferSize(originalBufferSize);
+    setStatus("Calibration cancelled.");
+}
+
+void BufferSizeCalibrator::timerCallback() {
+    auto* device = deviceManager.getCurrentAudioDevice();
+    if (device == nullptr) {
+        finish(passedBufferSize);
+        return;
+    }
+
+    ++ticks;
+    for (int i = heldNotes.size(); --i >= 0;) {
+        if (releaseTicks[i] <= ticks) {
+            MidiMessage message = MidiMessage::noteOff(1, heldNotes[i]);
+            message.setTimeStamp(now());
+            player.getMidiMessageCollector().addMessageToQueue(message);
+            heldNotes.remove(i);
+            releaseTicks.remove(i);
+        }
+    }
+
+    if (ticks == settleTicks) {
+        // The device has restarted with the new size; time it from here.
+        processor.getTelemetry().reset();
+        startXRuns = device->getXRunCount();
+        peakCpuUsage = 0.0;
+    } else if (ticks > settleTicks) {
+        peakCpuUsage = jmax(peakCpuUsage, deviceManager.getCpuUsage());
+    }
+
+    if (ticks >= settleTicks + measureTicks) {
+        endStep();
+    } else {
+        playStressPattern();
+    }
+}
+
+void BufferSizeCalibrator::beginStep() {
+    ticks = 0;
+    setBufferSize(candidates[step]);
+    setStatus("Trying " + String(candidates[step]) + " samples...");
+}
+
+void BufferSizeCalibrator::endStep() {
+    auto* device = deviceManager.getCurrentAudioDevice();
+    int bufferSize = device->getCurrentBufferSizeSamples();
+    double sampleRate = device->getCurrentSampleRate();
+
+    // getXRunCount() is -1 where the device can't tell.
+    int xRunCount = device->getXRunCount();
+    int xRuns = (startXRuns >= 0 && xRunCount >= 0) ? xRunCount - startXRuns : 0;
+
+    sfzero::TelemetrySnapshot snapshot;
+    processor.getTelemetry().getSnapshot(snapshot);
+    double bufferMicros = sampleRate > 0.0 ? bufferSize * 1000000.0 / sampleRate : 0.0;
+    double load = jmax(peakCpuUsage, bufferMicros > 0.0 ? snapshot.blockP99 / bufferMicros : 1.0);
+    bool passed = snapshot.numBlocks > 0 && xRuns == 0 && snapshot.numDeadlineMisses == 0 && load <= safetyMargin;
+    setStatus(String(bufferSize) + " samples: " + String(roundToInt(load * 100.0)) + "% load, "
+              + String(xRuns) + " xruns, " + String((int64) snapshot.numDeadlineMisses) + " late blocks"
+              + (passed ? "" : " - too small"));
+
+    if (!passed) {
+        finish(passedBufferSize);
+        return;
+    }
+    passedBufferSize = bufferSize;
+    if (++step < candidates.size()) {
+        allNotesOff();
+        beginStep();
+    } else {
+        finish(passedBufferSize);
+    }
+}
+
+void BufferSizeCalibrator::finish(int bufferSize) {
+    stopTimer();
+    allNotesOff();
+    setBufferSize(bufferSize > 0 ? bufferSize : originalBufferSize);
+    processor.getTelemetry().reset();
+    auto* device = deviceManager.getCurrentAudioDevice();
+    if (bufferSize > 0 && device != nullptr) {
+        double milliseconds = bufferSize * 1000.0 / jmax(1.0, device->getCurrentSampleRate());
+        setStatus("Chose " + String(bufferSize) + " samples (" + String(milliseconds, 1) + " ms).");
+    } else if (bufferSize > 0) {
+        setStatus("Chose " + String(bufferSize) + " samples.");
+    } else {
+        setStatus("Even " + String(originalBufferSize) + " samples is too small; kept it.");
+    }
+    if (onFinished) {
+        onFinished(bufferSize);
+    }
+}
+
+void BufferSizeCalibrator::playStressPattern() {
+    // Chords spread over the keyboard, moving up a little each tick, at
+    // varying velocities.
+    for (int i = 0; i < notesPerTick; ++i) {
+        int note = 21 + (ticks * 5 + i * 11) % 88;
+        if (heldNotes.contains(note)) {
+            continue;
+        }
+        MidiMessage message = MidiMessage::noteOn(1, note, (uint8) (40 + (ticks * 13 + i * 7) % 80));
+        message.setTimeStamp(now());
+        player.getMidiMessageCollector().addMessageToQueue(message);
+        heldNotes.add(note);
+        releaseTicks.add(ticks + noteTicks);
+    }
+}
+
+void BufferSizeCalibrator::allNotesOff() {
+    for (int note : heldNotes) {
+        MidiMessage message = MidiMessage::noteOff(1, note);
+        message.setTimeStamp(now());
+        player.getMidiMessageCollector().addMessageToQueue(message);
+    }
+    heldNotes.clear();
+    releaseTicks.clear();
+}
+
+void BufferSizeCalibrator::setBufferSize(int bufferSize) {
+    AudioDeviceManager::AudioDeviceSetup setup;
+    deviceManager.getAudioDeviceSetup(setup);
+    if (setup.bufferSize == bufferSize) {
+        return;
+    }
+    setup.bufferSize = bufferSize;
+    auto error = deviceManager.setAudioDeviceSetup(setup, true);
+    // If you hit this the device refused a buffer size it said it offered.
+    jassert(error.isEmpty());
+}
+
+void BufferSizeCalibrator::setStatus(const String& newStatus) {
+    status = newStatus;
+    if (onStatusChanged) {
+        onStatusChanged();
+    }
+}
@@ -0,0 +1,97 @@
+//==============================================================================
+/// @file BufferSizeCalibrator.h
+/// Finds the smallest audio buffer size the synth can run at without dropouts.
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "SFZeroAudioProcessor.h"
+
+/// Plays a stress pattern (dense, overlapping chords across the keyboard)
+/// through the SFZeroAudioProcessor at each buffer size the audio device
+/// offers, largest first, and picks the smallest one that passed. A size
+/// passes if, while it played, the device reported no xruns, no block missed
+/// its deadline, and both the device's CPU usage and the slowest 1% of
+/// blocks stayed within the safety margin of the time a buffer lasts.
+/// Calibration stops at the first size that fails, since smaller ones would
+/// only do worse.
+///
+/// Runs on the message thread, driven by a Timer, so the app stays usable
+/// while it works. Each step changes the device's buffer size through the
+/// AudioDeviceManager; when it finishes, the chosen size is left selected,
+/// or the original one restored if none passed.
+struct BufferSizeCalibrator : private Timer {
+
+  /// The calibrator plays "processor" through "player", which must already
+  /// be the callback of "deviceManager".
+  BufferSizeCalibrator(AudioDeviceManager& deviceManager, AudioProcessorPlayer& player,
+                       sfzero::SFZeroAudioProcessor& processor);
+
+  /// Destructor. Stops any calibration, restoring the original buffer size.
+  ~BufferSizeCalibrator();
+
+  /// Starts calibrating. Does nothing if it's already running or there's no
+  /// open audio device.
+  void start();
+
+  /// Stops calibrating and restores the buffer size from before it started.
+  void cancel();
+
+  bool isRunning() const { return isTimerRunning(); }
+
+  /// A line of text describing what the calibration is doing or found.
+  String getStatus() const { return status; }
+
+  /// Called on the message thread whenever the status changes.
+  std::function<void()> onStatusChanged;
+
+  /// Called on the message thread when calibration finishes with the buffer
+  /// size it chose, or zero if it chose none.
+  std::function<void(int bufferSize)> onFinished;
+
+  /// The fraction of a buffer's duration the synth may take and still pass.
+  static constexpr double safetyMargin = 0.6;
+
+private:
+
+  void timerCallback() override;
+
+  /// Switches the device to candidates[step] and starts timing it.
+  void beginStep();
+
+  /// Judges the current step, then moves on or finishes.
+  void endStep();
+
+  /// Releases the stress pattern's notes and selects "bufferSize" (if not
+  /// zero, the original otherwise).
+  void finish(int bufferSize);
+
+  /// Adds the stress pattern's notes for this tick to the player's queue.
+  void playStressPattern();
+  void allNotesOff();
+  void setBufferSize(int bufferSize);
+  void setStatus(const String& newStatus);
+
+  AudioDeviceManager& deviceManager;
+  AudioProcessorPlayer& player;
+  sfzero::SFZeroAudioProcessor& processor;
+
+  /// Buffer sizes to try, largest first.
+  Array<int> candidates;
+  int step = 0;
+  int originalBufferSize = 0;
+  int passedBufferSize = 0;
+
+  /// Timer ticks since the step began; the first few let the device settle.
+  int ticks = 0;
+  int startXRuns = 0;
+  double peakCpuUsage = 0.0;
+
+  /// Stress pattern notes sounding, with the tick each is released at.
+  Array<int> heldNotes, releaseTicks;
+
+  String status;
+
+  //==============================================================================
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (BufferSizeCalibrator)
+};
@@ -34,6 +34,19 @@ AudioDeviceManager& MainApplication::getAudioDeviceManager() {
   return audioDeviceManager;
 }
 
+PropertiesFile& MainApplication::getSettings() {
+  return *appProperties.getUserSettings();
+}
+
+void MainApplication::saveAudioDeviceState() {
+    std::unique_ptr<XmlElement> state (audioDeviceManager.createStateXml());
+    // Null if the setup was never explicitly chosen.
+    if (state != nullptr) {
+        getSettings().setValue("audioDeviceState", state.get());
+        getSettings().saveIfNeeded();
+    }
+}
+
 void MainApplication::closeAllAlertAndDialogWindows() {
     // delete any open alert or dialog windows.
     Desktop& desktop = Desktop::getInstance();
@@ -78,8 +91,15 @@ bool MainApplication::moreThanOneInstanceAllowed() {
 }
 
 void MainApplication::initialise(const String& commandLine) {
-    // initialize the audio device manager
-    auto errors = audioDeviceManager.initialise(0, 2, nullptr, true);
+    // Open the settings file.
+    PropertiesFile::Options options;
+    options.applicationName = getApplicationName();
+    options.filenameSuffix = "settings";
+    options.osxLibrarySubFolder = "Application Support";
+    appProperties.setStorageParameters(options);
+    // initialize the audio device manager with the setup saved last time, if any
+    std::unique_ptr<XmlElement> savedState (getSettings().getXmlValue("audioDeviceState"));
+    auto errors = audioDeviceManager.initialise(0, 2, savedState.get(), true);
     // use jassert to ensure audioError is empty
     jassert(errors.isEmpty());
     // Create the application window.
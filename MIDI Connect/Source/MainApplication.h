@@ -28,7 +28,7 @@ public:
   /// The application's initialization code. Your method should take
   /// the following actions:
   /// * Initialize the audio device manager with no audio inputs and
-  ///   two audio outputs.
+  ///   two audio outputs, restoring the setup saved in the settings file.
   /// * Create the application window.
   void initialise (const String& commandLine) override;
 
@@ -67,11 +67,23 @@ public:
   /// Returns our AudioDeviceManager
   AudioDeviceManager& getAudioDeviceManager();
 
+  /// Returns the app's settings file, kept in the user's application data
+  /// directory.
+  PropertiesFile& getSettings();
+
+  /// Saves the audio device manager's current setup (device, sample rate and
+  /// buffer size) in the settings file. initialise() restores it when the
+  /// app next starts.
+  void saveAudioDeviceState();
+
 private:
 
   /// Manages Audio/MIDI system settings.
   AudioDeviceManager audioDeviceManager;
 
+  /// Holds the app's settings file.
+  ApplicationProperties appProperties;
+
   /// Close any open alert or dialog windows. See: Wave Lab.app
   void closeAllAlertAndDialogWindows();
 
@@ -3,6 +3,61 @@
 #include "MainComponent.h"
 #include "MainApplication.h"
 
+namespace {
+    /// The audio settings dialog's content: the device settings, and below
+    /// them a button that starts (or cancels) buffer size calibration beside
+    /// a line showing how it's going.
+    struct AudioSettingsComponent : public Component, public Button::Listener {
+        AudioSettingsComponent(AudioDeviceManager& manager, BufferSizeCalibrator& bufferSizeCalibrator)
+        : selector (manager, 0, 2, 0, 2, true, false, true, false), calibrator (bufferSizeCalibrator) {
+            addAndMakeVisible(selector);
+            addAndMakeVisible(calibrateButton);
+            addAndMakeVisible(statusLabel);
+            calibrateButton.addListener(this);
+            calibrator.onStatusChanged = [this]() { update(); };
+            update();
+            setSize(500, 540);
+        }
+
+        ~AudioSettingsComponent() {
+            calibrator.onStatusChanged = nullptr;
+            calibrateButton.removeListener(this);
+            // A calibration still running saves its own result when it's done.
+            if (!calibrator.isRunning()) {
+                MainApplication::getApp().saveAudioDeviceState();
+            }
+        }
+
+        void resized() override {
+            auto area = getLocalBounds().reduced(8, 8);
+            auto bottomLine = area.removeFromBottom(24);
+            calibrateButton.setBounds(bottomLine.removeFromLeft(160));
+            statusLabel.setBounds(bottomLine.withTrimmedLeft(8));
+            selector.setBounds(area.withTrimmedBottom(8));
+        }
+
+        void buttonClicked(Button*) override {
+            if (calibrator.isRunning()) {
+                calibrator.cancel();
+            } else {
+                calibrator.start();
+            }
+        }
+
+        void update() {
+            calibrateButton.setButtonText(calibrator.isRunning() ? "Cancel" : "Calibrate Buffer Size");
+            statusLabel.setText(calibrator.getStatus().isNotEmpty() ? calibrator.getStatus()
+                                : "Finds the smallest buffer size that plays without dropouts.",
+                                dontSendNotification);
+        }
+
+        AudioDeviceSelectorComponent selector;
+        TextButton calibrateButton;
+        Label statusLabel;
+        BufferSizeCalibrator& calibrator;
+    };
+}
+
 MainContentComponent::MainContentComponent()
 : audioManager (MainApplication::getApp().getAudioDeviceManager()) {
     addAndMakeVisible(messageLogButton);
@@ -44,11 +99,21 @@ MainContentComponent::MainContentComponent()
     // Add the sfZeroPlayer as the audio callback for our audio device manager.
     audioManager.addAudioCallback(&sfZeroPlayer);
     
+    // Calibration plays through the sfZeroPlayer; the buffer size it chooses is saved with the audio device state.
+    bufferSizeCalibrator = std::make_unique<BufferSizeCalibrator>(audioManager, sfZeroPlayer, *sfZeroAudioProcessor);
+    bufferSizeCalibrator->onFinished = [](int bufferSize) {
+        if (bufferSize > 0) {
+            MainApplication::getApp().saveAudioDeviceState();
+        }
+    };
+    
     auto soundFont = MainApplication::getApp().getRuntimeResourceDirectory().getChildFile("G800-A112-Piano1d-2-3f.sfz");
     loadSoundFont(soundFont);
 }
 
 MainContentComponent::~MainContentComponent() {
+    bufferSizeCalibrator = nullptr;
+    
     keyboardState.removeListener(this);
     
     audioManager.removeMidiInputDeviceCallback("", this);
@@ -201,12 +266,11 @@ void MainContentComponent::loadSoundFont(juce::File& fontFile) {
 }
 
 void MainContentComponent::openAudioSettings() {
-    auto devcomp = std::make_unique<AudioDeviceSelectorComponent>(audioManager, 0, 2, 0, 2, true, false, true, false);
-    devcomp->setBounds(0, 0, 500, 500);
+    auto content = std::make_unique<AudioSettingsComponent>(audioManager, *bufferSizeCalibrator);
     
     DialogWindow::LaunchOptions opt;
     opt.dialogTitle = "Audio Settings";
     opt.dialogBackgroundColour = getLookAndFeel().findColour(ResizableWindow::backgroundColourId);
-    opt.content.setOwned(devcomp.release());
+    opt.content.setOwned(content.release());
     opt.launchAsync();
 }
@@ -9,6 +9,7 @@
 #include "MidiMessageLog.h"
 #include "MidiPianoRoll.h"
 #include "SFZeroAudioProcessor.h"
+#include "BufferSizeCalibrator.h"
 
 /// Inherits from several Listener classes so it can respond
 /// to users manipulating subcomponent buttons, menus etc. It also inherits from
@@ -40,9 +41,12 @@ public MidiKeyboardStateListener {
   /// "G800-A112-Piano1d-2-3f.sfz". This file is stored in the the app's
   /// resource directory. See: MainApplication::getRuntimeResourceDirectory().
   /// * Call the loadSoundFont() function to load the sound font resource.
+  /// * Create the bufferSizeCalibrator, saving the audio setup whenever it
+  /// chooses a buffer size.
   MainContentComponent();
   
   /// Destructor. Your method should take the following actions:
+  /// * Delete the bufferSizeCalibrator, which stops any calibration.
   /// * Remove this component as keyboard states listener.
   /// * Remove sfzeroplayer as the audio device managers's callback.
   /// audioManager.removeMidiInputCallback("", this);
@@ -148,6 +152,9 @@ private:
   /// Open the audio settings dialog. The dialog should not
   /// show audio inputs and outputs because our device manager
   /// does not enable them. See the WaveLab app for more information.
+  /// Below the device settings is a button that runs the
+  /// bufferSizeCalibrator, and a line showing its progress. The audio
+  /// setup is saved when the dialog closes.
   void openAudioSettings();
 
   /// A button that displays "Audio Settings...".
@@ -183,6 +190,9 @@ private:
   /// An audio processor player to play the SFZeroAudioProcessor
   AudioProcessorPlayer sfZeroPlayer;
 
+  /// Finds the smallest buffer size the synth plays at without dropouts.
+  std::unique_ptr<BufferSizeCalibrator> bufferSizeCalibrator;
+
   /// The currently open MIDI output device. Currently null;
   std::unique_ptr<MidiOutput> midiOutputDevice;
 
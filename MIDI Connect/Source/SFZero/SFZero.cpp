@@ -8,11 +8,25 @@
 #include "sfzero/SF2Generator.cpp" 
 #include "sfzero/SF2Reader.cpp" 
 #include "sfzero/SF2Sound.cpp" 
-#include "sfzero/SFZDebug.cpp" 
+#include "sfzero/SFZCompressedSample.cpp" 
+#include "sfzero/SFZDecodeCache.cpp" 
+#include "sfzero/SFZDiagnosticsThread.cpp" 
 #include "sfzero/SFZEG.cpp" 
+#include "sfzero/SFZLog.cpp" 
+#include "sfzero/SFZModulation.cpp" 
+#include "sfzero/SFZParseCache.cpp" 
+#include "sfzero/SFZPCM.cpp" 
+#include "sfzero/SFZPortableMath.cpp" 
+#include "sfzero/SFZProgramBank.cpp" 
 #include "sfzero/SFZReader.cpp" 
+#include "sfzero/SFZRealtimeCheck.cpp" 
 #include "sfzero/SFZRegion.cpp" 
+#include "sfzero/SFZResidencyManager.cpp" 
 #include "sfzero/SFZSample.cpp" 
+#include "sfzero/SFZSampleArena.cpp" 
 #include "sfzero/SFZSound.cpp" 
+#include "sfzero/SFZSoundReport.cpp" 
 #include "sfzero/SFZSynth.cpp" 
+#include "sfzero/SFZTelemetry.cpp" 
+#include "sfzero/SFZTrace.cpp" 
 #include "sfzero/SFZVoice.cpp" 
@@ -14,6 +14,14 @@ END_JUCE_MODULE_DECLARATION
 #ifndef INCLUDED_SFZERO_H
 #define INCLUDED_SFZERO_H
 
+/** Config: SFZERO_REALTIME_CHECKS
+    Enables sfzero::RealtimeCheck, which records allocations, locks and blocking calls made on the audio thread.
+    For debug and CI builds only: it replaces the allocator and, on Linux, some system calls.
+*/
+#ifndef SFZERO_REALTIME_CHECKS
+#define SFZERO_REALTIME_CHECKS 0
+#endif
+
 #include "sfzero/RIFF.h"
 #include "sfzero/SF2.h"
 #include "sfzero/SF2Generator.h"
@@ -21,13 +29,27 @@ END_JUCE_MODULE_DECLARATION
 #include "sfzero/SF2Sound.h"
 #include "sfzero/SF2WinTypes.h"
 #include "sfzero/SFZCommon.h"
-#include "sfzero/SFZDebug.h"
+#include "sfzero/SFZCompressedSample.h"
+#include "sfzero/SFZDecodeCache.h"
+#include "sfzero/SFZDiagnosticsThread.h"
 #include "sfzero/SFZEG.h"
+#include "sfzero/SFZLog.h"
+#include "sfzero/SFZModulation.h"
+#include "sfzero/SFZParseCache.h"
+#include "sfzero/SFZPCM.h"
+#include "sfzero/SFZPortableMath.h"
+#include "sfzero/SFZProgramBank.h"
 #include "sfzero/SFZReader.h"
+#include "sfzero/SFZRealtimeCheck.h"
 #include "sfzero/SFZRegion.h"
+#include "sfzero/SFZResidencyManager.h"
 #include "sfzero/SFZSample.h"
+#include "sfzero/SFZSampleArena.h"
 #include "sfzero/SFZSound.h"
+#include "sfzero/SFZSoundReport.h"
 #include "sfzero/SFZSynth.h"
+#include "sfzero/SFZTelemetry.h"
+#include "sfzero/SFZTrace.h"
 #include "sfzero/SFZVoice.h"
 
 
@@ -6,6 +6,7 @@
  *************************************************************************************/
 #include "SF2.h"
 #include "RIFF.h"
+#include "SF2Generator.h"
 
 #define readAbyte(name, file) name = (byte)file->readByte();
 #define readAchar(name, file) name = file->readByte();
@@ -22,47 +23,70 @@ void sfzero::SF2::iver::readFrom(juce::InputStream *file)
 #include "sf2-chunks/iver.h"
 }
 
-void sfzero::SF2::phdr::readFrom(juce::InputStream *file)
+#undef SF2Field
+
+// SF2 files are little-endian.
+#define decodeAbyte(name) name = *data++;
+#define decodeAchar(name) name = static_cast<char>(*data++);
+#define decodeAdword(name)                                                                                                     \
+  name = juce::ByteOrder::littleEndianInt(data);                                                                               \
+  data += 4;
+#define decodeAword(name)                                                                                                      \
+  name = juce::ByteOrder::littleEndianShort(data);                                                                             \
+  data += 2;
+#define decodeAshort(name)                                                                                                     \
+  name = static_cast<short>(juce::ByteOrder::littleEndianShort(data));                                                         \
+  data += 2;
+#define decodeAchar20(name)                                                                                                    \
+  memcpy(name, data, 20);                                                                                                      \
+  data += 20;
+#define decodeAgenAmountType(name)                                                                                             \
+  name.shortAmount = static_cast<short>(juce::ByteOrder::littleEndianShort(data));                                             \
+  data += 2;
+
+#define SF2Field(type, name) decodeA##type(name)
+
+void sfzero::SF2::phdr::decode(const juce::uint8 *data)
 {
 #include "sf2-chunks/phdr.h"
 }
 
-void sfzero::SF2::pbag::readFrom(juce::InputStream *file)
+void sfzero::SF2::pbag::decode(const juce::uint8 *data)
 {
 #include "sf2-chunks/pbag.h"
 }
 
-void sfzero::SF2::pmod::readFrom(juce::InputStream *file)
+void sfzero::SF2::pmod::decode(const juce::uint8 *data)
 {
 #include "sf2-chunks/pmod.h"
 }
 
-void sfzero::SF2::pgen::readFrom(juce::InputStream *file)
+void sfzero::SF2::pgen::decode(const juce::uint8 *data)
 {
 #include "sf2-chunks/pgen.h"
 }
 
-void sfzero::SF2::inst::readFrom(juce::InputStream *file)
+void sfzero::SF2::inst::decode(const juce::uint8 *data)
 {
 #include "sf2-chunks/inst.h"
 }
 
-void sfzero::SF2::ibag::readFrom(juce::InputStream *file)
+void sfzero::SF2::ibag::decode(const juce::uint8 *data)
 {
 #include "sf2-chunks/ibag.h"
 }
 
-void sfzero::SF2::imod::readFrom(juce::InputStream *file)
+void sfzero::SF2::imod::decode(const juce::uint8 *data)
 {
 #include "sf2-chunks/imod.h"
 }
 
-void sfzero::SF2::igen::readFrom(juce::InputStream *file)
+void sfzero::SF2::igen::decode(const juce::uint8 *data)
 {
 #include "sf2-chunks/igen.h"
 }
 
-void sfzero::SF2::shdr::readFrom(juce::InputStream *file)
+void sfzero::SF2::shdr::decode(const juce::uint8 *data)
 {
 #include "sf2-chunks/shdr.h"
 }
@@ -75,38 +99,43 @@ sfzero::SF2::Hydra::Hydra()
 }
 sfzero::SF2::Hydra::~Hydra()
 {
-  delete phdrItems;
-  delete pbagItems;
-  delete pmodItems;
-  delete pgenItems;
-  delete instItems;
-  delete ibagItems;
-  delete imodItems;
-  delete igenItems;
-  delete shdrItems;
+  delete[] phdrItems;
+  delete[] pbagItems;
+  delete[] pmodItems;
+  delete[] pgenItems;
+  delete[] instItems;
+  delete[] ibagItems;
+  delete[] imodItems;
+  delete[] igenItems;
+  delete[] shdrItems;
 }
 
 void sfzero::SF2::Hydra::readFrom(juce::InputStream *file, juce::int64 pdtaChunkEnd)
 {
-  int i, numItems;
-
-#define HandleChunk(chunkName)                                                                                                   \
-  if (FourCCEquals(chunk.id, #chunkName))                                                                                        \
-  {                                                                                                                              \
-    numItems = chunk.size / SF2::chunkName::sizeInFile;                                                                          \
-    chunkName##NumItems = numItems;                                                                                              \
-    chunkName##Items = new SF2::chunkName[numItems];                                                                             \
-    for (i = 0; i < numItems; ++i)                                                                                               \
-    {                                                                                                                            \
-      chunkName##Items[i].readFrom(file);                                                                                        \
-    }                                                                                                                            \
-  }                                                                                                                              \
+  juce::MemoryBlock data;
+
+  // A truncated chunk only yields the records that were read in full.
+#define HandleChunk(chunkName)                                                                                                 \
+  if (FourCCEquals(chunk.id, #chunkName))                                                                                      \
+  {                                                                                                                            \
+    int numItems = file->read(data.getData(), static_cast<int>(size)) / SF2::chunkName::sizeInFile;                            \
+    delete[] chunkName##Items;                                                                                                 \
+    chunkName##NumItems = numItems;                                                                                            \
+    chunkName##Items = new SF2::chunkName[numItems];                                                                           \
+    const juce::uint8 *item = static_cast<const juce::uint8 *>(data.getData());                                                \
+    for (int i = 0; i < numItems; ++i, item += SF2::chunkName::sizeInFile)                                                     \
+    {                                                                                                                          \
+      chunkName##Items[i].decode(item);                                                                                        \
+    }                                                                                                                          \
+  }                                                                                                                            \
   else
 
   while (file->getPosition() < pdtaChunkEnd)
   {
     sfzero::RIFFChunk chunk;
     chunk.readFrom(file);
+    juce::int64 size = juce::jmax(static_cast<juce::int64>(0), juce::jmin(static_cast<juce::int64>(chunk.size), pdtaChunkEnd - chunk.start));
+    data.ensureSize(static_cast<size_t>(size));
 
     HandleChunk(phdr) HandleChunk(pbag) HandleChunk(pmod) HandleChunk(pgen) HandleChunk(inst) HandleChunk(ibag) HandleChunk(imod)
         HandleChunk(igen) HandleChunk(shdr)
@@ -114,9 +143,72 @@ void sfzero::SF2::Hydra::readFrom(juce::InputStream *file, juce::int64 pdtaChunk
     }
     chunk.seekAfter(file);
   }
+
+#undef HandleChunk
 }
 
 bool sfzero::SF2::Hydra::isComplete()
 {
   return phdrItems && pbagItems && pmodItems && pgenItems && instItems && ibagItems && imodItems && igenItems && shdrItems;
 }
+
+juce::String sfzero::SF2::Hydra::validate()
+{
+  // Every list ends with a terminal record, whose index marks the end of the
+  // previous record's range.
+  if ((phdrNumItems < 1) || (pbagNumItems < 1) || (pmodNumItems < 1) || (pgenNumItems < 1) || (instNumItems < 1) ||
+      (ibagNumItems < 1) || (imodNumItems < 1) || (igenNumItems < 1) || (shdrNumItems < 1))
+  {
+    return "empty list in pdta chunk";
+  }
+
+  for (int i = 0; i < phdrNumItems; ++i)
+  {
+    if ((phdrItems[i].presetBagNdx >= pbagNumItems) ||
+        ((i + 1 < phdrNumItems) && (phdrItems[i + 1].presetBagNdx < phdrItems[i].presetBagNdx)))
+    {
+      return "bad preset bag index";
+    }
+  }
+  for (int i = 0; i < pbagNumItems; ++i)
+  {
+    if ((pbagItems[i].genNdx >= pgenNumItems) || (pbagItems[i].modNdx >= pmodNumItems) ||
+        ((i + 1 < pbagNumItems) &&
+         ((pbagItems[i + 1].genNdx < pbagItems[i].genNdx) || (pbagItems[i + 1].modNdx < pbagItems[i].modNdx))))
+    {
+      return "bad preset generator index";
+    }
+  }
+  for (int i = 0; i + 1 < pgenNumItems; ++i)
+  {
+    if ((pgenItems[i].genOper == SF2Generator::instrument) && (pgenItems[i].genAmount.wordAmount >= instNumItems - 1))
+    {
+      return "bad instrument index";
+    }
+  }
+  for (int i = 0; i < instNumItems; ++i)
+  {
+    if ((instItems[i].instBagNdx >= ibagNumItems) ||
+        ((i + 1 < instNumItems) && (instItems[i + 1].instBagNdx < instItems[i].instBagNdx)))
+    {
+      return "bad instrument bag index";
+    }
+  }
+  for (int i = 0; i < ibagNumItems; ++i)
+  {
+    if ((ibagItems[i].instGenNdx >= igenNumItems) || (ibagItems[i].instModNdx >= imodNumItems) ||
+        ((i + 1 < ibagNumItems) &&
+         ((ibagItems[i + 1].instGenNdx < ibagItems[i].instGenNdx) || (ibagItems[i + 1].instModNdx < ibagItems[i].instModNdx))))
+    {
+      return "bad instrument generator index";
+    }
+  }
+  for (int i = 0; i + 1 < igenNumItems; ++i)
+  {
+    if ((igenItems[i].genOper == SF2Generator::sampleID) && (igenItems[i].genAmount.wordAmount >= shdrNumItems - 1))
+    {
+      return "bad sample index";
+    }
+  }
+  return juce::String();
+}
@@ -37,7 +37,7 @@ struct iver
 struct phdr
 {
 #include "sf2-chunks/phdr.h"
-  void readFrom(juce::InputStream *file);
+  void decode(const juce::uint8 *data);
 
   static const int sizeInFile = 38;
 };
@@ -45,7 +45,7 @@ struct phdr
 struct pbag
 {
 #include "sf2-chunks/pbag.h"
-  void readFrom(juce::InputStream *file);
+  void decode(const juce::uint8 *data);
 
   static const int sizeInFile = 4;
 };
@@ -53,7 +53,7 @@ struct pbag
 struct pmod
 {
 #include "sf2-chunks/pmod.h"
-  void readFrom(juce::InputStream *file);
+  void decode(const juce::uint8 *data);
 
   static const int sizeInFile = 10;
 };
@@ -61,7 +61,7 @@ struct pmod
 struct pgen
 {
 #include "sf2-chunks/pgen.h"
-  void readFrom(juce::InputStream *file);
+  void decode(const juce::uint8 *data);
 
   static const int sizeInFile = 4;
 };
@@ -69,7 +69,7 @@ struct pgen
 struct inst
 {
 #include "sf2-chunks/inst.h"
-  void readFrom(juce::InputStream *file);
+  void decode(const juce::uint8 *data);
 
   static const int sizeInFile = 22;
 };
@@ -77,7 +77,7 @@ struct inst
 struct ibag
 {
 #include "sf2-chunks/ibag.h"
-  void readFrom(juce::InputStream *file);
+  void decode(const juce::uint8 *data);
 
   static const int sizeInFile = 4;
 };
@@ -85,7 +85,7 @@ struct ibag
 struct imod
 {
 #include "sf2-chunks/imod.h"
-  void readFrom(juce::InputStream *file);
+  void decode(const juce::uint8 *data);
 
   static const int sizeInFile = 10;
 };
@@ -93,7 +93,7 @@ struct imod
 struct igen
 {
 #include "sf2-chunks/igen.h"
-  void readFrom(juce::InputStream *file);
+  void decode(const juce::uint8 *data);
 
   static const int sizeInFile = 4;
 };
@@ -101,9 +101,11 @@ struct igen
 struct shdr
 {
 #include "sf2-chunks/shdr.h"
-  void readFrom(juce::InputStream *file);
+  void decode(const juce::uint8 *data);
 
   static const int sizeInFile = 46;
+  // Set in sampleType for an SF3 file's samples, which are Ogg Vorbis.
+  static const word oggVorbis = 0x10;
 };
 
 struct Hydra
@@ -125,8 +127,13 @@ struct Hydra
   Hydra();
   ~Hydra();
 
+  // Reads each sub-chunk of the "pdta" chunk in one go and decodes it from
+  // memory.
   void readFrom(juce::InputStream *file, juce::int64 pdtaChunkEnd);
   bool isComplete();
+  // Checks that every index the reader will follow stays within its array;
+  // returns what's wrong, or an empty string.
+  juce::String validate();
 };
 }
 }
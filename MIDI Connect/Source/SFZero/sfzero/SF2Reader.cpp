@@ -9,6 +9,9 @@
 #include "SF2.h"
 #include "SF2Generator.h"
 #include "SF2Sound.h"
+#include "SFZModulation.h"
+#include "SFZPCM.h"
+#include "SFZSampleArena.h"
 
 sfzero::SF2Reader::SF2Reader(sfzero::SF2Sound *soundIn, const juce::File &fileIn) : sound_(soundIn)
 {
@@ -46,6 +49,20 @@ void sfzero::SF2Reader::read()
     sound_->addError("Invalid SF2 file (missing or incomplete hydra).");
     return;
   }
+  juce::String problem = hydra.validate();
+  if (problem.isNotEmpty())
+  {
+    sound_->addError("Invalid SF2 file (" + problem + ").");
+    return;
+  }
+  for (int i = 0; i < hydra.shdrNumItems - 1; ++i)
+  {
+    if (hydra.shdrItems[i].sampleType & sfzero::SF2::shdr::oggVorbis)
+    {
+      sound_->setIsSF3(true);
+      break;
+    }
+  }
 
   // Read each preset.
   for (int whichPreset = 0; whichPreset < hydra.phdrNumItems - 1; ++whichPreset)
@@ -55,16 +72,32 @@ void sfzero::SF2Reader::read()
     sound_->addPreset(preset);
 
     // Zones.
-    //*** TODO: Handle global zone (modulators only).
+    //*** TODO: Handle global zone generators.
+    sfzero::ModulationProgram presetGlobalModulation;
     int zoneEnd = phdr[1].presetBagNdx;
     for (int whichZone = phdr->presetBagNdx; whichZone < zoneEnd; ++whichZone)
     {
       sfzero::SF2::pbag *pbag = &hydra.pbagItems[whichZone];
-      sfzero::Region presetRegion;
+      sfzero::RegionDescription presetRegion;
       presetRegion.clearForRelativeSF2();
+      int genEnd = pbag[1].genNdx;
+
+      // Modulators.  Those of the global zone (the first, if it has no
+      // instrument) apply to the other zones unless they replace them.
+      sfzero::ModulationProgram presetModulation = presetGlobalModulation;
+      for (int whichMod = pbag->modNdx; whichMod < pbag[1].modNdx; ++whichMod)
+      {
+        sfzero::SF2::pmod *pmod = &hydra.pmodItems[whichMod];
+        addModulator(pmod->modSrcOper, pmod->modDestOper, pmod->modAmount, pmod->modAmtSrcOper, pmod->modTransOper,
+                     &presetModulation);
+      }
+      if ((whichZone == phdr->presetBagNdx) &&
+          ((genEnd == pbag->genNdx) || (hydra.pgenItems[genEnd - 1].genOper != sfzero::SF2Generator::instrument)))
+      {
+        presetGlobalModulation = presetModulation;
+      }
 
       // Generators.
-      int genEnd = pbag[1].genNdx;
       for (int whichGen = pbag->genNdx; whichGen < genEnd; ++whichGen)
       {
         sfzero::SF2::pgen *pgen = &hydra.pgenItems[whichGen];
@@ -73,9 +106,9 @@ void sfzero::SF2Reader::read()
         if (pgen->genOper == sfzero::SF2Generator::instrument)
         {
           sfzero::word whichInst = pgen->genAmount.wordAmount;
-          if (whichInst < hydra.instNumItems)
+          if (whichInst < hydra.instNumItems - 1)
           {
-            sfzero::Region instRegion;
+            sfzero::RegionDescription instRegion;
             instRegion.clearForSF2();
             // Preset generators are supposed to be "relative" modifications of
             // the instrument settings, but that makes no sense for ranges.
@@ -86,6 +119,9 @@ void sfzero::SF2Reader::read()
             instRegion.lovel = presetRegion.lovel;
             instRegion.hivel = presetRegion.hivel;
 
+            sfzero::ModulationProgram instGlobalModulation;
+            instGlobalModulation.setDefaults();
+
             sfzero::SF2::inst *inst = &hydra.instItems[whichInst];
             int firstZone = inst->instBagNdx;
             int zoneEnd2 = inst[1].instBagNdx;
@@ -93,8 +129,18 @@ void sfzero::SF2Reader::read()
             {
               sfzero::SF2::ibag *ibag = &hydra.ibagItems[whichZone2];
 
+              // Modulators.  The zone's replace identical ones from the
+              // global zone, which replace the defaults.
+              sfzero::ModulationProgram zoneModulation = instGlobalModulation;
+              for (int whichMod = ibag->instModNdx; whichMod < ibag[1].instModNdx; ++whichMod)
+              {
+                sfzero::SF2::imod *imod = &hydra.imodItems[whichMod];
+                addModulator(imod->modSrcOper, imod->modDestOper, imod->modAmount, imod->modAmtSrcOper,
+                             imod->modTransOper, &zoneModulation);
+              }
+
               // Generators.
-              sfzero::Region zoneRegion = instRegion;
+              sfzero::RegionDescription zoneRegion = instRegion;
               bool hadSampleID = false;
               int genEnd2 = ibag[1].instGenNdx;
               for (int whichGen2 = ibag->instGenNdx; whichGen2 < genEnd2; ++whichGen2)
@@ -120,6 +166,17 @@ void sfzero::SF2Reader::read()
                   }
                   zoneRegion.tune += shdr->pitchCorrection;
 
+                  // The preset's modulators add to the instrument's.  The
+                  // default ones take over velocity and pitch bend.
+                  sfzero::ModulationProgram modulation = zoneModulation;
+                  for (int i = 0; i < presetModulation.getNumModulators(); ++i)
+                  {
+                    modulation.add(presetModulation.getModulators()[i], true);
+                  }
+                  zoneRegion.modulation = sound_->internModulation(modulation);
+                  zoneRegion.amp_veltrack = 0.0f;
+                  zoneRegion.bend_up = zoneRegion.bend_down = 0;
+
                   // Pin initialAttenuation to max +6dB.
                   if (zoneRegion.volume > 6.0)
                   {
@@ -127,10 +184,37 @@ void sfzero::SF2Reader::read()
                     sound_->addUnsupportedOpcode("extreme gain in initialAttenuation");
                   }
 
-                  sfzero::Region *newRegion = new sfzero::Region();
-                  *newRegion = zoneRegion;
-                  newRegion->sample = sound_->sampleFor(shdr->sampleRate);
-                  preset->addRegion(newRegion);
+                  if (shdr->sampleType & sfzero::SF2::shdr::oggVorbis)
+                  {
+                    // SF3: "start" and "end" locate the compressed data,
+                    // and the loop is already relative to the sample.  The
+                    // decoded length isn't known yet, so play to its end.
+                    juce::int64 start = shdr->start;
+                    zoneRegion.offset = juce::jmax(static_cast<juce::int64>(0), zoneRegion.offset - start);
+                    zoneRegion.end = 0;
+                    juce::int64 numBytes = static_cast<juce::int64>(shdr->end) - start;
+                    zoneRegion.sample = sound_->sampleFor(whichSample, shdr->sampleRate, start, numBytes, true);
+                  }
+                  else if (sound_->readsSamplesSeparately())
+                  {
+                    // The sample is read by itself, so positions are
+                    // relative to its start.
+                    juce::int64 start = shdr->start;
+                    juce::int64 length = juce::jmax(static_cast<juce::int64>(0), static_cast<juce::int64>(shdr->end) - start);
+                    auto inSample = [start, length](juce::int64 position) {
+                      return juce::jlimit(static_cast<juce::int64>(0), length, position - start);
+                    };
+                    zoneRegion.offset = inSample(zoneRegion.offset);
+                    zoneRegion.end = inSample(zoneRegion.end);
+                    zoneRegion.loop_start = inSample(zoneRegion.loop_start);
+                    zoneRegion.loop_end = inSample(zoneRegion.loop_end);
+                    zoneRegion.sample = sound_->sampleFor(whichSample, shdr->sampleRate, start, length, false);
+                  }
+                  else
+                  {
+                    zoneRegion.sample = sound_->sampleFor(shdr->sampleRate);
+                  }
+                  preset->addRegion(sound_->makeRegion(zoneRegion));
                   hadSampleID = true;
                 }
                 else
@@ -143,14 +227,7 @@ void sfzero::SF2Reader::read()
               if ((whichZone2 == firstZone) && !hadSampleID)
               {
                 instRegion = zoneRegion;
-              }
-
-              // Modulators.
-              int modEnd = ibag[1].instModNdx;
-              int whichMod = ibag->instModNdx;
-              if (whichMod < modEnd)
-              {
-                sound_->addUnsupportedOpcode("any modulator");
+                instGlobalModulation = zoneModulation;
               }
             }
           }
@@ -165,104 +242,101 @@ void sfzero::SF2Reader::read()
           addGeneratorToRegion(pgen->genOper, &pgen->genAmount, &presetRegion);
         }
       }
-
-      // Modulators.
-      int modEnd = pbag[1].modNdx;
-      int whichMod = pbag->modNdx;
-      if (whichMod < modEnd)
-      {
-        sound_->addUnsupportedOpcode("any modulator");
-      }
     }
   }
 }
 
-juce::AudioSampleBuffer *sfzero::SF2Reader::readSamples(double *progressVar, juce::Thread *thread)
+bool sfzero::SF2Reader::findSampleData(SampleData &data)
 {
-  static const int bufferSize = 32768;
-
   if (file_ == nullptr)
   {
     sound_->addError("Couldn't open file.");
-    return nullptr;
+    return false;
   }
 
   // Find the "sdta" chunk.
   file_->setPosition(0);
   sfzero::RIFFChunk riffChunk;
   riffChunk.readFrom(file_);
-  bool found = false;
   sfzero::RIFFChunk chunk;
   while (file_->getPosition() < riffChunk.end())
   {
     chunk.readFrom(file_);
     if (FourCCEquals(chunk.id, "sdta"))
     {
-      found = true;
       break;
     }
     chunk.seekAfter(file_);
   }
   juce::int64 sdtaEnd = chunk.end();
-  found = false;
+  bool found = false;
+  sfzero::RIFFChunk sm24Chunk;
+  bool foundSm24 = false;
   while (file_->getPosition() < sdtaEnd)
   {
-    chunk.readFrom(file_);
-    if (FourCCEquals(chunk.id, "smpl"))
+    sfzero::RIFFChunk subchunk;
+    subchunk.readFrom(file_);
+    if (FourCCEquals(subchunk.id, "smpl"))
     {
+      chunk = subchunk;
       found = true;
-      break;
     }
-    chunk.seekAfter(file_);
+    else if (FourCCEquals(subchunk.id, "sm24"))
+    {
+      sm24Chunk = subchunk;
+      foundSm24 = true;
+    }
+    subchunk.seekAfter(file_);
   }
   if (!found)
   {
     sound_->addError("SF2 is missing its \"smpl\" chunk.");
+    return false;
+  }
+
+  data.smplStart = chunk.start;
+  data.smplSize = static_cast<juce::int64>(chunk.size);
+  data.numSamples = static_cast<int>(chunk.size / sizeof(short));
+
+  // The "sm24" chunk holds the low byte of each sample; the spec says to
+  // ignore it if it doesn't match "smpl" (it's padded to an even size).
+  bool is24Bit = foundSm24 && ((sm24Chunk.size == static_cast<sfzero::dword>(data.numSamples)) ||
+                               (sm24Chunk.size == static_cast<sfzero::dword>(data.numSamples + 1)));
+  data.sm24Start = is24Bit ? sm24Chunk.start : -1;
+  return true;
+}
+
+juce::AudioSampleBuffer *sfzero::SF2Reader::readSamples(double *progressVar, juce::Thread *thread)
+{
+  SampleData data;
+  if (!findSampleData(data))
+  {
     return nullptr;
   }
 
   // Allocate the AudioSampleBuffer.
-  int numSamples = chunk.size / sizeof(short);
-  juce::AudioSampleBuffer *sampleBuffer = new juce::AudioSampleBuffer(1, numSamples);
+  juce::AudioSampleBuffer *sampleBuffer = sfzero::SampleArena::getInstance().createBuffer(1, data.numSamples);
 
   // Read and convert.
-  short *buffer = new short[bufferSize];
-  int samplesLeft = numSamples;
+  juce::HeapBlock<short> buffer(readBlockSize);
+  juce::HeapBlock<juce::uint8> lowBytes(readBlockSize);
   float *out = sampleBuffer->getWritePointer(0);
-  while (samplesLeft > 0)
+  for (int samplesRead = 0; samplesRead < data.numSamples;)
   {
-    // Read the buffer.
-    int samplesToRead = bufferSize;
-    if (samplesToRead > samplesLeft)
-    {
-      samplesToRead = samplesLeft;
-    }
-    file_->read(buffer, samplesToRead * sizeof(short));
-
-    // Convert from signed 16-bit to float.
-    int samplesToConvert = samplesToRead;
-    short *in = buffer;
-    for (; samplesToConvert > 0; --samplesToConvert)
-    {
-      // If we ever need to compile for big-endian platforms, we'll need to
-      // byte-swap here.
-      *out++ = *in++ / 32767.0f;
-    }
-
-    samplesLeft -= samplesToRead;
+    int samplesToRead = juce::jmin(static_cast<int>(readBlockSize), data.numSamples - samplesRead);
+    readBlock(data, samplesRead, samplesToRead, out + samplesRead, buffer.get(), lowBytes.get());
+    samplesRead += samplesToRead;
 
     if (progressVar)
     {
-      *progressVar = static_cast<float>(numSamples - samplesLeft) / numSamples;
+      *progressVar = static_cast<float>(samplesRead) / data.numSamples;
     }
     if (thread && thread->threadShouldExit())
     {
-      delete[] buffer;
-      delete sampleBuffer;
+      sfzero::SampleArena::getInstance().releaseBuffer(sampleBuffer);
       return nullptr;
     }
   }
-  delete[] buffer;
 
   if (progressVar)
   {
@@ -272,7 +346,102 @@ juce::AudioSampleBuffer *sfzero::SF2Reader::readSamples(double *progressVar, juc
   return sampleBuffer;
 }
 
-void sfzero::SF2Reader::addGeneratorToRegion(sfzero::word genOper, sfzero::SF2::genAmountType *amount, sfzero::Region *region)
+juce::AudioSampleBuffer *sfzero::SF2Reader::readSampleRange(const SampleData &data, juce::int64 start, int numSamples)
+{
+  if (file_ == nullptr)
+  {
+    return nullptr;
+  }
+
+  juce::AudioSampleBuffer *sampleBuffer = sfzero::SampleArena::getInstance().createBuffer(1, numSamples);
+  int numInData = static_cast<int>(juce::jlimit(static_cast<juce::int64>(0), static_cast<juce::int64>(numSamples),
+                                                static_cast<juce::int64>(data.numSamples) - start));
+  sampleBuffer->clear(numInData, numSamples - numInData);
+
+  juce::HeapBlock<short> buffer(readBlockSize);
+  juce::HeapBlock<juce::uint8> lowBytes(readBlockSize);
+  float *out = sampleBuffer->getWritePointer(0);
+  for (int samplesRead = 0; samplesRead < numInData;)
+  {
+    int samplesToRead = juce::jmin(static_cast<int>(readBlockSize), numInData - samplesRead);
+    readBlock(data, start + samplesRead, samplesToRead, out + samplesRead, buffer.get(), lowBytes.get());
+    samplesRead += samplesToRead;
+  }
+  return sampleBuffer;
+}
+
+juce::AudioSampleBuffer *sfzero::SF2Reader::decodeSample(const SampleData &data, juce::int64 start, int numBytes,
+                                                          int extraSamples)
+{
+#if JUCE_USE_OGGVORBIS
+  int numInData = static_cast<int>(
+      juce::jlimit(static_cast<juce::int64>(0), static_cast<juce::int64>(numBytes), data.smplSize - start));
+  if ((file_ == nullptr) || (numInData == 0))
+  {
+    return nullptr;
+  }
+  juce::MemoryBlock bytes(static_cast<size_t>(numInData));
+  file_->setPosition(data.smplStart + start);
+  if (file_->read(bytes.getData(), numInData) != numInData)
+  {
+    return nullptr;
+  }
+
+  juce::OggVorbisAudioFormat format;
+  std::unique_ptr<juce::AudioFormatReader> reader(
+      format.createReaderFor(new juce::MemoryInputStream(bytes, false), true));
+  if ((reader == nullptr) || (reader->lengthInSamples > std::numeric_limits<int>::max() - extraSamples))
+  {
+    return nullptr;
+  }
+  int numSamples = static_cast<int>(reader->lengthInSamples);
+  juce::AudioSampleBuffer *buffer = sfzero::SampleArena::getInstance().createBuffer(1, numSamples + extraSamples);
+  reader->read(buffer, 0, numSamples + extraSamples, 0, true, false);
+  return buffer;
+#else
+  juce::ignoreUnused(data, start, numBytes, extraSamples);
+  return nullptr;
+#endif
+}
+
+void sfzero::SF2Reader::readBlock(const SampleData &data, juce::int64 start, int numSamples, float *out, short *buffer,
+                                  juce::uint8 *lowBytes)
+{
+  file_->setPosition(data.smplStart + start * static_cast<juce::int64>(sizeof(short)));
+  file_->read(buffer, numSamples * static_cast<int>(sizeof(short)));
+
+  if (data.sm24Start >= 0)
+  {
+    file_->setPosition(data.sm24Start + start);
+    file_->read(lowBytes, numSamples);
+    sfzero::PCM::int24ToFloat(buffer, lowBytes, out, numSamples);
+  }
+  else
+  {
+    sfzero::PCM::int16ToFloat(buffer, &out, 1, numSamples);
+  }
+}
+
+void sfzero::SF2Reader::addModulator(sfzero::word srcOper, sfzero::word destOper, short amount, sfzero::word amtSrcOper,
+                                     sfzero::word transOper, sfzero::ModulationProgram *program)
+{
+  sfzero::Modulator modulator;
+  if (sfzero::ModulationProgram::fromSF2(srcOper, destOper, amount, amtSrcOper, transOper, modulator))
+  {
+    program->add(modulator, false);
+  }
+  else if (destOper & 0x8000)
+  {
+    sound_->addUnsupportedOpcode("linked modulator");
+  }
+  else
+  {
+    const sfzero::SF2Generator *generator = sfzero::GeneratorFor(static_cast<int>(destOper));
+    sound_->addUnsupportedOpcode(juce::String("modulator to ") + (generator ? generator->name : "unknown generator"));
+  }
+}
+
+void sfzero::SF2Reader::addGeneratorToRegion(sfzero::word genOper, sfzero::SF2::genAmountType *amount, sfzero::RegionDescription *region)
 {
   switch (genOper)
   {
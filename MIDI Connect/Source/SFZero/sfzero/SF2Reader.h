@@ -14,7 +14,8 @@ namespace sfzero
 
 class SF2Sound;
 class Sample;
-struct Region;
+class ModulationProgram;
+struct RegionDescription;
 
 class SF2Reader
 {
@@ -22,14 +23,36 @@ public:
   SF2Reader(SF2Sound *sound, const juce::File &file);
   virtual ~SF2Reader();
 
+  // Where the sample data lies in the file.
+  struct SampleData
+  {
+    juce::int64 smplStart, smplSize;
+    juce::int64 sm24Start; // Negative without 24-bit data.
+    int numSamples;
+  };
+
   void read();
+  bool findSampleData(SampleData &data);
   juce::AudioSampleBuffer *readSamples(double *progressVar = nullptr, juce::Thread *thread = nullptr);
+  // Samples past the end of the data are zero.
+  juce::AudioSampleBuffer *readSampleRange(const SampleData &data, juce::int64 start, int numSamples);
+  // Decodes an SF3 file's Ogg Vorbis sample from "numBytes" bytes at "start"
+  // in the sample data, adding "extraSamples" zeros.
+  juce::AudioSampleBuffer *decodeSample(const SampleData &data, juce::int64 start, int numBytes, int extraSamples);
 
 private:
+  enum
+  {
+    readBlockSize = 32768 // Samples read from the file at a time.
+  };
+
   SF2Sound *sound_;
   juce::FileInputStream *file_;
 
-  void addGeneratorToRegion(word genOper, SF2::genAmountType *amount, Region *region);
+  void readBlock(const SampleData &data, juce::int64 start, int numSamples, float *out, short *buffer, juce::uint8 *lowBytes);
+
+  void addGeneratorToRegion(word genOper, SF2::genAmountType *amount, RegionDescription *region);
+  void addModulator(word srcOper, word destOper, short amount, word amtSrcOper, word transOper, ModulationProgram *program);
   JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SF2Reader)
 };
 }
@@ -6,24 +6,64 @@
  *************************************************************************************/
 #include "SF2Sound.h"
 #include "SF2Reader.h"
+#include "SFZDecodeCache.h"
+#include "SFZSampleArena.h"
 #include "SFZSample.h"
 
-sfzero::SF2Sound::SF2Sound(const juce::File &file) : sfzero::Sound(file), selectedPreset_(0) {}
+// One of the file's samples, read (or decoded) by itself.
+class SF2SampleRange : public sfzero::Sample
+{
+public:
+  SF2SampleRange(sfzero::SF2Sound &sound, double sampleRate, juce::int64 start, juce::int64 length, bool isOggVorbis)
+      : sfzero::Sample(sound.getFile(), sampleRate, isOggVorbis ? 0 : static_cast<juce::uint64>(length)), sound_(sound),
+        start_(start), numBytes_(isOggVorbis ? static_cast<int>(length) : 0)
+  {
+  }
+
+protected:
+  juce::AudioSampleBuffer *readBuffer(juce::AudioFormatManager * /*formatManager*/, Metadata &metadata) override
+  {
+    if (numBytes_ == 0)
+    {
+      return sound_.readSampleRange(start_, static_cast<int>(metadata.sampleLength));
+    }
+
+    // Ogg Vorbis samples' lengths are only known once they're decoded.
+    juce::uint64 length = 0;
+    juce::AudioSampleBuffer *buffer = sound_.decodeSample(start_, numBytes_, length);
+    if (buffer)
+    {
+      metadata.sampleLength = length;
+    }
+    return buffer;
+  }
+
+private:
+  sfzero::SF2Sound &sound_;
+  juce::int64 start_;
+  int numBytes_; // Of Ogg Vorbis data; zero for PCM.
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SF2SampleRange)
+};
+
+sfzero::SF2Sound::SF2Sound(const juce::File &file)
+    : sfzero::Sound(file), loadOnDemand_(false), isSF3_(false), hasSampleData_(false), selectedPreset_(0)
+{
+}
 
 sfzero::SF2Sound::~SF2Sound()
 {
-  // "presets" owns the regions, so clear them out of "regions" so ~SFZSound()
-  // doesn't try to delete them.
-  getRegions().clear();
+  leaveResidencyManager();
 
-  // The samples all share a single buffer, so make sure they don't all delete
-  // it.
-  juce::AudioSampleBuffer *buffer = nullptr;
+  // The samples each hold a reference to the shared buffer.
   for (juce::HashMap<int, sfzero::Sample *>::Iterator i(samplesByRate_); i.next();)
   {
-    buffer = i.getValue()->detachBuffer();
+    delete i.getValue();
+  }
+  for (juce::HashMap<int, sfzero::Sample *>::Iterator i(samplesByIndex_); i.next();)
+  {
+    delete i.getValue();
   }
-  delete buffer;
 }
 
 class PresetComparator
@@ -43,9 +83,14 @@ public:
 
 void sfzero::SF2Sound::loadRegions()
 {
+  ScopedLoadTimer timer(*this, parsing);
   sfzero::SF2Reader reader(this, getFile());
 
   reader.read();
+  if (readsSamplesSeparately())
+  {
+    hasSampleData_ = reader.findSampleData(sampleData_);
+  }
 
   // Sort the presets.
   PresetComparator comparator;
@@ -54,17 +99,53 @@ void sfzero::SF2Sound::loadRegions()
   useSubsound(0);
 }
 
-void sfzero::SF2Sound::loadSamples(juce::AudioFormatManager * /*formatManager*/, double *progressVar, juce::Thread *thread)
+void sfzero::SF2Sound::loadSamples(juce::AudioFormatManager *formatManager, double *progressVar, juce::Thread *thread)
 {
+  ScopedLoadTimer timer(*this, loadingSamples);
+  if (readsSamplesSeparately())
+  {
+    // On demand, just the selected preset's samples.
+    if (loadOnDemand_)
+    {
+      loadPresetSamples(selectedPreset_.load(), formatManager, progressVar, thread);
+    }
+    else
+    {
+      juce::Array<sfzero::Sample *> samples;
+      getSamples(samples);
+      loadSeparately(samples, formatManager, progressVar, thread);
+    }
+    if (thread && thread->threadShouldExit())
+    {
+      return;
+    }
+    setLoaded(true);
+    if (onPlayable)
+    {
+      onPlayable();
+    }
+    if (progressVar)
+    {
+      *progressVar = 1.0;
+    }
+    return;
+  }
+
   sfzero::SF2Reader reader(this, getFile());
   juce::AudioSampleBuffer *buffer = reader.readSamples(progressVar, thread);
 
   if (buffer)
   {
-    // All the SFZSamples will share the buffer.
-    for (juce::HashMap<int, sfzero::Sample *>::Iterator i(samplesByRate_); i.next();)
+    // All the SFZSamples will share the buffer, as will any other sound
+    // loaded from the same file.
+    sfzero::SampleArena &arena = sfzero::SampleArena::getInstance();
+    buffer = arena.intern(buffer);
+    setSamplesBuffer(buffer);
+    arena.releaseBuffer(buffer);
+    setLoaded(true);
+    if (onPlayable)
     {
-      i.getValue()->setBuffer(buffer);
+      onPlayable();
     }
   }
 
@@ -74,6 +155,81 @@ void sfzero::SF2Sound::loadSamples(juce::AudioFormatManager * /*formatManager*/,
   }
 }
 
+void sfzero::SF2Sound::loadPresetSamples(int whichPreset, juce::AudioFormatManager *formatManager, double *progressVar,
+                                         juce::Thread *thread)
+{
+  Preset *preset = presets_[whichPreset];
+  if ((preset == nullptr) || !readsSamplesSeparately())
+  {
+    return;
+  }
+
+  juce::Array<sfzero::Sample *> samples;
+  for (int i = 0; i < preset->regionList.size(); ++i)
+  {
+    samples.addIfNotAlreadyThere(preset->regionList.getUnchecked(i)->sample);
+  }
+  loadSeparately(samples, formatManager, progressVar, thread);
+}
+
+void sfzero::SF2Sound::loadSeparately(const juce::Array<sfzero::Sample *> &samples,
+                                      juce::AudioFormatManager *formatManager, double *progressVar, juce::Thread *thread)
+{
+  // Each job does nothing if its sample is already in.  The samples that are
+  // loaded are passed to sampleLoaded() from this thread, as they come in.
+  std::atomic<int> numDone(0);
+  juce::Array<sfzero::Sample *> loaded;
+  juce::CriticalSection loadedLock;
+  juce::WaitableEvent jobDone;
+  juce::ThreadPool pool(juce::jmax(1, juce::SystemStats::getNumCpus()));
+  for (int i = 0; i < samples.size(); ++i)
+  {
+    sfzero::Sample *sample = samples.getUnchecked(i);
+    pool.addJob([sample, formatManager, &numDone, &loaded, &loadedLock, &jobDone]() {
+      if (sample->refault(formatManager))
+      {
+        const juce::ScopedLock locker(loadedLock);
+        loaded.add(sample);
+      }
+      numDone.fetch_add(1);
+      jobDone.signal();
+    });
+  }
+
+  for (;;)
+  {
+    // Read first, so nothing done by then is missed.
+    bool allDone = (numDone.load() == samples.size());
+    juce::Array<sfzero::Sample *> newlyLoaded;
+    {
+      const juce::ScopedLock locker(loadedLock);
+      newlyLoaded.swapWith(loaded);
+    }
+    for (auto *sample : newlyLoaded)
+    {
+      sampleLoaded(sample);
+    }
+    if (allDone)
+    {
+      break;
+    }
+
+    if (progressVar)
+    {
+      *progressVar = static_cast<double>(numDone.load()) / samples.size();
+    }
+    if (thread && thread->threadShouldExit())
+    {
+      // Jobs already running finish; the rest are dropped.
+      pool.removeAllJobs(false, 10000);
+      return;
+    }
+    // Wake for each job that finishes, and now and then to see if the thread
+    // is being stopped.
+    jobDone.wait(100);
+  }
+}
+
 void sfzero::SF2Sound::addPreset(sfzero::SF2Sound::Preset *preset) { presets_.add(preset); }
 
 int sfzero::SF2Sound::numSubsounds() { return presets_.size(); }
@@ -96,12 +252,45 @@ juce::String sfzero::SF2Sound::subsoundName(int whichSubsound)
 
 void sfzero::SF2Sound::useSubsound(int whichSubsound)
 {
-  selectedPreset_ = whichSubsound;
-  getRegions().clear();
-  getRegions().addArray(presets_[whichSubsound]->regions);
+  // Just a pointer switch, so program changes can do it on the audio thread.
+  Preset *preset = presets_[whichSubsound];
+  if (preset == nullptr)
+  {
+    return;
+  }
+  selectedPreset_.store(whichSubsound);
+  setActiveRegions(&preset->regionList);
+
+  if (loadOnDemand_)
+  {
+    for (int i = 0; i < preset->regionList.size(); ++i)
+    {
+      preset->regionList.getUnchecked(i)->sample->requestRefault();
+    }
+  }
 }
 
-int sfzero::SF2Sound::selectedSubsound() { return selectedPreset_; }
+int sfzero::SF2Sound::selectedSubsound() { return selectedPreset_.load(); }
+
+juce::int64 sfzero::SF2Sound::getSampleMemoryUsage()
+{
+  if (readsSamplesSeparately())
+  {
+    juce::int64 bytes = 0;
+    for (juce::HashMap<int, sfzero::Sample *>::Iterator i(samplesByIndex_); i.next();)
+    {
+      bytes += i.getValue()->getMemoryUsage();
+    }
+    return bytes;
+  }
+
+  // The samples all share one buffer.
+  for (juce::HashMap<int, sfzero::Sample *>::Iterator i(samplesByRate_); i.next();)
+  {
+    return i.getValue()->getMemoryUsage();
+  }
+  return 0;
+}
 
 sfzero::Sample *sfzero::SF2Sound::sampleFor(double sampleRate)
 {
@@ -117,8 +306,79 @@ sfzero::Sample *sfzero::SF2Sound::sampleFor(double sampleRate)
 
 void sfzero::SF2Sound::setSamplesBuffer(juce::AudioSampleBuffer *buffer)
 {
+  sfzero::SampleArena &arena = sfzero::SampleArena::getInstance();
   for (juce::HashMap<int, sfzero::Sample *>::Iterator i(samplesByRate_); i.next();)
   {
+    arena.retainBuffer(buffer);
     i.getValue()->setBuffer(buffer);
   }
 }
+
+sfzero::Sample *sfzero::SF2Sound::sampleFor(int whichSample, double sampleRate, juce::int64 start, juce::int64 length,
+                                            bool isOggVorbis)
+{
+  sfzero::Sample *sample = samplesByIndex_[whichSample];
+
+  if (sample == nullptr)
+  {
+    sample = new SF2SampleRange(*this, sampleRate, start, length, isOggVorbis);
+    samplesByIndex_.set(whichSample, sample);
+  }
+  return sample;
+}
+
+juce::AudioSampleBuffer *sfzero::SF2Sound::readSampleRange(juce::int64 start, int numSamples)
+{
+  if (!hasSampleData_)
+  {
+    return nullptr;
+  }
+
+  // Other sounds with the same preset (or another using the same sample)
+  // end up sharing the buffer.
+  sfzero::SF2Reader reader(this, getFile());
+  juce::AudioSampleBuffer *buffer = reader.readSampleRange(sampleData_, start, numSamples + extraSamples);
+  return (buffer != nullptr) ? sfzero::SampleArena::getInstance().intern(buffer) : nullptr;
+}
+
+juce::AudioSampleBuffer *sfzero::SF2Sound::decodeSample(juce::int64 start, int numBytes, juce::uint64 &length)
+{
+  if (!hasSampleData_)
+  {
+    return nullptr;
+  }
+
+  sfzero::DecodeCache &cache = sfzero::DecodeCache::getInstance();
+  juce::AudioSampleBuffer *buffer = cache.read(getFile(), start, extraSamples);
+  if (buffer == nullptr)
+  {
+    sfzero::SF2Reader reader(this, getFile());
+    buffer = reader.decodeSample(sampleData_, start, numBytes, extraSamples);
+    if (buffer == nullptr)
+    {
+      return nullptr;
+    }
+    cache.write(getFile(), start, *buffer, buffer->getNumSamples() - extraSamples);
+  }
+  length = static_cast<juce::uint64>(buffer->getNumSamples() - extraSamples);
+  return sfzero::SampleArena::getInstance().intern(buffer);
+}
+
+void sfzero::SF2Sound::getSamples(juce::Array<sfzero::Sample *> &samples)
+{
+  // The samples sharing the whole file's buffer are left out; they can't be
+  // evicted.
+  for (juce::HashMap<int, sfzero::Sample *>::Iterator i(samplesByIndex_); i.next();)
+  {
+    samples.add(i.getValue());
+  }
+}
+
+void sfzero::SF2Sound::getAllSamples(juce::Array<sfzero::Sample *> &samples)
+{
+  getSamples(samples);
+  for (juce::HashMap<int, sfzero::Sample *>::Iterator i(samplesByRate_); i.next();)
+  {
+    samples.add(i.getValue());
+  }
+}
@@ -7,6 +7,7 @@
 #ifndef SF2SOUND_H_INCLUDED
 #define SF2SOUND_H_INCLUDED
 
+#include "SF2Reader.h"
 #include "SFZSound.h"
 
 namespace sfzero
@@ -21,16 +22,33 @@ public:
   void loadRegions() override;
   void loadSamples(juce::AudioFormatManager *formatManager, double *progressVar = nullptr, juce::Thread *thread = nullptr) override;
 
+  // Presets on demand: rather than the whole of the file's sample data, only
+  // the stretches the selected preset plays are read.  Selecting another
+  // preset asks for its samples, which the ResidencyManager then reads in
+  // the background.  Set before loadRegions().
+  void setLoadPresetsOnDemand(bool shouldLoadOnDemand) { loadOnDemand_ = shouldLoadOnDemand; }
+  bool loadsPresetsOnDemand() const { return loadOnDemand_; }
+  // Reads a preset's samples now, when loading presets on demand; it's what
+  // loadSamples() does for the selected one.
+  void loadPresetSamples(int whichPreset, juce::AudioFormatManager *formatManager, double *progressVar = nullptr,
+                         juce::Thread *thread = nullptr);
+
+  // An SF3 file's samples are Ogg Vorbis, and are decoded one by one, spread
+  // over a pool of threads (see also DecodeCache).  Set by the reader.
+  void setIsSF3(bool sf3) { isSF3_ = sf3; }
+  bool isSF3() const { return isSF3_; }
+  bool readsSamplesSeparately() const { return loadOnDemand_ || isSF3_; }
+
   struct Preset
   {
     juce::String name;
     int bank;
     int preset;
-    juce::OwnedArray<Region> regions;
+    juce::Array<Region *> regionList; // What the sound plays when this preset is selected; the sound owns them.
 
     Preset(juce::String nameIn, int bankIn, int presetIn) : name(nameIn), bank(bankIn), preset(presetIn) {}
     ~Preset() {}
-    void addRegion(Region *region) { regions.add(region); }
+    void addRegion(Region *region) { regionList.add(region); }
   };
   void addPreset(Preset *preset);
 
@@ -38,14 +56,35 @@ public:
   juce::String subsoundName(int whichSubsound) override;
   void useSubsound(int whichSubsound) override;
   int selectedSubsound() override;
+  juce::int64 getSampleMemoryUsage() override;
+
+  void getSamples(juce::Array<Sample *> &samples) override;
+  void getAllSamples(juce::Array<Sample *> &samples) override;
 
   Sample *sampleFor(double sampleRate);
   void setSamplesBuffer(juce::AudioSampleBuffer *buffer);
+  // When reading samples separately, each of the file's samples (its "shdr"
+  // records) is a Sample of its own.  For an Ogg Vorbis sample, "length" is
+  // in bytes.
+  Sample *sampleFor(int whichSample, double sampleRate, juce::int64 start, juce::int64 length, bool isOggVorbis);
+  juce::AudioSampleBuffer *readSampleRange(juce::int64 start, int numSamples);
+  juce::AudioSampleBuffer *decodeSample(juce::int64 start, int numBytes, juce::uint64 &length);
 
 private:
+  enum
+  {
+    extraSamples = 4 // Read after each sample, for interpolation.
+  };
+
+  void loadSeparately(const juce::Array<Sample *> &samples, juce::AudioFormatManager *formatManager, double *progressVar,
+                      juce::Thread *thread);
+
   juce::OwnedArray<Preset> presets_;
   juce::HashMap<int, Sample *> samplesByRate_;
-  int selectedPreset_;
+  juce::HashMap<int, Sample *> samplesByIndex_;
+  SF2Reader::SampleData sampleData_;
+  bool loadOnDemand_, isSF3_, hasSampleData_;
+  std::atomic<int> selectedPreset_;
   JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SF2Sound)
 };
 }
@@ -0,0 +1,316 @@
+/*************************************************************************************
+ * Original code copyright (C) 2012 Steve Folta
+ * Converted to Juce module (C) 2016 Leo Olivers
+ * Forked from https://github.com/stevefolta/SFZero
+ * For license info please see the LICENSE file distributed with this source code
+ *************************************************************************************/
+#include "SFZCompressedSample.h"
+
+namespace
+{
+// The ways readers turn integer samples into floats: divided by full scale,
+// or shifted up to 32 bits and divided by 0x7fffffff.
+struct IntegerFormat
+{
+  int bits;
+  int shift;
+  float scale;
+};
+
+const IntegerFormat integerFormats[] = {
+    {16, 0, 1.0f / 32768.0f}, {16, 16, 1.0f / 0x7fffffff}, {24, 0, 1.0f / 8388608.0f}, {24, 8, 1.0f / 0x7fffffff},
+};
+
+enum
+{
+  escapeLength = 32 // Unary codes this long are followed by the raw value.
+};
+
+bool toIntegers(const juce::AudioSampleBuffer &buffer, const IntegerFormat &format, juce::int32 *out)
+{
+  double step = static_cast<double>(format.scale) * static_cast<double>(1 << format.shift);
+  double limit = static_cast<double>(1 << (format.bits - 1));
+  for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+  {
+    const float *in = buffer.getReadPointer(channel);
+    for (int i = 0; i < buffer.getNumSamples(); ++i)
+    {
+      double value = std::floor(in[i] / step + 0.5);
+      if ((value < -limit) || (value >= limit))
+      {
+        return false;
+      }
+      juce::int32 integer = static_cast<juce::int32>(value);
+      if (static_cast<float>(integer * (1 << format.shift)) * format.scale != in[i])
+      {
+        return false;
+      }
+      *out++ = integer;
+    }
+  }
+  return true;
+}
+
+inline juce::uint32 zigzag(juce::int32 value)
+{
+  return (static_cast<juce::uint32>(value) << 1) ^ static_cast<juce::uint32>(value >> 31);
+}
+
+inline juce::int32 unzigzag(juce::uint32 value)
+{
+  return static_cast<juce::int32>(value >> 1) ^ -static_cast<juce::int32>(value & 1);
+}
+
+inline juce::uint32 lowBits(int count) { return (count >= 32) ? 0xffffffff : ((1u << count) - 1); }
+
+class BitWriter
+{
+public:
+  explicit BitWriter(juce::Array<juce::uint32> &wordsIn) : words(wordsIn), accumulator(0), numBits(0) {}
+
+  void write(juce::uint32 value, int count)
+  {
+    accumulator = (accumulator << count) | (value & lowBits(count));
+    numBits += count;
+    if (numBits >= 32)
+    {
+      numBits -= 32;
+      words.add(static_cast<juce::uint32>(accumulator >> numBits));
+    }
+  }
+
+  void writeRice(juce::uint32 value, int parameter)
+  {
+    juce::uint32 quotient = value >> parameter;
+    if (quotient < escapeLength)
+    {
+      write(0xffffffff, static_cast<int>(quotient));
+      write(0, 1);
+      write(value, parameter);
+    }
+    else
+    {
+      write(0xffffffff, escapeLength);
+      write(value, 32);
+    }
+  }
+
+  void flush()
+  {
+    if (numBits > 0)
+    {
+      words.add(static_cast<juce::uint32>(accumulator << (32 - numBits)));
+      numBits = 0;
+    }
+  }
+
+private:
+  juce::Array<juce::uint32> &words;
+  juce::uint64 accumulator;
+  int numBits;
+};
+
+class BitReader
+{
+public:
+  BitReader(const juce::uint32 *wordsIn, juce::uint64 accumulatorIn, int numBitsIn)
+      : words(wordsIn), accumulator(accumulatorIn), numBits(numBitsIn)
+  {
+  }
+
+  juce::uint32 read(int count)
+  {
+    if (count == 0)
+    {
+      return 0;
+    }
+    if (numBits < count)
+    {
+      accumulator = (accumulator << 32) | *words++;
+      numBits += 32;
+    }
+    numBits -= count;
+    return static_cast<juce::uint32>(accumulator >> numBits) & lowBits(count);
+  }
+
+  juce::uint32 readRice(int parameter)
+  {
+    juce::uint32 quotient = 0;
+    while ((quotient < escapeLength) && (read(1) != 0))
+    {
+      quotient += 1;
+    }
+    if (quotient == escapeLength)
+    {
+      return read(32);
+    }
+    return (quotient << parameter) | read(parameter);
+  }
+
+  const juce::uint32 *getWords() const { return words; }
+  juce::uint64 getAccumulator() const { return accumulator; }
+  int getNumBits() const { return numBits; }
+
+private:
+  const juce::uint32 *words;
+  juce::uint64 accumulator;
+  int numBits;
+};
+}
+
+sfzero::CompressedSample::CompressedSample(int numChannels, int numFrames, int shift, float scale)
+    : numChannels_(numChannels), numFrames_(numFrames),
+      numBlocks_((numFrames + blockFrames - 1) / blockFrames), shift_(shift), scale_(scale), numWords_(0)
+{
+  size_t numEntries = static_cast<size_t>(numBlocks_) * numChannels_;
+  firstFrames_.malloc(numEntries);
+  offsets_.malloc(numEntries);
+  riceParameters_.malloc(numEntries);
+}
+
+sfzero::CompressedSample::~CompressedSample() {}
+
+sfzero::CompressedSample *sfzero::CompressedSample::compress(const juce::AudioSampleBuffer &buffer)
+{
+  int numChannels = buffer.getNumChannels(), numFrames = buffer.getNumSamples();
+  if ((numChannels == 0) || (numFrames == 0))
+  {
+    return nullptr;
+  }
+
+  juce::HeapBlock<juce::int32> integers(static_cast<size_t>(numChannels) * numFrames);
+  const IntegerFormat *format = nullptr;
+  for (auto &candidate : integerFormats)
+  {
+    if (toIntegers(buffer, candidate, integers.get()))
+    {
+      format = &candidate;
+      break;
+    }
+  }
+  if (format == nullptr)
+  {
+    return nullptr;
+  }
+
+  std::unique_ptr<CompressedSample> compressed(new CompressedSample(numChannels, numFrames, format->shift, format->scale));
+  juce::Array<juce::uint32> words;
+  BitWriter writer(words);
+  juce::HeapBlock<juce::uint32> residuals(blockFrames);
+  for (int block = 0; block < compressed->numBlocks_; ++block)
+  {
+    int start = block * blockFrames;
+    int length = juce::jmin(static_cast<int>(blockFrames), numFrames - start);
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+      const juce::int32 *x = integers.get() + static_cast<size_t>(channel) * numFrames + start;
+      juce::uint64 sum = 0;
+      for (int i = 1; i < length; ++i)
+      {
+        juce::int32 prediction = (i == 1) ? x[0] : (2 * x[i - 1] - x[i - 2]);
+        residuals[i] = zigzag(x[i] - prediction);
+        sum += residuals[i];
+      }
+
+      // The Rice parameter closest to log2 of the mean residual.
+      int parameter = 0;
+      juce::uint64 mean = (length > 1) ? (sum / (length - 1)) : 0;
+      while ((parameter < 31) && ((static_cast<juce::uint64>(2) << parameter) <= mean))
+      {
+        parameter += 1;
+      }
+
+      int entry = block * numChannels + channel;
+      compressed->firstFrames_[entry] = x[0];
+      compressed->riceParameters_[entry] = static_cast<juce::uint8>(parameter);
+      compressed->offsets_[entry] = static_cast<juce::uint32>(words.size());
+      for (int i = 1; i < length; ++i)
+      {
+        writer.writeRice(residuals[i], parameter);
+      }
+      writer.flush();
+    }
+  }
+
+  compressed->numWords_ = static_cast<size_t>(words.size());
+  if (compressed->getMemoryUsage() >= static_cast<juce::int64>(numChannels) * numFrames * sizeof(float))
+  {
+    return nullptr;
+  }
+  compressed->bits_.malloc(juce::jmax(static_cast<size_t>(1), compressed->numWords_));
+  memcpy(compressed->bits_.get(), words.getRawDataPointer(), compressed->numWords_ * sizeof(juce::uint32));
+  return compressed.release();
+}
+
+juce::int64 sfzero::CompressedSample::getMemoryUsage() const
+{
+  juce::int64 numEntries = static_cast<juce::int64>(numBlocks_) * numChannels_;
+  return sizeof(*this) + numEntries * (sizeof(juce::int32) + sizeof(juce::uint32) + sizeof(juce::uint8)) +
+         static_cast<juce::int64>(numWords_) * sizeof(juce::uint32);
+}
+
+void sfzero::CompressedSample::startBlock(int block, Cursor &cursor) const
+{
+  jassert(juce::isPositiveAndBelow(block, numBlocks_));
+
+  cursor.block = block;
+  cursor.numFrames = 0;
+  for (int channel = 0; channel < juce::jmin(numChannels_, 2); ++channel)
+  {
+    int entry = block * numChannels_ + channel;
+    Cursor::Channel &state = cursor.channels[channel];
+    state.word = offsets_[entry];
+    state.accumulator = 0;
+    state.numBits = 0;
+    state.previous = state.beforePrevious = firstFrames_[entry];
+  }
+}
+
+void sfzero::CompressedSample::decode(Cursor &cursor, int endFrame, float *const *dest, int numDestChannels) const
+{
+  jassert(juce::isPositiveAndBelow(cursor.block, numBlocks_));
+
+  int length = juce::jmin(static_cast<int>(blockFrames), numFrames_ - cursor.block * blockFrames);
+  endFrame = juce::jmin(endFrame, length + 1);
+  if (endFrame <= cursor.numFrames)
+  {
+    return;
+  }
+
+  bool isLastBlock = (cursor.block + 1 == numBlocks_);
+  for (int channel = 0; channel < juce::jmin(numChannels_, numDestChannels, 2); ++channel)
+  {
+    int entry = cursor.block * numChannels_ + channel;
+    int parameter = riceParameters_[entry];
+    Cursor::Channel &state = cursor.channels[channel];
+    BitReader reader(bits_.get() + state.word, state.accumulator, state.numBits);
+    float *out = dest[channel];
+
+    juce::int32 previous = state.previous, beforePrevious = state.beforePrevious;
+    int i = cursor.numFrames;
+    if (i == 0)
+    {
+      out[0] = toFloat(previous);
+      i = 1;
+    }
+    for (; i < juce::jmin(endFrame, length); ++i)
+    {
+      juce::int32 prediction = (i == 1) ? previous : (2 * previous - beforePrevious);
+      juce::int32 value = prediction + unzigzag(reader.readRice(parameter));
+      out[i] = toFloat(value);
+      beforePrevious = previous;
+      previous = value;
+    }
+    if (endFrame > length)
+    {
+      out[length] = isLastBlock ? 0.0f : toFloat(firstFrames_[entry + numChannels_]);
+    }
+
+    state.word = static_cast<size_t>(reader.getWords() - bits_.get());
+    state.accumulator = reader.getAccumulator();
+    state.numBits = reader.getNumBits();
+    state.previous = previous;
+    state.beforePrevious = beforePrevious;
+  }
+  cursor.numFrames = endFrame;
+}
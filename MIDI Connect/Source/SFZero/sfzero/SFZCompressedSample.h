@@ -0,0 +1,81 @@
+/*************************************************************************************
+ * Original code copyright (C) 2012 Steve Folta
+ * Converted to Juce module (C) 2016 Leo Olivers
+ * Forked from https://github.com/stevefolta/SFZero
+ * For license info please see the LICENSE file distributed with this source code
+ *************************************************************************************/
+#ifndef SFZCOMPRESSEDSAMPLE_H_INCLUDED
+#define SFZCOMPRESSEDSAMPLE_H_INCLUDED
+
+#include "SFZCommon.h"
+
+namespace sfzero
+{
+
+// Sample data kept losslessly compressed in memory, in blocks that can each
+// be decoded on their own.  Each channel of a block stores its first frame
+// as is, then the residuals of a second-order fixed predictor, Rice coded.
+//
+// Only audio that came from 16- or 24-bit integers can be stored this way,
+// and only if the floats can be rebuilt bit for bit; compress() returns null
+// otherwise, or if it wouldn't save anything.
+class CompressedSample
+{
+public:
+  enum
+  {
+    blockFrames = 4096
+  };
+
+  ~CompressedSample();
+
+  static CompressedSample *compress(const juce::AudioSampleBuffer &buffer);
+
+  int getNumChannels() const { return numChannels_; }
+  int getNumFrames() const { return numFrames_; }
+  int getNumBlocks() const { return numBlocks_; }
+  juce::int64 getMemoryUsage() const;
+
+  // How far a block's decoding has got, so it can be decoded a few frames
+  // at a time as the playhead reaches them.  Covers up to two channels.
+  struct Cursor
+  {
+    int block;     // -1 before startBlock().
+    int numFrames; // Decoded so far.
+    struct Channel
+    {
+      size_t word;
+      juce::uint64 accumulator;
+      int numBits;
+      juce::int32 previous, beforePrevious;
+    } channels[2];
+  };
+
+  void startBlock(int block, Cursor &cursor) const;
+  // Decodes the cursor's block on up to frame "endFrame" into "dest", whose
+  // channels have room for blockFrames + 1 frames each, indexed from the
+  // start of the block.  The frame after the block's last is the first frame
+  // of the next block (or zero after the last one), so interpolation can run
+  // to the end.  Doesn't allocate, so it can be used on the audio thread.
+  void decode(Cursor &cursor, int endFrame, float *const *dest, int numDestChannels) const;
+
+private:
+  CompressedSample(int numChannels, int numFrames, int shift, float scale);
+
+  float toFloat(juce::int32 value) const { return static_cast<float>(value * (1 << shift_)) * scale_; }
+
+  int numChannels_, numFrames_, numBlocks_;
+  int shift_;
+  float scale_;
+  // Per block and channel.
+  juce::HeapBlock<juce::int32> firstFrames_;
+  juce::HeapBlock<juce::uint32> offsets_;
+  juce::HeapBlock<juce::uint8> riceParameters_;
+  juce::HeapBlock<juce::uint32> bits_;
+  size_t numWords_;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CompressedSample)
+};
+}
+
+#endif // SFZCOMPRESSEDSAMPLE_H_INCLUDED
@@ -0,0 +1,125 @@
+/*************************************************************************************
+ * Original code copyright (C) 2012 Steve Folta
+ * Converted to Juce module (C) 2016 Leo Olivers
+ * Forked from https://github.com/stevefolta/SFZero
+ * For license info please see the LICENSE file distributed with this source code
+ *************************************************************************************/
+#include "SFZDecodeCache.h"
+#include "SFZSampleArena.h"
+
+namespace
+{
+// An entry is this header and then the samples, as floats in the machine's
+// byte order; the cache is only read back where it was written.
+const char entryMagic[4] = {'S', 'F', 'Z', 'D'};
+const char *const entryExtension = ".decoded";
+}
+
+sfzero::DecodeCache &sfzero::DecodeCache::getInstance()
+{
+  static DecodeCache cache;
+  return cache;
+}
+
+sfzero::DecodeCache::DecodeCache() {}
+
+sfzero::DecodeCache::~DecodeCache() {}
+
+void sfzero::DecodeCache::setDirectory(const juce::File &directory)
+{
+  const juce::ScopedLock locker(lock_);
+  directory_ = directory;
+}
+
+juce::File sfzero::DecodeCache::getDirectory()
+{
+  const juce::ScopedLock locker(lock_);
+  return directory_;
+}
+
+void sfzero::DecodeCache::clear()
+{
+  juce::File directory = getDirectory();
+  if (directory == juce::File())
+  {
+    return;
+  }
+
+  juce::Array<juce::File> entries;
+  directory.findChildFiles(entries, juce::File::findFiles, false, juce::String("*") + entryExtension);
+  for (auto &entry : entries)
+  {
+    entry.deleteFile();
+  }
+}
+
+juce::AudioSampleBuffer *sfzero::DecodeCache::read(const juce::File &file, juce::int64 position, int extraSamples)
+{
+  juce::File entry = getEntry(file, position);
+  if (entry == juce::File())
+  {
+    return nullptr;
+  }
+  juce::FileInputStream stream(entry);
+  if (stream.failedToOpen())
+  {
+    return nullptr;
+  }
+
+  char magic[4];
+  int numSamples = 0;
+  if ((stream.read(magic, sizeof(magic)) != sizeof(magic)) || (memcmp(magic, entryMagic, sizeof(magic)) != 0) ||
+      (stream.read(&numSamples, sizeof(numSamples)) != sizeof(numSamples)) || (numSamples < 0) ||
+      (stream.getTotalLength() != stream.getPosition() + static_cast<juce::int64>(numSamples) * sizeof(float)))
+  {
+    return nullptr;
+  }
+
+  juce::AudioSampleBuffer *buffer = sfzero::SampleArena::getInstance().createBuffer(1, numSamples + extraSamples);
+  if (stream.read(buffer->getWritePointer(0), numSamples * static_cast<int>(sizeof(float))) !=
+      numSamples * static_cast<int>(sizeof(float)))
+  {
+    sfzero::SampleArena::getInstance().releaseBuffer(buffer);
+    return nullptr;
+  }
+  buffer->clear(numSamples, extraSamples);
+  return buffer;
+}
+
+void sfzero::DecodeCache::write(const juce::File &file, juce::int64 position, const juce::AudioSampleBuffer &buffer,
+                                int numSamples)
+{
+  juce::File entry = getEntry(file, position);
+  if ((entry == juce::File()) || !entry.getParentDirectory().createDirectory())
+  {
+    return;
+  }
+
+  // Written to a temporary file and moved into place, so a reader on another
+  // thread (or a crash) never sees half an entry.
+  juce::TemporaryFile temporary(entry);
+  {
+    juce::FileOutputStream stream(temporary.getFile());
+    if (stream.failedToOpen() || !stream.write(entryMagic, sizeof(entryMagic)) ||
+        !stream.write(&numSamples, sizeof(numSamples)) ||
+        !stream.write(buffer.getReadPointer(0), static_cast<size_t>(numSamples) * sizeof(float)))
+    {
+      return;
+    }
+  }
+  temporary.overwriteTargetFileWithTemporary();
+}
+
+juce::File sfzero::DecodeCache::getEntry(const juce::File &file, juce::int64 position)
+{
+  juce::File directory = getDirectory();
+  if (directory == juce::File())
+  {
+    return juce::File();
+  }
+
+  juce::String key;
+  key << file.getFullPathName() << ":" << file.getSize() << ":" << file.getLastModificationTime().toMilliseconds() << ":"
+      << position;
+  return directory.getChildFile(juce::String::toHexString(key.hashCode64()) + entryExtension);
+}
@@ -0,0 +1,46 @@
+/*************************************************************************************
+ * Original code copyright (C) 2012 Steve Folta
+ * Converted to Juce module (C) 2016 Leo Olivers
+ * Forked from https://github.com/stevefolta/SFZero
+ * For license info please see the LICENSE file distributed with this source code
+ *************************************************************************************/
+#ifndef SFZDECODECACHE_H_INCLUDED
+#define SFZDECODECACHE_H_INCLUDED
+
+#include "SFZCommon.h"
+
+namespace sfzero
+{
+
+// Decoded copies of compressed samples (those of SF3 files), kept on disk so
+// each only needs decoding once.  Entries are named after the file's path,
+// size and modification time and the sample's position in it, so an edited
+// file gets new ones.  Off until it's given a directory.
+class DecodeCache
+{
+public:
+  static DecodeCache &getInstance();
+
+  void setDirectory(const juce::File &directory); // juce::File() turns it off.
+  juce::File getDirectory();
+  void clear(); // Deletes the entries.
+
+  // Returns a new SampleArena buffer with "extraSamples" zeros on the end, or
+  // null if the sample isn't cached.
+  juce::AudioSampleBuffer *read(const juce::File &file, juce::int64 position, int extraSamples);
+  void write(const juce::File &file, juce::int64 position, const juce::AudioSampleBuffer &buffer, int numSamples);
+
+private:
+  DecodeCache();
+  ~DecodeCache();
+
+  juce::File getEntry(const juce::File &file, juce::int64 position);
+
+  juce::File directory_;
+  juce::CriticalSection lock_;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DecodeCache)
+};
+}
+
+#endif // SFZDECODECACHE_H_INCLUDED
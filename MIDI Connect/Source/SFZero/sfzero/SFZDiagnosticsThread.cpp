@@ -0,0 +1,25 @@
+/*************************************************************************************
+ * Original code copyright (C) 2012 Steve Folta
+ * Converted to Juce module (C) 2016 Leo Olivers
+ * Forked from https://github.com/stevefolta/SFZero
+ * For license info please see the LICENSE file distributed with this source code
+ *************************************************************************************/
+#include "SFZDiagnosticsThread.h"
+#include "SFZLog.h"
+#include "SFZTrace.h"
+
+sfzero::DiagnosticsThread::DiagnosticsThread() : juce::TimeSliceThread("SFZDiagnostics")
+{
+  addTimeSliceClient(&sfzero::Log::getInstance());
+  addTimeSliceClient(&sfzero::Trace::getInstance());
+  startThread();
+}
+
+sfzero::DiagnosticsThread::~DiagnosticsThread()
+{
+  removeTimeSliceClient(&sfzero::Trace::getInstance());
+  removeTimeSliceClient(&sfzero::Log::getInstance());
+  stopThread(4000);
+  // Whatever came in since the last slice.
+  sfzero::Log::getInstance().drain();
+}
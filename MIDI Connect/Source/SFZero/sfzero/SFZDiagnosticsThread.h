@@ -0,0 +1,33 @@
+/*************************************************************************************
+ * Original code copyright (C) 2012 Steve Folta
+ * Converted to Juce module (C) 2016 Leo Olivers
+ * Forked from https://github.com/stevefolta/SFZero
+ * For license info please see the LICENSE file distributed with this source code
+ *************************************************************************************/
+#ifndef SFZDIAGNOSTICSTHREAD_H_INCLUDED
+#define SFZDIAGNOSTICSTHREAD_H_INCLUDED
+
+#include "SFZCommon.h"
+
+namespace sfzero
+{
+
+// The one thread that writes out the Log and saves the Trace after a missed
+// deadline.  A singleton has to be served by a single TimeSliceThread, as a
+// TimeSliceClient's schedule isn't safe to share between several; so rather
+// than each SFZeroAudioProcessor adding them to its own background thread,
+// they all hold this through a
+// juce::SharedResourcePointer, which makes it for the first and deletes it
+// after the last.
+class DiagnosticsThread : public juce::TimeSliceThread
+{
+public:
+  DiagnosticsThread();
+  ~DiagnosticsThread();
+
+private:
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DiagnosticsThread)
+};
+}
+
+#endif // SFZDIAGNOSTICSTHREAD_H_INCLUDED
@@ -9,7 +9,8 @@
 static const float fastReleaseTime = 0.01f;
 
 sfzero::EG::EG()
-    : segment_(), sampleRate_(0), exponentialDecay_(false), level_(0), slope_(0), samplesUntilNextSegment_(0), segmentIsExponential_(false)
+    : segment_(), sampleRate_(0), exponentialDecay_(false), portableMath_(false), level_(0), slope_(0),
+      samplesUntilNextSegment_(0), segmentIsExponential_(false)
 {
 }
 
@@ -146,7 +147,7 @@ void sfzero::EG::startDecay()
     {
       // I don't truly understand this; just following what LinuxSampler does.
       float mysterySlope = -9.226f / samplesUntilNextSegment_;
-      slope_ = exp(mysterySlope);
+      slope_ = portableMath_ ? static_cast<float>(sfzero::PortableMath::exp(mysterySlope)) : exp(mysterySlope);
       segmentIsExponential_ = true;
       if (parameters_.sustain > 0.0)
       {
@@ -155,7 +156,9 @@ void sfzero::EG::startDecay()
         // get to zero, not to the sustain level.  The SFZ spec is not that
         // specific about what "decay" means, so perhaps it's really supposed
         // to specify the time to reach the sustain level.
-        samplesUntilNextSegment_ = static_cast<int>(log((parameters_.sustain / 100.0) / level_) / mysterySlope);
+        double sustainLevel = (parameters_.sustain / 100.0) / level_;
+        samplesUntilNextSegment_ = static_cast<int>(
+            (portableMath_ ? sfzero::PortableMath::log(sustainLevel) : log(sustainLevel)) / mysterySlope);
         if (samplesUntilNextSegment_ <= 0)
         {
           startSustain();
@@ -202,7 +205,7 @@ void sfzero::EG::startRelease()
   {
     // I don't truly understand this; just following what LinuxSampler does.
     float mysterySlope = -9.226f / samplesUntilNextSegment_;
-    slope_ = exp(mysterySlope);
+    slope_ = portableMath_ ? static_cast<float>(sfzero::PortableMath::exp(mysterySlope)) : exp(mysterySlope);
     segmentIsExponential_ = true;
   }
   else
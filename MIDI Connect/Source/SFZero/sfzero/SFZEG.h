@@ -7,6 +7,7 @@
 #ifndef SFZEG_H_INCLUDED
 #define SFZEG_H_INCLUDED
 
+#include "SFZPortableMath.h"
 #include "SFZRegion.h"
 
 namespace sfzero
@@ -18,6 +19,9 @@ public:
   virtual ~EG() {}
 
   void setExponentialDecay(bool newExponentialDecay);
+  // Take the exponential curves from PortableMath rather than libm, so they
+  // come out the same on every platform.
+  void setPortableMath(bool shouldUsePortableMath) { portableMath_ = shouldUsePortableMath; }
   void startNote(const EGParameters *parameters, float floatVelocity, double sampleRate, const EGParameters *velMod = nullptr);
   void nextSegment();
   void noteOff();
@@ -57,6 +61,7 @@ private:
   EGParameters parameters_;
   double sampleRate_;
   bool exponentialDecay_;
+  bool portableMath_;
   float level_;
   float slope_;
   int samplesUntilNextSegment_;
@@ -0,0 +1,212 @@
+/*************************************************************************************
+ * Original code copyright (C) 2012 Steve Folta
+ * Converted to Juce module (C) 2016 Leo Olivers
+ * Forked from https://github.com/stevefolta/SFZero
+ * For license info please see the LICENSE file distributed with this source code
+ *************************************************************************************/
+#include "SFZLog.h"
+
+namespace
+{
+const char *levelNames[] = {"debug", "info", "warning", "error"};
+}
+
+sfzero::Log &sfzero::Log::getInstance()
+{
+  static Log log;
+  return log;
+}
+
+sfzero::Log::Log()
+    : writePosition_(0), readPosition_(0), draining_(false), rateInterval_(0), rateBurst_(0), nextDue_(0), numDropped_(0),
+      numRateLimited_(0), numDroppedReported_(0), numRateLimitedReported_(0)
+{
+  // A slot's sequence number is the write position it's free for, or one
+  // past it once it holds that record.
+  slots_.calloc(capacity);
+  for (int i = 0; i < capacity; ++i)
+  {
+    slots_[i].sequence.store(static_cast<juce::uint64>(i));
+  }
+#ifdef JUCE_DEBUG
+  minimumLevel_.store(debugLevel);
+#else
+  minimumLevel_.store(infoLevel);
+#endif
+  setRateLimit(200, 100);
+}
+
+sfzero::Log::~Log() {}
+
+void sfzero::Log::setRateLimit(int perSecond, int burst)
+{
+  juce::int64 interval = (perSecond > 0) ? juce::Time::getHighResolutionTicksPerSecond() / perSecond : 0;
+  rateInterval_.store(interval);
+  rateBurst_.store(interval * juce::jmax(1, burst));
+}
+
+bool sfzero::Log::withinRateLimit(juce::int64 now)
+{
+  juce::int64 interval = rateInterval_.load(std::memory_order_relaxed);
+  if (interval == 0)
+  {
+    return true;
+  }
+  juce::int64 due = nextDue_.load(std::memory_order_relaxed);
+  for (;;)
+  {
+    if (due - now > rateBurst_.load(std::memory_order_relaxed))
+    {
+      numRateLimited_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    if (nextDue_.compare_exchange_weak(due, juce::jmax(due, now) + interval, std::memory_order_relaxed))
+    {
+      return true;
+    }
+  }
+}
+
+void sfzero::Log::push(Record &record)
+{
+  record.ticks = juce::Time::getHighResolutionTicks();
+  if (!withinRateLimit(record.ticks))
+  {
+    return;
+  }
+
+  // Claim a slot, unless the reader hasn't got to it since it last went round.
+  juce::uint64 position = writePosition_.load(std::memory_order_relaxed);
+  Slot *slot;
+  for (;;)
+  {
+    slot = &slots_[static_cast<int>(position & (capacity - 1))];
+    juce::int64 difference =
+        static_cast<juce::int64>(slot->sequence.load(std::memory_order_acquire)) - static_cast<juce::int64>(position);
+    if (difference == 0)
+    {
+      if (writePosition_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+      {
+        break;
+      }
+    }
+    else if (difference < 0)
+    {
+      numDropped_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    else
+    {
+      position = writePosition_.load(std::memory_order_relaxed);
+    }
+  }
+
+  slot->record = record;
+  slot->sequence.store(position + 1, std::memory_order_release);
+}
+
+int sfzero::Log::drain()
+{
+  if (draining_.exchange(true))
+  {
+    return 0;
+  }
+
+  int numWritten = 0;
+  for (;;)
+  {
+    Slot &slot = slots_[static_cast<int>(readPosition_ & (capacity - 1))];
+    if (slot.sequence.load(std::memory_order_acquire) != readPosition_ + 1)
+    {
+      break;
+    }
+    Record record = slot.record;
+    slot.sequence.store(readPosition_ + capacity, std::memory_order_release);
+    readPosition_ += 1;
+
+    juce::Logger::writeToLog(formatRecord(record));
+    numWritten += 1;
+  }
+
+  juce::int64 numDropped = numDropped_.load(), numRateLimited = numRateLimited_.load();
+  if ((numDropped != numDroppedReported_) || (numRateLimited != numRateLimitedReported_))
+  {
+    juce::Logger::writeToLog("sfzero: " + juce::String(numDropped - numDroppedReported_) + " messages dropped, " +
+                             juce::String(numRateLimited - numRateLimitedReported_) + " rate limited");
+    numDroppedReported_ = numDropped;
+    numRateLimitedReported_ = numRateLimited;
+  }
+
+  draining_.store(false);
+  return numWritten;
+}
+
+int sfzero::Log::useTimeSlice() { return (drain() > 0) ? 10 : 100; }
+
+juce::String sfzero::Log::formatRecord(const Record &record)
+{
+  juce::String line;
+  line << "[" << juce::String(juce::Time::highResolutionTicksToSeconds(record.ticks), 6) << "] sfzero "
+       << levelNames[record.level] << ": ";
+
+  // Each conversion is handed to snprintf() on its own, with the argument
+  // as it was stored.
+  int nextArgument = 0;
+  for (const char *c = record.format; *c != 0; ++c)
+  {
+    if (*c != '%')
+    {
+      line << *c;
+      continue;
+    }
+    if (c[1] == '%')
+    {
+      line << '%';
+      ++c;
+      continue;
+    }
+
+    juce::String spec("%");
+    ++c;
+    while ((*c != 0) && (strchr("-+ #0123456789.", *c) != nullptr))
+    {
+      spec << *c++;
+    }
+    while ((*c != 0) && (strchr("hlLqjzt", *c) != nullptr))
+    {
+      ++c;
+    }
+    if (*c == 0)
+    {
+      break;
+    }
+
+    if (nextArgument >= record.numArguments)
+    {
+      line << "?";
+      continue;
+    }
+    const Argument &argument = record.arguments[nextArgument++];
+    char text[256];
+    text[0] = 0;
+    switch (argument.type)
+    {
+    case Argument::integer:
+      snprintf(text, sizeof(text), (spec + "ll" + juce::String::charToString(strchr("diouxXc", *c) ? *c : 'd')).toRawUTF8(),
+               static_cast<long long>(argument.integerValue));
+      break;
+    case Argument::real:
+      snprintf(text, sizeof(text), (spec + juce::String::charToString(strchr("fFeEgGaA", *c) ? *c : 'g')).toRawUTF8(),
+               argument.realValue);
+      break;
+    case Argument::text:
+      snprintf(text, sizeof(text), (spec + "s").toRawUTF8(), argument.textValue ? argument.textValue : "(null)");
+      break;
+    case Argument::pointer:
+      snprintf(text, sizeof(text), "%p", argument.pointerValue);
+      break;
+    }
+    line << text;
+  }
+  return line;
+}
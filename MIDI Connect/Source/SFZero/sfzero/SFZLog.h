@@ -0,0 +1,183 @@
+/*************************************************************************************
+ * Original code copyright (C) 2012 Steve Folta
+ * Converted to Juce module (C) 2016 Leo Olivers
+ * Forked from https://github.com/stevefolta/SFZero
+ * For license info please see the LICENSE file distributed with this source code
+ *************************************************************************************/
+#ifndef SFZLOG_H_INCLUDED
+#define SFZLOG_H_INCLUDED
+
+#include "SFZCommon.h"
+
+namespace sfzero
+{
+
+// Logging that's safe from the audio thread.  A message is a printf-style
+// format and up to four arguments, copied into a fixed-size record and pushed
+// onto a lock-free queue; nothing is formatted, allocated or locked until
+// drain() takes the records off on another thread and writes them to
+// juce::Logger.  Any thread can write.
+//
+// The format, and any "%s" arguments, are kept as pointers until then, so
+// they must be string literals (or otherwise live for good).  Integer
+// arguments take any of the integer conversions whatever length modifier the
+// format gives them.
+//
+// Messages are rate limited, and when the queue is full they're dropped;
+// both are counted, and drain() says how many went missing.
+//
+// Runs as a TimeSliceClient, drained by the DiagnosticsThread.
+class Log : public juce::TimeSliceClient
+{
+public:
+  enum Level
+  {
+    debugLevel,
+    infoLevel,
+    warningLevel,
+    errorLevel
+  };
+
+  static Log &getInstance();
+
+  template <typename... Arguments> void write(Level level, const char *format, Arguments... arguments)
+  {
+    if (level < minimumLevel_.load(std::memory_order_relaxed))
+    {
+      return;
+    }
+    Record record;
+    record.level = level;
+    record.format = format;
+    record.numArguments = 0;
+    addArguments(record, arguments...);
+    push(record);
+  }
+
+  template <typename... Arguments> static void debug(const char *format, Arguments... arguments)
+  {
+    getInstance().write(debugLevel, format, arguments...);
+  }
+  template <typename... Arguments> static void info(const char *format, Arguments... arguments)
+  {
+    getInstance().write(infoLevel, format, arguments...);
+  }
+  template <typename... Arguments> static void warning(const char *format, Arguments... arguments)
+  {
+    getInstance().write(warningLevel, format, arguments...);
+  }
+  template <typename... Arguments> static void error(const char *format, Arguments... arguments)
+  {
+    getInstance().write(errorLevel, format, arguments...);
+  }
+
+  void setMinimumLevel(Level level) { minimumLevel_.store(level); }
+  // At most "perSecond" messages a second on average, in bursts of up to
+  // "burst".  Zero turns the limit off.
+  void setRateLimit(int perSecond, int burst);
+
+  // Formats and writes what's queued; returns how many messages that was.
+  // Safe to call from several threads, one of which does the work.
+  int drain();
+  int useTimeSlice() override;
+
+  juce::int64 getNumDropped() const { return numDropped_.load(); }       // The queue was full.
+  juce::int64 getNumRateLimited() const { return numRateLimited_.load(); } // Over the rate limit.
+
+private:
+  Log();
+  ~Log();
+
+  enum
+  {
+    capacity = 1024, // A power of two.
+    maxArguments = 4
+  };
+
+  struct Argument
+  {
+    enum Type
+    {
+      integer,
+      real,
+      text,
+      pointer
+    };
+
+    Type type;
+    union
+    {
+      juce::int64 integerValue;
+      double realValue;
+      const char *textValue;
+      const void *pointerValue;
+    };
+  };
+
+  struct Record
+  {
+    juce::int64 ticks;
+    const char *format;
+    Level level;
+    int numArguments;
+    Argument arguments[maxArguments];
+  };
+
+  struct Slot
+  {
+    std::atomic<juce::uint64> sequence;
+    Record record;
+  };
+
+  static void addArguments(Record &) {}
+  template <typename First, typename... Rest> static void addArguments(Record &record, First first, Rest... rest)
+  {
+    if (record.numArguments < maxArguments)
+    {
+      set(record.arguments[record.numArguments++], first);
+    }
+    addArguments(record, rest...);
+  }
+
+  template <typename Type>
+  static typename std::enable_if<std::is_integral<Type>::value>::type set(Argument &argument, Type value)
+  {
+    argument.type = Argument::integer;
+    argument.integerValue = static_cast<juce::int64>(value);
+  }
+  static void set(Argument &argument, double value)
+  {
+    argument.type = Argument::real;
+    argument.realValue = value;
+  }
+  static void set(Argument &argument, const char *value)
+  {
+    argument.type = Argument::text;
+    argument.textValue = value;
+  }
+  static void set(Argument &argument, const void *value)
+  {
+    argument.type = Argument::pointer;
+    argument.pointerValue = value;
+  }
+
+  void push(Record &record);
+  bool withinRateLimit(juce::int64 now);
+  static juce::String formatRecord(const Record &record);
+
+  juce::HeapBlock<Slot> slots_;
+  std::atomic<juce::uint64> writePosition_;
+  juce::uint64 readPosition_; // Only touched while draining.
+  std::atomic<bool> draining_;
+  std::atomic<int> minimumLevel_;
+  // The rate limit, as a "generic cell rate" scheduler: the time the next
+  // message is due, which messages may run ahead of by "burst" intervals.
+  std::atomic<juce::int64> rateInterval_, rateBurst_, nextDue_;
+  std::atomic<juce::int64> numDropped_, numRateLimited_;
+  juce::int64 numDroppedReported_, numRateLimitedReported_;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Log)
+};
+}
+
+#endif // SFZLOG_H_INCLUDED
@@ -0,0 +1,293 @@
+/*************************************************************************************
+ * Original code copyright (C) 2012 Steve Folta
+ * Converted to Juce module (C) 2016 Leo Olivers
+ * Forked from https://github.com/stevefolta/SFZero
+ * For license info please see the LICENSE file distributed with this source code
+ *************************************************************************************/
+#include "SFZModulation.h"
+#include "SF2Generator.h"
+#include "SFZPortableMath.h"
+
+namespace
+{
+// Source operator fields.
+enum
+{
+  sourceIndexMask = 0x007F,
+  sourceIsCC = 0x0080,
+  sourceIsNegative = 0x0100,
+  sourceIsBipolar = 0x0200,
+  sourceTypeShift = 10
+};
+
+// The general controllers a source can be, when it isn't a CC.
+enum
+{
+  noController = 0,
+  noteOnVelocity = 2,
+  noteOnKeyNumber = 3,
+  polyPressure = 10,
+  channelPressure = 13,
+  pitchWheel = 14,
+  pitchWheelSensitivity = 16
+};
+
+enum
+{
+  linearCurve,
+  concaveCurve,
+  convexCurve,
+  switchCurve
+};
+
+enum
+{
+  linearTransform = 0,
+  absoluteValueTransform = 2
+};
+
+// The SF2 "initial pitch" destination, which is only ever modulated.
+const int initialPitch = 59;
+
+// RPN 0 isn't tracked, so the pitch wheel sensitivity is the General MIDI
+// default of two semitones, in the units the SF2 source has.
+const float defaultPitchWheelSensitivity = 2.0f / 127.0f;
+
+// The spec's concave curve, 0 to 1 over 0 to 1; its slope follows the
+// "96dB over 960 centibels" velocity curve, which is also SFZ's.
+float concave(float x, bool portableMath)
+{
+  if (x >= 1.0f)
+  {
+    return 1.0f;
+  }
+  double y = (1.0 - x) * (1.0 - x);
+  double level = portableMath ? sfzero::PortableMath::log10(y) : log10(y);
+  return juce::jmin(1.0f, static_cast<float>(-20.0 / 96.0 * level));
+}
+
+float convex(float x, bool portableMath) { return 1.0f - concave(1.0f - x, portableMath); }
+
+float shape(int type, float x, bool portableMath)
+{
+  switch (type)
+  {
+  case concaveCurve:
+    return concave(x, portableMath);
+  case convexCurve:
+    return convex(x, portableMath);
+  case switchCurve:
+    return (x >= 0.5f) ? 1.0f : 0.0f;
+  default:
+    return x;
+  }
+}
+}
+
+sfzero::ChannelState::ChannelState() : pressure(0)
+{
+  for (int i = 0; i < 128; ++i)
+  {
+    controllers[i] = 0;
+  }
+  controllers[7] = 100;  // Volume.
+  controllers[10] = 64;  // Pan.
+  controllers[11] = 127; // Expression.
+}
+
+sfzero::ModulationProgram::ModulationProgram() {}
+
+void sfzero::ModulationProgram::setDefaults()
+{
+  static const juce::uint16 defaults[][4] = {
+      // Source, destination, amount, amount source.
+      {0x0502, sfzero::SF2Generator::initialAttenuation, 960, 0},
+      {0x0587, sfzero::SF2Generator::initialAttenuation, 960, 0},
+      {0x028A, sfzero::SF2Generator::pan, 1000, 0},
+      {0x058B, sfzero::SF2Generator::initialAttenuation, 960, 0},
+      {0x020E, initialPitch, 12700, 0x0010},
+  };
+
+  modulators_.clearQuick();
+  for (auto &fields : defaults)
+  {
+    sfzero::Modulator modulator;
+    fromSF2(fields[0], fields[1], static_cast<short>(fields[2]), fields[3], linearTransform, modulator);
+    modulators_.add(modulator);
+  }
+}
+
+void sfzero::ModulationProgram::add(const sfzero::Modulator &modulator, bool addToIdentical)
+{
+  for (auto &existing : modulators_)
+  {
+    if (existing.isIdenticalTo(modulator))
+    {
+      if (addToIdentical)
+      {
+        existing.amount += modulator.amount;
+      }
+      else
+      {
+        existing.amount = modulator.amount;
+      }
+      return;
+    }
+  }
+  modulators_.add(modulator);
+}
+
+void sfzero::ModulationProgram::removeInactive()
+{
+  // A primary source of "no controller" gives nothing, per the spec.
+  for (int i = modulators_.size(); --i >= 0;)
+  {
+    const sfzero::Modulator &modulator = modulators_.getReference(i);
+    if ((modulator.amount == 0.0f) || ((modulator.source & (sourceIndexMask | sourceIsCC)) == noController))
+    {
+      modulators_.remove(i);
+    }
+  }
+}
+
+void sfzero::ModulationProgram::evaluate(const sfzero::ModulationSources &sources, sfzero::ModulationValues &values) const
+{
+  values.attenuation = values.pan = values.pitch = 0.0f;
+  for (auto &modulator : modulators_)
+  {
+    float value = sourceValue(modulator.source, sources) * modulator.amount;
+    if ((modulator.amountSource & (sourceIndexMask | sourceIsCC)) != noController)
+    {
+      value *= sourceValue(modulator.amountSource, sources);
+    }
+    if (modulator.transform == absoluteValueTransform)
+    {
+      value = fabsf(value);
+    }
+
+    switch (modulator.destination)
+    {
+    case sfzero::Modulator::attenuation:
+      values.attenuation += value;
+      break;
+    case sfzero::Modulator::pan:
+      values.pan += value;
+      break;
+    case sfzero::Modulator::pitch:
+      values.pitch += value;
+      break;
+    }
+  }
+}
+
+bool sfzero::ModulationProgram::operator==(const sfzero::ModulationProgram &other) const
+{
+  return (modulators_.size() == other.modulators_.size()) &&
+         (memcmp(modulators_.begin(), other.modulators_.begin(), modulators_.size() * sizeof(sfzero::Modulator)) == 0);
+}
+
+juce::uint64 sfzero::ModulationProgram::hash() const
+{
+  // FNV-1a, as for RegionParameters; Modulator has no padding.
+  const juce::uint8 *bytes = reinterpret_cast<const juce::uint8 *>(modulators_.begin());
+  juce::uint64 hash = 14695981039346656037ull;
+  for (size_t i = 0; i < modulators_.size() * sizeof(sfzero::Modulator); ++i)
+  {
+    hash = (hash ^ bytes[i]) * 1099511628211ull;
+  }
+  return hash;
+}
+
+bool sfzero::ModulationProgram::fromSF2(juce::uint16 srcOper, juce::uint16 destOper, short amount, juce::uint16 amtSrcOper,
+                                        juce::uint16 transOper, sfzero::Modulator &modulator)
+{
+  // Linked modulators (destination bit 15) aren't supported either.
+  float scale = 1.0f;
+  switch (destOper)
+  {
+  case sfzero::SF2Generator::initialAttenuation:
+    modulator.destination = sfzero::Modulator::attenuation;
+    break;
+  case sfzero::SF2Generator::pan:
+    modulator.destination = sfzero::Modulator::pan;
+    break;
+  case sfzero::SF2Generator::coarseTune:
+    modulator.destination = sfzero::Modulator::pitch;
+    scale = 100.0f;
+    break;
+  case sfzero::SF2Generator::fineTune:
+  case initialPitch:
+    modulator.destination = sfzero::Modulator::pitch;
+    break;
+  default:
+    return false;
+  }
+
+  modulator.source = srcOper;
+  modulator.amountSource = amtSrcOper;
+  modulator.transform = (transOper == absoluteValueTransform) ? absoluteValueTransform : linearTransform;
+  modulator.amount = amount * scale;
+  return true;
+}
+
+float sfzero::ModulationProgram::sourceValue(juce::uint16 source, const sfzero::ModulationSources &sources)
+{
+  // Seven-bit values are scaled so the top one is 1 and, when bipolar, 64 is
+  // the centre.
+  int index = source & sourceIndexMask;
+  int value = 0, centre = 64, maximum = 127;
+  if (source & sourceIsCC)
+  {
+    value = sources.channel->controllers[index];
+  }
+  else
+  {
+    switch (index)
+    {
+    case noteOnVelocity:
+      value = sources.velocity;
+      break;
+    case noteOnKeyNumber:
+      value = sources.key;
+      break;
+    case polyPressure:
+      value = sources.polyPressure;
+      break;
+    case channelPressure:
+      value = sources.channel->pressure;
+      break;
+    case pitchWheel:
+      value = sources.pitchWheel;
+      centre = 8192;
+      maximum = 16383;
+      break;
+    case pitchWheelSensitivity:
+      return defaultPitchWheelSensitivity;
+    default:
+      // Including "link", which needs linked modulators.
+      return 0.0f;
+    }
+  }
+
+  int type = source >> sourceTypeShift;
+  if (source & sourceIsBipolar)
+  {
+    float x = juce::jlimit(-1.0f, 1.0f, static_cast<float>(value - centre) / (maximum + 1 - centre));
+    if (source & sourceIsNegative)
+    {
+      x = -x;
+    }
+    if (type == switchCurve)
+    {
+      return (x >= 0.0f) ? 1.0f : -1.0f;
+    }
+    return (x < 0.0f) ? -shape(type, -x, sources.portableMath) : shape(type, x, sources.portableMath);
+  }
+
+  float x = juce::jlimit(0.0f, 1.0f, static_cast<float>(value) / maximum);
+  if (source & sourceIsNegative)
+  {
+    x = 1.0f - x;
+  }
+  return shape(type, x, sources.portableMath);
+}
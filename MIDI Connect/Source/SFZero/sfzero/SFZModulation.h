@@ -0,0 +1,106 @@
+/*************************************************************************************
+ * Original code copyright (C) 2012 Steve Folta
+ * Converted to Juce module (C) 2016 Leo Olivers
+ * Forked from https://github.com/stevefolta/SFZero
+ * For license info please see the LICENSE file distributed with this source code
+ *************************************************************************************/
+#ifndef SFZMODULATION_H_INCLUDED
+#define SFZMODULATION_H_INCLUDED
+
+#include "SFZCommon.h"
+
+namespace sfzero
+{
+
+// An SF2 modulator, reduced to a destination the voice can apply.  The
+// sources are SF2 source operators, curve and polarity bits included.
+struct Modulator
+{
+  enum Destination : juce::uint16
+  {
+    attenuation, // Centibels.
+    pan,         // 0.1% units, as the "pan" generator.
+    pitch        // Cents.
+  };
+
+  juce::uint16 source, amountSource;
+  juce::uint16 destination;
+  juce::uint16 transform;
+  float amount;
+
+  // Modulators with these the same replace one another (or, from a preset,
+  // add to one another).
+  bool isIdenticalTo(const Modulator &other) const
+  {
+    return (source == other.source) && (amountSource == other.amountSource) && (destination == other.destination) &&
+           (transform == other.transform);
+  }
+};
+
+// A MIDI channel's controllers and pressure, as the synth last saw them.
+struct ChannelState
+{
+  ChannelState(); // The General MIDI defaults.
+
+  int controllers[128];
+  int pressure;
+};
+
+// What a voice's modulators read.
+struct ModulationSources
+{
+  int velocity, key;
+  int pitchWheel;
+  int polyPressure;
+  const ChannelState *channel;
+  // Work the curves out with PortableMath; see Voice::setFixedPointPhase().
+  bool portableMath;
+};
+
+// The sum of a voice's modulators, per destination.
+struct ModulationValues
+{
+  float attenuation, pan, pitch;
+};
+
+// The modulators of an SF2 zone, compiled with the default modulators into
+// a list the voice evaluates whenever one of the sources changes (at note
+// start and on MIDI events, never per sample).  Sounds keep one copy of
+// each distinct program; see Sound::internModulation().
+class ModulationProgram
+{
+public:
+  ModulationProgram();
+
+  // The SF2 2.04 default modulators (section 8.4) whose destinations the
+  // voice has: velocity, CC7 and CC11 to attenuation, CC10 to pan and the
+  // pitch wheel to pitch.
+  void setDefaults();
+  // Adds "modulator", or if there is an identical one, replaces it (for
+  // instrument zones) or adds to its amount (for preset zones).
+  void add(const Modulator &modulator, bool addToIdentical);
+  // Drops modulators that can't contribute anything.
+  void removeInactive();
+
+  void evaluate(const ModulationSources &sources, ModulationValues &values) const;
+
+  int getNumModulators() const { return modulators_.size(); }
+  const Modulator *getModulators() const { return modulators_.begin(); }
+  bool operator==(const ModulationProgram &other) const;
+  juce::uint64 hash() const;
+
+  // Converts an SF2 modulator record.  Returns false if it modulates
+  // something the voice doesn't have.
+  static bool fromSF2(juce::uint16 srcOper, juce::uint16 destOper, short amount, juce::uint16 amtSrcOper,
+                      juce::uint16 transOper, Modulator &modulator);
+
+private:
+  static float sourceValue(juce::uint16 source, const ModulationSources &sources);
+
+  juce::Array<Modulator> modulators_;
+
+  JUCE_LEAK_DETECTOR(ModulationProgram)
+};
+}
+
+#endif // SFZMODULATION_H_INCLUDED
@@ -0,0 +1,264 @@
+/*************************************************************************************
+ * Original code copyright (C) 2012 Steve Folta
+ * Converted to Juce module (C) 2016 Leo Olivers
+ * Forked from https://github.com/stevefolta/SFZero
+ * For license info please see the LICENSE file distributed with this source code
+ *************************************************************************************/
+#include "SFZPCM.h"
+#include "RIFF.h"
+
+#if JUCE_INTEL && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)))
+#define SFZERO_PCM_SSE2 1
+#include <emmintrin.h>
+#elif JUCE_ARM && JUCE_LITTLE_ENDIAN && (defined(__ARM_NEON__) || defined(__ARM_NEON))
+#define SFZERO_PCM_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+const float int16Scale = 1.0f / 32768.0f;
+// 24-bit samples are converted shifted up to the top of an int32.
+const float int24Scale = 1.0f / 2147483648.0f;
+
+inline float int16At(const juce::uint8 *p) { return static_cast<juce::int16>(juce::ByteOrder::littleEndianShort(p)) * int16Scale; }
+
+inline float int24At(const juce::uint8 *p)
+{
+  juce::uint32 bits = (static_cast<juce::uint32>(p[0]) << 8) | (static_cast<juce::uint32>(p[1]) << 16) |
+                      (static_cast<juce::uint32>(p[2]) << 24);
+  return static_cast<juce::int32>(bits) * int24Scale;
+}
+
+enum
+{
+  wavBlockFrames = 16384 // Frames read from a WAV file at a time.
+};
+}
+
+void sfzero::PCM::int16ToFloat(const void *source, float *const *dest, int numChannels, int numFrames)
+{
+  const juce::uint8 *in = static_cast<const juce::uint8 *>(source);
+  int frame = 0;
+
+#if SFZERO_PCM_SSE2
+  const __m128 scale = _mm_set1_ps(int16Scale);
+  if (numChannels == 1)
+  {
+    float *out = dest[0];
+    for (; frame + 8 <= numFrames; frame += 8)
+    {
+      __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + frame * 2));
+      // Pair each sample with itself, then shift the copy in the low half out
+      // to sign-extend it.
+      __m128i first = _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16);
+      __m128i second = _mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16);
+      _mm_storeu_ps(out + frame, _mm_mul_ps(_mm_cvtepi32_ps(first), scale));
+      _mm_storeu_ps(out + frame + 4, _mm_mul_ps(_mm_cvtepi32_ps(second), scale));
+    }
+  }
+  else if (numChannels == 2)
+  {
+    float *left = dest[0];
+    float *right = dest[1];
+    for (; frame + 4 <= numFrames; frame += 4)
+    {
+      // Each 32-bit lane holds a frame: left in the low half, right in the high.
+      __m128i frames = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + frame * 4));
+      __m128i leftSamples = _mm_srai_epi32(_mm_slli_epi32(frames, 16), 16);
+      __m128i rightSamples = _mm_srai_epi32(frames, 16);
+      _mm_storeu_ps(left + frame, _mm_mul_ps(_mm_cvtepi32_ps(leftSamples), scale));
+      _mm_storeu_ps(right + frame, _mm_mul_ps(_mm_cvtepi32_ps(rightSamples), scale));
+    }
+  }
+#elif SFZERO_PCM_NEON
+  if (numChannels == 1)
+  {
+    const juce::int16 *samples = reinterpret_cast<const juce::int16 *>(in);
+    float *out = dest[0];
+    for (; frame + 8 <= numFrames; frame += 8)
+    {
+      int16x8_t block = vld1q_s16(samples + frame);
+      vst1q_f32(out + frame, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(block))), int16Scale));
+      vst1q_f32(out + frame + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(block))), int16Scale));
+    }
+  }
+  else if (numChannels == 2)
+  {
+    const juce::int16 *samples = reinterpret_cast<const juce::int16 *>(in);
+    float *left = dest[0];
+    float *right = dest[1];
+    for (; frame + 4 <= numFrames; frame += 4)
+    {
+      int16x4x2_t block = vld2_s16(samples + frame * 2);
+      vst1q_f32(left + frame, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(block.val[0])), int16Scale));
+      vst1q_f32(right + frame, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(block.val[1])), int16Scale));
+    }
+  }
+#endif
+
+  for (; frame < numFrames; ++frame)
+  {
+    const juce::uint8 *p = in + frame * numChannels * 2;
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+      dest[channel][frame] = int16At(p + channel * 2);
+    }
+  }
+}
+
+void sfzero::PCM::int24ToFloat(const void *source, float *const *dest, int numChannels, int numFrames)
+{
+  // Three-byte samples don't line up with vector lanes, so they're gathered
+  // one at a time and converted four at a time.
+  const juce::uint8 *in = static_cast<const juce::uint8 *>(source);
+  int frameBytes = numChannels * 3;
+  int frame = 0;
+
+#if SFZERO_PCM_SSE2 || SFZERO_PCM_NEON
+  for (; frame + 4 <= numFrames; frame += 4)
+  {
+    const juce::uint8 *p = in + frame * frameBytes;
+    for (int channel = 0; channel < numChannels; ++channel, p += 3)
+    {
+      juce::int32 samples[4];
+      for (int i = 0; i < 4; ++i)
+      {
+        const juce::uint8 *sample = p + i * frameBytes;
+        samples[i] = static_cast<juce::int32>((static_cast<juce::uint32>(sample[0]) << 8) |
+                                              (static_cast<juce::uint32>(sample[1]) << 16) |
+                                              (static_cast<juce::uint32>(sample[2]) << 24));
+      }
+#if SFZERO_PCM_SSE2
+      __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(samples));
+      _mm_storeu_ps(dest[channel] + frame, _mm_mul_ps(_mm_cvtepi32_ps(block), _mm_set1_ps(int24Scale)));
+#else
+      vst1q_f32(dest[channel] + frame, vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(samples)), int24Scale));
+#endif
+    }
+  }
+#endif
+
+  for (; frame < numFrames; ++frame)
+  {
+    const juce::uint8 *p = in + frame * frameBytes;
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+      dest[channel][frame] = int24At(p + channel * 3);
+    }
+  }
+}
+
+void sfzero::PCM::int24ToFloat(const void *high, const void *low, float *dest, int numFrames)
+{
+  const juce::uint8 *highBytes = static_cast<const juce::uint8 *>(high);
+  const juce::uint8 *lowBytes = static_cast<const juce::uint8 *>(low);
+  int frame = 0;
+
+#if SFZERO_PCM_SSE2
+  const __m128 scale = _mm_set1_ps(int24Scale);
+  const __m128i zero = _mm_setzero_si128();
+  for (; frame + 8 <= numFrames; frame += 8)
+  {
+    __m128i highSamples = _mm_loadu_si128(reinterpret_cast<const __m128i *>(highBytes + frame * 2));
+    __m128i lowSamples = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(lowBytes + frame));
+    lowSamples = _mm_slli_epi16(_mm_unpacklo_epi8(lowSamples, zero), 8);
+    // Interleaving gives each 32-bit lane the high word on top and the low
+    // byte just under it.
+    __m128i first = _mm_unpacklo_epi16(lowSamples, highSamples);
+    __m128i second = _mm_unpackhi_epi16(lowSamples, highSamples);
+    _mm_storeu_ps(dest + frame, _mm_mul_ps(_mm_cvtepi32_ps(first), scale));
+    _mm_storeu_ps(dest + frame + 4, _mm_mul_ps(_mm_cvtepi32_ps(second), scale));
+  }
+#elif SFZERO_PCM_NEON
+  const juce::int16 *highSamples = reinterpret_cast<const juce::int16 *>(highBytes);
+  for (; frame + 8 <= numFrames; frame += 8)
+  {
+    int16x8_t highBlock = vld1q_s16(highSamples + frame);
+    uint16x8_t lowBlock = vshll_n_u8(vld1_u8(lowBytes + frame), 8);
+    int32x4_t first = vorrq_s32(vshll_n_s16(vget_low_s16(highBlock), 16),
+                                vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(lowBlock))));
+    int32x4_t second = vorrq_s32(vshll_n_s16(vget_high_s16(highBlock), 16),
+                                 vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(lowBlock))));
+    vst1q_f32(dest + frame, vmulq_n_f32(vcvtq_f32_s32(first), int24Scale));
+    vst1q_f32(dest + frame + 4, vmulq_n_f32(vcvtq_f32_s32(second), int24Scale));
+  }
+#endif
+
+  for (; frame < numFrames; ++frame)
+  {
+    juce::uint32 bits = (static_cast<juce::uint32>(juce::ByteOrder::littleEndianShort(highBytes + frame * 2)) << 16) |
+                        (static_cast<juce::uint32>(lowBytes[frame]) << 8);
+    dest[frame] = static_cast<juce::int32>(bits) * int24Scale;
+  }
+}
+
+bool sfzero::PCM::readWav(const juce::File &file, const juce::AudioFormatReader &reader, juce::AudioSampleBuffer &buffer)
+{
+  int numChannels = static_cast<int>(reader.numChannels);
+  int sampleBytes = static_cast<int>(reader.bitsPerSample) / 8;
+  if ((reader.getFormatName() != "WAV file") || reader.usesFloatingPointData ||
+      ((reader.bitsPerSample != 16) && (reader.bitsPerSample != 24)) || (numChannels != buffer.getNumChannels()) ||
+      (reader.lengthInSamples > buffer.getNumSamples()))
+  {
+    return false;
+  }
+
+  juce::FileInputStream stream(file);
+  if (stream.failedToOpen())
+  {
+    return false;
+  }
+
+  // Find the "data" chunk.  RF64 files, and anything else JUCE reads that
+  // isn't a plain RIFF file, are left to the reader.
+  sfzero::RIFFChunk riffChunk;
+  riffChunk.readFrom(&stream);
+  if ((riffChunk.type != sfzero::RIFFChunk::RIFF) || !FourCCEquals(riffChunk.id, "WAVE"))
+  {
+    return false;
+  }
+  sfzero::RIFFChunk chunk;
+  bool found = false;
+  while (!found && (stream.getPosition() < riffChunk.end()))
+  {
+    chunk.readFrom(&stream);
+    found = FourCCEquals(chunk.id, "data");
+    if (!found)
+    {
+      chunk.seekAfter(&stream);
+    }
+  }
+  int frameBytes = numChannels * sampleBytes;
+  if (!found || (static_cast<juce::int64>(chunk.size) / frameBytes < reader.lengthInSamples))
+  {
+    return false;
+  }
+
+  int numFrames = static_cast<int>(reader.lengthInSamples);
+  juce::HeapBlock<juce::uint8> data(static_cast<size_t>(wavBlockFrames) * frameBytes);
+  juce::HeapBlock<float *> channels(static_cast<size_t>(numChannels));
+  for (int frame = 0; frame < numFrames; frame += wavBlockFrames)
+  {
+    int framesToRead = juce::jmin(static_cast<int>(wavBlockFrames), numFrames - frame);
+    if (stream.read(data.get(), framesToRead * frameBytes) != framesToRead * frameBytes)
+    {
+      return false;
+    }
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+      channels[channel] = buffer.getWritePointer(channel, frame);
+    }
+    if (sampleBytes == 2)
+    {
+      int16ToFloat(data.get(), channels.get(), numChannels, framesToRead);
+    }
+    else
+    {
+      int24ToFloat(data.get(), channels.get(), numChannels, framesToRead);
+    }
+  }
+
+  buffer.clear(numFrames, buffer.getNumSamples() - numFrames);
+  return true;
+}
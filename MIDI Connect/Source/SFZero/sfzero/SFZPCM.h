@@ -0,0 +1,37 @@
+/*************************************************************************************
+ * Original code copyright (C) 2012 Steve Folta
+ * Converted to Juce module (C) 2016 Leo Olivers
+ * Forked from https://github.com/stevefolta/SFZero
+ * For license info please see the LICENSE file distributed with this source code
+ *************************************************************************************/
+#ifndef SFZPCM_H_INCLUDED
+#define SFZPCM_H_INCLUDED
+
+#include "SFZCommon.h"
+
+namespace sfzero
+{
+
+// Conversion of little-endian integer sample data to floats, shared by the
+// SF2 reader and WAV loading.  Uses SSE2 or NEON where the build has them.
+// Samples are scaled by full scale (32768 or 8388608), so the results are
+// exactly what CompressedSample recognizes as integers.
+class PCM
+{
+public:
+  // "source" holds "numChannels" interleaved channels, which are split into
+  // "dest".
+  static void int16ToFloat(const void *source, float *const *dest, int numChannels, int numFrames);
+  static void int24ToFloat(const void *source, float *const *dest, int numChannels, int numFrames);
+  // SF2's 24-bit form: the top 16 bits from the "smpl" chunk and the bottom 8
+  // from "sm24".
+  static void int24ToFloat(const void *high, const void *low, float *dest, int numFrames);
+
+  // Reads a 16- or 24-bit integer WAV file's audio into "buffer", whose
+  // samples past the end of the file are cleared.  Returns false for anything
+  // else, which is left to "reader".
+  static bool readWav(const juce::File &file, const juce::AudioFormatReader &reader, juce::AudioSampleBuffer &buffer);
+};
+}
+
+#endif // SFZPCM_H_INCLUDED
@@ -0,0 +1,367 @@
+/*************************************************************************************
+ * Original code copyright (C) 2012 Steve Folta
+ * Converted to Juce module (C) 2016 Leo Olivers
+ * Forked from https://github.com/stevefolta/SFZero
+ * For license info please see the LICENSE file distributed with this source code
+ *************************************************************************************/
+#include "SFZParseCache.h"
+
+namespace
+{
+inline bool isSpace(char c) { return (c == ' ') || (c == '\t') || (c == '\r') || (c == '\n'); }
+
+const char *skipWord(const char *p, const char *end)
+{
+  while ((p < end) && !isSpace(*p))
+  {
+    p += 1;
+  }
+  return p;
+}
+
+const char *skipSpaces(const char *p, const char *end)
+{
+  while ((p < end) && ((*p == ' ') || (*p == '\t')))
+  {
+    p += 1;
+  }
+  return p;
+}
+
+const char *skipToLineEnd(const char *p, const char *end)
+{
+  while ((p < end) && (*p != '\r') && (*p != '\n'))
+  {
+    p += 1;
+  }
+  return p;
+}
+
+const char *findPathEnd(const char *p, const char *end)
+{
+  // Paths are kind of funny to parse because they can contain whitespace.
+  const char *pathStart = p;
+  const char *potentialEnd = nullptr;
+
+  while (p < end)
+  {
+    char c = *p;
+    if (c == ' ')
+    {
+      // Is this space part of the path?  Or the start of the next opcode?  We
+      // don't know yet.
+      potentialEnd = p;
+      p += 1;
+      // Skip any more spaces.
+      while (p < end && *p == ' ')
+      {
+        p += 1;
+      }
+      continue;
+    }
+    else if ((c == '\n') || (c == '\r') || (c == '\t'))
+    {
+      break;
+    }
+    else if (c == '=')
+    {
+      // We've been looking at an opcode; we need to rewind to
+      // potentialEnd.
+      if (potentialEnd)
+      {
+        p = potentialEnd;
+      }
+      break;
+    }
+    p += 1;
+  }
+
+  // Trailing spaces aren't part of the path.
+  while ((p > pathStart) && (p[-1] == ' '))
+  {
+    p -= 1;
+  }
+  return p;
+}
+}
+
+sfzero::Fragment::Fragment(const char *text, size_t length) : text_(text), length_(length) { lex(); }
+
+sfzero::Fragment::Fragment(juce::MemoryMappedFile *mappedFile)
+    : text_(static_cast<const char *>(mappedFile->getData())), length_(mappedFile->getSize()), mappedFile_(mappedFile)
+{
+  lex();
+}
+
+sfzero::Fragment::Fragment(juce::MemoryBlock &contents) : text_(nullptr), length_(contents.getSize())
+{
+  contents_.swapWith(contents);
+  text_ = static_cast<const char *>(contents_.getData());
+  lex();
+}
+
+sfzero::Fragment::~Fragment() {}
+
+juce::int64 sfzero::Fragment::getMemoryUsage() const
+{
+  // Mapped text counts too: it's resident while in use, and each mapping
+  // holds the file open.
+  return sizeof(*this) + static_cast<juce::int64>(length_) +
+         static_cast<juce::int64>(elements_.size()) * sizeof(Element);
+}
+
+void sfzero::Fragment::lex()
+{
+  const char *p = text_;
+  const char *end = p + length_;
+  int line = 1;
+
+  while (p < end)
+  {
+    char c = *p;
+
+    if ((c == ' ') || (c == '\t'))
+    {
+      p += 1;
+    }
+    else if ((c == '\r') || (c == '\n'))
+    {
+      // Check for DOS-style line ending.
+      p += 1;
+      if ((c == '\r') && (p < end) && (*p == '\n'))
+      {
+        p += 1;
+      }
+      line += 1;
+    }
+    // Comment.
+    else if (c == '/')
+    {
+      p = skipToLineEnd(p, end);
+    }
+    // Tag.
+    else if (c == '<')
+    {
+      const char *tagStart = ++p;
+      while ((p < end) && (*p != '>') && (*p != '\r') && (*p != '\n'))
+      {
+        p += 1;
+      }
+      if ((p >= end) || (*p != '>'))
+      {
+        addError(line, "Unterminated tag");
+        return;
+      }
+      add(tagElement, line, tagStart, p, p, p);
+      p += 1;
+    }
+    // Preprocessor directive.
+    else if (c == '#')
+    {
+      const char *directiveStart = p;
+      p = skipWord(p, end);
+      sfzero::StringSlice directive(directiveStart, p);
+      p = skipSpaces(p, end);
+      if (directive == "#include")
+      {
+        if ((p < end) && (*p == '"'))
+        {
+          const char *pathStart = ++p;
+          while ((p < end) && (*p != '"') && (*p != '\r') && (*p != '\n'))
+          {
+            p += 1;
+          }
+          if ((p < end) && (*p == '"'))
+          {
+            add(includeElement, line, pathStart, pathStart, pathStart, p);
+            p += 1;
+          }
+          else
+          {
+            addError(line, "Unterminated #include path");
+          }
+        }
+        else
+        {
+          addError(line, "Malformed #include");
+          p = skipToLineEnd(p, end);
+        }
+      }
+      else if (directive == "#define")
+      {
+        const char *nameStart = p;
+        p = skipWord(p, end);
+        const char *nameEnd = p;
+        p = skipSpaces(p, end);
+        const char *valueStart = p;
+        p = skipWord(p, end);
+        if ((nameEnd > nameStart) && (*nameStart == '$') && (p > valueStart))
+        {
+          add(defineElement, line, nameStart, nameEnd, valueStart, p);
+        }
+        else
+        {
+          addError(line, "Malformed #define");
+        }
+      }
+      else
+      {
+        addError(line, "Unknown directive \"" + directive.toString() + "\"");
+        p = skipToLineEnd(p, end);
+      }
+    }
+    // Parameter.
+    else
+    {
+      const char *nameStart = p;
+      while ((p < end) && (*p != '=') && !isSpace(*p))
+      {
+        p += 1;
+      }
+      if ((p >= end) || (*p != '='))
+      {
+        addError(line, "Malformed parameter");
+        continue;
+      }
+      const char *nameEnd = p++;
+      sfzero::StringSlice name(nameStart, nameEnd);
+      const char *valueStart = p;
+      p = ((name == "sample") || (name == "default_path")) ? findPathEnd(p, end) : skipWord(p, end);
+      add(opcodeElement, line, nameStart, nameEnd, valueStart, p);
+    }
+  }
+}
+
+void sfzero::Fragment::add(ElementType type, int line, const char *nameStart, const char *nameEnd,
+                           const char *valueStart, const char *valueEnd)
+{
+  Element element = {type,
+                     line,
+                     static_cast<juce::uint32>(nameStart - text_),
+                     static_cast<juce::uint32>(nameEnd - nameStart),
+                     static_cast<juce::uint32>(valueStart - text_),
+                     static_cast<juce::uint32>(valueEnd - valueStart)};
+  elements_.add(element);
+}
+
+void sfzero::Fragment::addError(int line, const juce::String &message)
+{
+  Element element = {errorElement, line, 0, 0, static_cast<juce::uint32>(messages_.size()), 0};
+  elements_.add(element);
+  messages_.add(message);
+}
+
+sfzero::ParseCache &sfzero::ParseCache::getInstance()
+{
+  static ParseCache cache;
+  return cache;
+}
+
+sfzero::ParseCache::ParseCache() : bytes_(0), maxBytes_(64 * 1024 * 1024), useCounter_(0), numHits_(0), numMisses_(0)
+{
+}
+
+sfzero::ParseCache::~ParseCache() {}
+
+sfzero::Fragment::Ptr sfzero::ParseCache::getFragment(const juce::File &file)
+{
+  juce::String path = file.getFullPathName();
+  juce::Time modified = file.getLastModificationTime();
+  {
+    const juce::ScopedLock locker(lock_);
+    for (auto &entry : entries_)
+    {
+      if ((entry.path == path) && (entry.modified == modified))
+      {
+        entry.lastUsed = ++useCounter_;
+        numHits_ += 1;
+        return entry.fragment;
+      }
+    }
+  }
+
+  // Lex outside the lock; if two threads miss on the same file at once, the
+  // second one's copy replaces the first.
+  Fragment::Ptr fragment = readFragment(file);
+  if (fragment == nullptr)
+  {
+    return nullptr;
+  }
+  numMisses_ += 1;
+
+  const juce::ScopedLock locker(lock_);
+  for (int i = entries_.size(); --i >= 0;)
+  {
+    if (entries_.getReference(i).path == path)
+    {
+      bytes_ -= entries_.getReference(i).fragment->getMemoryUsage();
+      entries_.remove(i);
+    }
+  }
+  Entry entry = {path, modified, fragment, ++useCounter_};
+  entries_.add(entry);
+  bytes_ += fragment->getMemoryUsage();
+  trim();
+  return fragment;
+}
+
+void sfzero::ParseCache::setMaxBytes(juce::int64 bytes)
+{
+  const juce::ScopedLock locker(lock_);
+  maxBytes_ = bytes;
+  trim();
+}
+
+void sfzero::ParseCache::clear()
+{
+  const juce::ScopedLock locker(lock_);
+  entries_.clear();
+  bytes_ = 0;
+}
+
+juce::int64 sfzero::ParseCache::getBytes()
+{
+  const juce::ScopedLock locker(lock_);
+  return bytes_;
+}
+
+sfzero::Fragment::Ptr sfzero::ParseCache::readFragment(const juce::File &file)
+{
+#if !JUCE_WINDOWS
+  // Windows won't let a mapped file be saved over, which would get in the way
+  // of editing an instrument while it's cached, so it reads the file instead.
+  std::unique_ptr<juce::MemoryMappedFile> mappedFile(
+      new juce::MemoryMappedFile(file, juce::MemoryMappedFile::readOnly));
+  if (mappedFile->getData() != nullptr)
+  {
+    return new Fragment(mappedFile.release());
+  }
+#endif
+
+  // Mapping fails for empty files, and on some file systems.
+  juce::MemoryBlock contents;
+  if (!file.loadFileAsData(contents))
+  {
+    return nullptr;
+  }
+  return new Fragment(contents);
+}
+
+void sfzero::ParseCache::trim()
+{
+  // Called with the lock held.  Fragments still in use by a reader stay
+  // alive through its reference.
+  while ((bytes_ > maxBytes_) && (entries_.size() > 0))
+  {
+    int oldest = 0;
+    for (int i = 1; i < entries_.size(); ++i)
+    {
+      if (entries_.getReference(i).lastUsed < entries_.getReference(oldest).lastUsed)
+      {
+        oldest = i;
+      }
+    }
+    bytes_ -= entries_.getReference(oldest).fragment->getMemoryUsage();
+    entries_.remove(oldest);
+  }
+}
@@ -0,0 +1,122 @@
+/*************************************************************************************
+ * Original code copyright (C) 2012 Steve Folta
+ * Converted to Juce module (C) 2016 Leo Olivers
+ * Forked from https://github.com/stevefolta/SFZero
+ * For license info please see the LICENSE file distributed with this source code
+ *************************************************************************************/
+#ifndef SFZPARSECACHE_H_INCLUDED
+#define SFZPARSECACHE_H_INCLUDED
+
+#include "SFZReader.h"
+
+namespace sfzero
+{
+
+// The text of an SFZ file, split into headers, opcodes and preprocessor
+// directives.  Nothing is interpreted yet: what an element means depends on
+// where it ends up (an included file's regions belong to the including
+// file's group, and #defines are textual), so that is left to the Reader.
+class Fragment : public juce::ReferenceCountedObject
+{
+public:
+  typedef juce::ReferenceCountedObjectPtr<Fragment> Ptr;
+
+  enum ElementType
+  {
+    tagElement,     // Name is the header, without the angle brackets.
+    opcodeElement,  // Name and value.
+    includeElement, // Value is the path, without the quotes.
+    defineElement,  // Name is the variable, including the "$"; value is what it stands for.
+    errorElement    // Value indexes the messages.
+  };
+
+  struct Element
+  {
+    ElementType type;
+    int line;
+    juce::uint32 nameStart, nameLength;
+    juce::uint32 valueStart, valueLength;
+  };
+
+  // Lexes text that must outlive the fragment.
+  Fragment(const char *text, size_t length);
+  // Lexes a mapped file, taking ownership of it.
+  explicit Fragment(juce::MemoryMappedFile *mappedFile);
+  // Lexes text read into memory, taking it from "contents".
+  explicit Fragment(juce::MemoryBlock &contents);
+  ~Fragment();
+
+  int getNumElements() const { return elements_.size(); }
+  const Element &getElement(int index) const { return elements_.getReference(index); }
+  StringSlice getName(const Element &element) const { return slice(element.nameStart, element.nameLength); }
+  StringSlice getValue(const Element &element) const { return slice(element.valueStart, element.valueLength); }
+  juce::String getMessage(const Element &element) const { return messages_[static_cast<int>(element.valueStart)]; }
+  juce::int64 getMemoryUsage() const;
+
+private:
+  void lex();
+  void add(ElementType type, int line, const char *nameStart, const char *nameEnd, const char *valueStart,
+           const char *valueEnd);
+  void addError(int line, const juce::String &message);
+  StringSlice slice(juce::uint32 start, juce::uint32 length) const
+  {
+    return StringSlice(text_ + start, text_ + start + length);
+  }
+
+  // Elements point into the text rather than copying it, so whatever holds
+  // it is kept as long as the fragment is.
+  const char *text_;
+  size_t length_;
+  std::unique_ptr<juce::MemoryMappedFile> mappedFile_;
+  juce::MemoryBlock contents_;
+  juce::Array<Element> elements_;
+  juce::StringArray messages_;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Fragment)
+};
+
+// Lexed SFZ files, kept so a file that is included many times (a shared
+// key map pulled into every articulation, say) is only read and lexed once.
+// Entries are keyed by path and modification time, so editing a file is
+// picked up on the next load.  The least recently used are dropped once the
+// cache outgrows its size limit.
+class ParseCache
+{
+public:
+  static ParseCache &getInstance();
+
+  // Returns null if the file can't be read.
+  Fragment::Ptr getFragment(const juce::File &file);
+
+  void setMaxBytes(juce::int64 bytes);
+  void clear();
+  juce::int64 getBytes();
+  int getNumHits() const { return numHits_.load(); }
+  int getNumMisses() const { return numMisses_.load(); }
+
+private:
+  ParseCache();
+  ~ParseCache();
+
+  struct Entry
+  {
+    juce::String path;
+    juce::Time modified;
+    Fragment::Ptr fragment;
+    juce::uint32 lastUsed;
+  };
+
+  static Fragment::Ptr readFragment(const juce::File &file);
+  void trim();
+
+  juce::Array<Entry> entries_;
+  juce::int64 bytes_, maxBytes_;
+  juce::uint32 useCounter_;
+  std::atomic<int> numHits_, numMisses_;
+  juce::CriticalSection lock_;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ParseCache)
+};
+}
+
+#endif // SFZPARSECACHE_H_INCLUDED
@@ -0,0 +1,74 @@
+/*************************************************************************************
+ * Original code copyright (C) 2012 Steve Folta
+ * Converted to Juce module (C) 2016 Leo Olivers
+ * Forked from https://github.com/stevefolta/SFZero
+ * For license info please see the LICENSE file distributed with this source code
+ *************************************************************************************/
+#include "SFZPortableMath.h"
+
+double sfzero::PortableMath::exp2(double x)
+{
+  if (x != x)
+  {
+    return x;
+  }
+  if (x >= 1024.0)
+  {
+    return std::numeric_limits<double>::infinity();
+  }
+  if (x < -1075.0)
+  {
+    return 0.0;
+  }
+
+  // 2^x = 2^whole * e^(fraction * ln 2), with the fraction in [0, 1); the
+  // subtraction is exact.  The Taylor series then converges within 20 terms,
+  // and ldexp() only adjusts the exponent, so it's exact everywhere too.
+  double whole = static_cast<double>(static_cast<int>(x));
+  if (whole > x)
+  {
+    whole -= 1.0;
+  }
+  const double y = (x - whole) * 0.69314718055994530942;
+  double term = 1.0;
+  double sum = 1.0;
+  for (int i = 1; i <= 20; ++i)
+  {
+    term = term * y / i;
+    sum = sum + term;
+  }
+  return std::ldexp(sum, static_cast<int>(whole));
+}
+
+double sfzero::PortableMath::log2(double x)
+{
+  if (!(x > 0.0))
+  {
+    return -std::numeric_limits<double>::infinity();
+  }
+  if (x == std::numeric_limits<double>::infinity())
+  {
+    return x;
+  }
+
+  // x = mantissa * 2^exponent, exactly, with the mantissa in [sqrt(1/2),
+  // sqrt(2)); then ln(mantissa) = 2 atanh(s), s = (m - 1) / (m + 1), whose
+  // series in s (|s| < 0.18) converges within 16 terms.
+  int exponent = 0;
+  double mantissa = std::frexp(x, &exponent);
+  if (mantissa < 0.70710678118654752440)
+  {
+    mantissa *= 2.0;
+    exponent -= 1;
+  }
+  const double s = (mantissa - 1.0) / (mantissa + 1.0);
+  const double s2 = s * s;
+  double power = s;
+  double sum = 0.0;
+  for (int i = 1; i <= 31; i += 2)
+  {
+    sum = sum + power / i;
+    power = power * s2;
+  }
+  return exponent + sum * (2.0 * 1.4426950408889634074);
+}
@@ -0,0 +1,39 @@
+/*************************************************************************************
+ * Original code copyright (C) 2012 Steve Folta
+ * Converted to Juce module (C) 2016 Leo Olivers
+ * Forked from https://github.com/stevefolta/SFZero
+ * For license info please see the LICENSE file distributed with this source code
+ *************************************************************************************/
+#ifndef SFZPORTABLEMATH_H_INCLUDED
+#define SFZPORTABLEMATH_H_INCLUDED
+
+#include "SFZCommon.h"
+
+namespace sfzero
+{
+// The few transcendental functions a voice needs for a note's pitch, gain,
+// envelope and modulators, built from nothing but double addition, subtraction,
+// multiplication and division.  IEEE 754 rounds those the same way on every
+// platform, so unlike libm's, which differ in their last bit between
+// libraries, these give the same result everywhere the compiler evaluates
+// them as written (without fusing a multiply and an add into an FMA).
+// They're slower than libm's, so only the deterministic rendering mode uses
+// them; see Voice::setFixedPointPhase().
+namespace PortableMath
+{
+double exp2(double x);
+double log2(double x); // -infinity for zero or less.
+
+inline double exp(double x) { return exp2(x * 1.4426950408889634074); }
+inline double log(double x) { return log2(x) * 0.69314718055994530942; }
+inline double log10(double x) { return log2(x) * 0.30102999566398119521; }
+
+// Like juce::Decibels::decibelsToGain(): -100 dB or less is silence.
+inline double decibelsToGain(double decibels)
+{
+  return (decibels > -100.0) ? exp2(decibels * (3.3219280948873623479 / 20.0)) : 0.0;
+}
+}
+}
+
+#endif // SFZPORTABLEMATH_H_INCLUDED
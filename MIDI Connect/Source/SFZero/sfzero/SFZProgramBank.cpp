@@ -0,0 +1,336 @@
+/*************************************************************************************
+ * Original code copyright (C) 2012 Steve Folta
+ * Converted to Juce module (C) 2016 Leo Olivers
+ * Forked from https://github.com/stevefolta/SFZero
+ * For license info please see the LICENSE file distributed with this source code
+ *************************************************************************************/
+#include "SFZProgramBank.h"
+#include "SF2Sound.h"
+#include "SFZResidencyManager.h"
+#include "SFZSynth.h"
+
+sfzero::ProgramBank::ProgramBank(sfzero::Synth &synthIn)
+    : synth_(synthIn), numPrograms_(0), currentProgram_(0), requestedProgram_(-1), memoryBudget_(1024 * 1024 * 1024),
+      compressSamples_(false), loadPresetsOnDemand_(false), formatManager_(nullptr), residencyManager_(nullptr)
+{
+}
+
+sfzero::ProgramBank::~ProgramBank() { clear(); }
+
+void sfzero::ProgramBank::clear()
+{
+  const juce::ScopedLock locker(loadLock_);
+
+  int numPrograms = getNumPrograms();
+  numPrograms_.store(0);
+  for (int i = 0; i < numPrograms; ++i)
+  {
+    releaseProgram(i);
+    programs_[i].file = juce::File();
+    programs_[i].subsound = 0;
+    programs_[i].name = juce::String();
+  }
+  currentProgram_.store(0);
+  requestedProgram_.store(-1);
+}
+
+int sfzero::ProgramBank::addProgram(const juce::File &file, int subsound)
+{
+  // useTimeSlice() may be loading a program on the background thread.
+  const juce::ScopedLock locker(loadLock_);
+
+  int number = getNumPrograms();
+  if (number >= maxPrograms)
+  {
+    return -1;
+  }
+
+  Program &program = programs_[number];
+  program.file = file;
+  program.subsound = subsound;
+  program.name = file.getFileNameWithoutExtension();
+  if (subsound != 0)
+  {
+    program.name << " " << subsound;
+  }
+  program.lastUsed.store(0);
+  numPrograms_.store(number + 1);
+  return number;
+}
+
+juce::String sfzero::ProgramBank::getProgramName(int number) const
+{
+  return juce::isPositiveAndBelow(number, getNumPrograms()) ? programs_[number].name : juce::String();
+}
+
+juce::File sfzero::ProgramBank::getProgramFile(int number) const
+{
+  return juce::isPositiveAndBelow(number, getNumPrograms()) ? programs_[number].file : juce::File();
+}
+
+int sfzero::ProgramBank::getProgramSubsound(int number) const
+{
+  return juce::isPositiveAndBelow(number, getNumPrograms()) ? programs_[number].subsound : 0;
+}
+
+bool sfzero::ProgramBank::isResident(int number) const
+{
+  return juce::isPositiveAndBelow(number, getNumPrograms()) && (programs_[number].sound.load() != nullptr);
+}
+
+juce::int64 sfzero::ProgramBank::getResidentBytes()
+{
+  const juce::ScopedLock locker(loadLock_);
+
+  // Presets of the same SF2 file share one sound, so count each sound once.
+  juce::Array<sfzero::Sound *> sounds;
+  juce::int64 bytes = 0;
+  for (int i = getNumPrograms(); --i >= 0;)
+  {
+    sfzero::Sound *sound = programs_[i].owner.get();
+    if ((sound != nullptr) && sounds.addIfNotAlreadyThere(sound))
+    {
+      bytes += sound->getSampleMemoryUsage();
+    }
+  }
+  return bytes;
+}
+
+void sfzero::ProgramBank::load(juce::AudioFormatManager *formatManager, double *progressVar, juce::Thread *thread)
+{
+  const juce::ScopedLock locker(loadLock_);
+
+  formatManager_ = formatManager;
+  int numPrograms = getNumPrograms();
+
+  // The selected program first, whatever the budget says, so there's
+  // something to play as soon as possible.
+  int current = currentProgram_.load();
+  if (juce::isPositiveAndBelow(current, numPrograms) && loadProgram(current, thread))
+  {
+    selectProgram(current);
+  }
+
+  for (int i = 0; i < numPrograms; ++i)
+  {
+    if (progressVar)
+    {
+      *progressVar = static_cast<double>(i) / numPrograms;
+    }
+    if (thread && thread->threadShouldExit())
+    {
+      return;
+    }
+    if (isResident(i))
+    {
+      continue;
+    }
+    if (getResidentBytes() >= memoryBudget_)
+    {
+      break;
+    }
+    if (loadProgram(i, thread) && (getResidentBytes() > memoryBudget_))
+    {
+      // Doesn't fit; it, and the rest, will be loaded when they're selected.
+      releaseProgram(i);
+      break;
+    }
+  }
+
+  if (progressVar)
+  {
+    *progressVar = 1.0;
+  }
+}
+
+void sfzero::ProgramBank::selectProgram(int number)
+{
+  if (!juce::isPositiveAndBelow(number, getNumPrograms()))
+  {
+    return;
+  }
+
+  Program &program = programs_[number];
+  currentProgram_.store(number);
+  program.lastUsed.store(juce::Time::getMillisecondCounter());
+  sfzero::Sound *sound = program.sound.load();
+  if (sound)
+  {
+    sound->useSubsound(program.subsound);
+    synth_.selectSound(sound);
+  }
+  else
+  {
+    // Keeps playing the previous program until this one is loaded.
+    requestedProgram_.store(number);
+  }
+}
+
+int sfzero::ProgramBank::useTimeSlice()
+{
+  int requested = requestedProgram_.exchange(-1);
+  if ((requested < 0) || (formatManager_ == nullptr))
+  {
+    return 20;
+  }
+
+  const juce::ScopedTryLock locker(loadLock_);
+  if (!locker.isLocked())
+  {
+    // load() is busy; try again once it's done.
+    int none = -1;
+    requestedProgram_.compare_exchange_strong(none, requested);
+    return 100;
+  }
+
+  if (loadProgram(requested, juce::Thread::getCurrentThread()))
+  {
+    evictFor(requested);
+    if (currentProgram_.load() == requested)
+    {
+      selectProgram(requested);
+    }
+  }
+  return 20;
+}
+
+sfzero::Sound *sfzero::ProgramBank::createSound(const juce::File &file)
+{
+  if (!file.existsAsFile())
+  {
+    return nullptr;
+  }
+
+  auto extension = file.getFileExtension();
+  if ((extension == ".sf2") || (extension == ".SF2") || (extension == ".sf3") || (extension == ".SF3"))
+  {
+    return new sfzero::SF2Sound(file);
+  }
+  return new sfzero::Sound(file);
+}
+
+bool sfzero::ProgramBank::loadProgram(int number, juce::Thread *thread)
+{
+  Program &program = programs_[number];
+  if (program.sound.load() != nullptr)
+  {
+    return true;
+  }
+
+  // Presets of the same SF2 file share its sound.
+  sfzero::Sound::Ptr sound;
+  for (int i = getNumPrograms(); --i >= 0;)
+  {
+    if ((programs_[i].owner != nullptr) && (programs_[i].file == program.file))
+    {
+      sound = programs_[i].owner;
+      break;
+    }
+  }
+  if (sound == nullptr)
+  {
+    sound = createSound(program.file);
+    if (sound == nullptr)
+    {
+      return false;
+    }
+    sfzero::SF2Sound *sf2Sound = dynamic_cast<sfzero::SF2Sound *>(sound.get());
+    if (sf2Sound)
+    {
+      sf2Sound->setLoadPresetsOnDemand(loadPresetsOnDemand_);
+    }
+    sound->loadRegions();
+    sound->setCompressSamples(compressSamples_);
+    // Not published yet, so this only decides what loading presets on
+    // demand reads.
+    sound->useSubsound(program.subsound);
+    sound->loadSamples(formatManager_, nullptr, thread);
+    if (thread && thread->threadShouldExit())
+    {
+      return false;
+    }
+    if (residencyManager_)
+    {
+      residencyManager_->addSound(sound.get());
+    }
+  }
+  else if (sfzero::SF2Sound *sf2Sound = dynamic_cast<sfzero::SF2Sound *>(sound.get()))
+  {
+    sf2Sound->loadPresetSamples(program.subsound, formatManager_, nullptr, thread);
+    if (thread && thread->threadShouldExit())
+    {
+      return false;
+    }
+  }
+
+  if (sound->numSubsounds() > 1)
+  {
+    program.name = sound->subsoundName(program.subsound);
+  }
+  program.owner = sound;
+  program.sound.store(sound.get());
+  return true;
+}
+
+void sfzero::ProgramBank::releaseProgram(int number)
+{
+  Program &program = programs_[number];
+  program.sound.store(nullptr);
+  sfzero::Sound::Ptr sound = program.owner;
+  program.owner = nullptr;
+  if (sound == nullptr)
+  {
+    return;
+  }
+
+  // Presets of one SF2 file share its sound; it's retired when the last of
+  // them lets it go.
+  for (int i = getNumPrograms(); --i >= 0;)
+  {
+    if (programs_[i].owner.get() == sound.get())
+    {
+      return;
+    }
+  }
+  // The audio thread may have just selected it, so let the synth decide
+  // when it's safe to delete.
+  synth_.retireSound(sound.get());
+}
+
+void sfzero::ProgramBank::evictFor(int keepProgram)
+{
+  sfzero::Sound *keep = programs_[keepProgram].owner.get();
+  int numPrograms = getNumPrograms();
+  while (getResidentBytes() > memoryBudget_)
+  {
+    // Least recently used first, leaving the program just loaded and
+    // whatever is playing now.
+    int victim = -1;
+    for (int i = 0; i < numPrograms; ++i)
+    {
+      sfzero::Sound *sound = programs_[i].owner.get();
+      if ((sound == nullptr) || (sound == keep) || (sound == synth_.getCurrentSound()))
+      {
+        continue;
+      }
+      if ((victim < 0) || (programs_[i].lastUsed.load() < programs_[victim].lastUsed.load()))
+      {
+        victim = i;
+      }
+    }
+    if (victim < 0)
+    {
+      break;
+    }
+
+    // Its memory is only freed once no program uses its sound.
+    sfzero::Sound *victimSound = programs_[victim].owner.get();
+    for (int i = 0; i < numPrograms; ++i)
+    {
+      if (programs_[i].owner.get() == victimSound)
+      {
+        releaseProgram(i);
+      }
+    }
+  }
+}
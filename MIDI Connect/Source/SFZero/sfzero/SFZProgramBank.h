@@ -0,0 +1,99 @@
+/*************************************************************************************
+ * Original code copyright (C) 2012 Steve Folta
+ * Converted to Juce module (C) 2016 Leo Olivers
+ * Forked from https://github.com/stevefolta/SFZero
+ * For license info please see the LICENSE file distributed with this source code
+ *************************************************************************************/
+#ifndef SFZPROGRAMBANK_H_INCLUDED
+#define SFZPROGRAMBANK_H_INCLUDED
+
+#include "SFZSound.h"
+
+namespace sfzero
+{
+
+class ResidencyManager;
+class Synth;
+
+// A bank of up to 128 programs (an SFZ file, or a preset of an SF2 file),
+// loaded ahead of time so a MIDI program change is just a pointer switch on
+// the audio thread.  Programs are loaded in order until the memory budget is
+// used up; selecting one that isn't resident queues it to be loaded by
+// useTimeSlice(), evicting the least recently used programs to make room.
+class ProgramBank : public juce::TimeSliceClient
+{
+public:
+  enum
+  {
+    maxPrograms = 128
+  };
+
+  explicit ProgramBank(Synth &synth);
+  ~ProgramBank();
+
+  // Setting up the bank.  These wait for load() or useTimeSlice() to finish
+  // with the programs.
+  void clear();
+  int addProgram(const juce::File &file, int subsound = 0); // Returns the program number, or -1 if the bank is full.
+  void setMemoryBudget(juce::int64 bytes) { memoryBudget_ = bytes; }
+  juce::int64 getMemoryBudget() const { return memoryBudget_; }
+  void setResidencyManager(ResidencyManager *manager) { residencyManager_ = manager; }
+  void setCompressSamples(bool shouldCompress) { compressSamples_ = shouldCompress; }
+  // For SF2 files, read just the samples of the presets that are programs
+  // (see SF2Sound::setLoadPresetsOnDemand()).
+  void setLoadPresetsOnDemand(bool shouldLoadOnDemand) { loadPresetsOnDemand_ = shouldLoadOnDemand; }
+
+  int getNumPrograms() const { return numPrograms_.load(); }
+  juce::String getProgramName(int number) const;
+  juce::File getProgramFile(int number) const;
+  int getProgramSubsound(int number) const;
+  bool isResident(int number) const;
+  juce::int64 getResidentBytes();
+
+  // Loads programs, in order, until the budget is used up.  The selected
+  // program is made current as soon as it is loaded.
+  void load(juce::AudioFormatManager *formatManager, double *progressVar = nullptr, juce::Thread *thread = nullptr);
+
+  // Safe to call from the audio thread.
+  void selectProgram(int number);
+  int getCurrentProgram() const { return currentProgram_.load(); }
+
+  // Loads programs that were selected while they weren't resident.
+  int useTimeSlice() override;
+
+  static Sound *createSound(const juce::File &file);
+
+private:
+  struct Program
+  {
+    Program() : subsound(0), sound(nullptr), lastUsed(0) {}
+
+    juce::File file;
+    int subsound;
+    juce::String name;
+    std::atomic<Sound *> sound; // Set while resident; "owner" holds the reference.
+    Sound::Ptr owner;
+    std::atomic<juce::uint32> lastUsed;
+  };
+
+  bool loadProgram(int number, juce::Thread *thread);
+  void releaseProgram(int number);
+  void evictFor(int keepProgram);
+
+  Synth &synth_;
+  Program programs_[maxPrograms];
+  std::atomic<int> numPrograms_;
+  std::atomic<int> currentProgram_;
+  std::atomic<int> requestedProgram_;
+  juce::int64 memoryBudget_;
+  bool compressSamples_;
+  bool loadPresetsOnDemand_;
+  juce::AudioFormatManager *formatManager_;
+  ResidencyManager *residencyManager_;
+  juce::CriticalSection loadLock_;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ProgramBank)
+};
+}
+
+#endif // SFZPROGRAMBANK_H_INCLUDED
@@ -5,505 +5,640 @@
  * For license info please see the LICENSE file distributed with this source code
  *************************************************************************************/
 #include "SFZReader.h"
-#include "SFZRegion.h"
+#include "SFZParseCache.h"
 #include "SFZSound.h"
 
-sfzero::Reader::Reader(sfzero::Sound *soundIn) : sound_(soundIn), line_(1) {}
+namespace
+{
+enum Opcode
+{
+  unknownOpcode,
+  sampleOpcode,
+  lokeyOpcode,
+  hikeyOpcode,
+  keyOpcode,
+  lovelOpcode,
+  hivelOpcode,
+  triggerOpcode,
+  groupOpcode,
+  offByOpcode,
+  offsetOpcode,
+  endOpcode,
+  loopModeOpcode,
+  loopStartOpcode,
+  loopEndOpcode,
+  loopCrossfadeOpcode,
+  transposeOpcode,
+  tuneOpcode,
+  pitchKeycenterOpcode,
+  pitchKeytrackOpcode,
+  bendUpOpcode,
+  bendDownOpcode,
+  volumeOpcode,
+  panOpcode,
+  ampVeltrackOpcode,
+  ampegDelayOpcode,
+  ampegStartOpcode,
+  ampegAttackOpcode,
+  ampegHoldOpcode,
+  ampegDecayOpcode,
+  ampegSustainOpcode,
+  ampegReleaseOpcode,
+  ampegVel2DelayOpcode,
+  ampegVel2AttackOpcode,
+  ampegVel2HoldOpcode,
+  ampegVel2DecayOpcode,
+  ampegVel2SustainOpcode,
+  ampegVel2ReleaseOpcode,
+  defaultPathOpcode
+};
+
+// FNV-1a, usable in case labels.  The compiler rejects duplicate labels, so
+// the known opcodes are guaranteed to hash apart; anything else that lands
+// on one of them is caught by the string comparison.
+constexpr juce::uint32 opcodeHash(const char *text, size_t length)
+{
+  juce::uint32 hash = 2166136261u;
+  for (size_t i = 0; i < length; ++i)
+  {
+    hash = (hash ^ static_cast<juce::uint8>(text[i])) * 16777619u;
+  }
+  return hash;
+}
+
+template <size_t length> constexpr juce::uint32 opcodeHash(const char (&text)[length])
+{
+  return opcodeHash(text, length - 1);
+}
+
+Opcode matchOpcode(const sfzero::StringSlice &opcode, const char *name, Opcode value)
+{
+  return (opcode == name) ? value : unknownOpcode;
+}
+
+Opcode lookupOpcode(const sfzero::StringSlice &opcode)
+{
+  switch (opcodeHash(opcode.getStart(), opcode.length()))
+  {
+  case opcodeHash("sample"):
+    return matchOpcode(opcode, "sample", sampleOpcode);
+  case opcodeHash("lokey"):
+    return matchOpcode(opcode, "lokey", lokeyOpcode);
+  case opcodeHash("hikey"):
+    return matchOpcode(opcode, "hikey", hikeyOpcode);
+  case opcodeHash("key"):
+    return matchOpcode(opcode, "key", keyOpcode);
+  case opcodeHash("lovel"):
+    return matchOpcode(opcode, "lovel", lovelOpcode);
+  case opcodeHash("hivel"):
+    return matchOpcode(opcode, "hivel", hivelOpcode);
+  case opcodeHash("trigger"):
+    return matchOpcode(opcode, "trigger", triggerOpcode);
+  case opcodeHash("group"):
+    return matchOpcode(opcode, "group", groupOpcode);
+  case opcodeHash("off_by"):
+    return matchOpcode(opcode, "off_by", offByOpcode);
+  case opcodeHash("offset"):
+    return matchOpcode(opcode, "offset", offsetOpcode);
+  case opcodeHash("end"):
+    return matchOpcode(opcode, "end", endOpcode);
+  case opcodeHash("loop_mode"):
+    return matchOpcode(opcode, "loop_mode", loopModeOpcode);
+  case opcodeHash("loop_start"):
+    return matchOpcode(opcode, "loop_start", loopStartOpcode);
+  case opcodeHash("loop_end"):
+    return matchOpcode(opcode, "loop_end", loopEndOpcode);
+  case opcodeHash("loop_crossfade"):
+    return matchOpcode(opcode, "loop_crossfade", loopCrossfadeOpcode);
+  case opcodeHash("transpose"):
+    return matchOpcode(opcode, "transpose", transposeOpcode);
+  case opcodeHash("tune"):
+    return matchOpcode(opcode, "tune", tuneOpcode);
+  case opcodeHash("pitch_keycenter"):
+    return matchOpcode(opcode, "pitch_keycenter", pitchKeycenterOpcode);
+  case opcodeHash("pitch_keytrack"):
+    return matchOpcode(opcode, "pitch_keytrack", pitchKeytrackOpcode);
+  case opcodeHash("bend_up"):
+    return matchOpcode(opcode, "bend_up", bendUpOpcode);
+  case opcodeHash("bend_down"):
+    return matchOpcode(opcode, "bend_down", bendDownOpcode);
+  case opcodeHash("volume"):
+    return matchOpcode(opcode, "volume", volumeOpcode);
+  case opcodeHash("pan"):
+    return matchOpcode(opcode, "pan", panOpcode);
+  case opcodeHash("amp_veltrack"):
+    return matchOpcode(opcode, "amp_veltrack", ampVeltrackOpcode);
+  case opcodeHash("ampeg_delay"):
+    return matchOpcode(opcode, "ampeg_delay", ampegDelayOpcode);
+  case opcodeHash("ampeg_start"):
+    return matchOpcode(opcode, "ampeg_start", ampegStartOpcode);
+  case opcodeHash("ampeg_attack"):
+    return matchOpcode(opcode, "ampeg_attack", ampegAttackOpcode);
+  case opcodeHash("ampeg_hold"):
+    return matchOpcode(opcode, "ampeg_hold", ampegHoldOpcode);
+  case opcodeHash("ampeg_decay"):
+    return matchOpcode(opcode, "ampeg_decay", ampegDecayOpcode);
+  case opcodeHash("ampeg_sustain"):
+    return matchOpcode(opcode, "ampeg_sustain", ampegSustainOpcode);
+  case opcodeHash("ampeg_release"):
+    return matchOpcode(opcode, "ampeg_release", ampegReleaseOpcode);
+  case opcodeHash("ampeg_vel2delay"):
+    return matchOpcode(opcode, "ampeg_vel2delay", ampegVel2DelayOpcode);
+  case opcodeHash("ampeg_vel2attack"):
+    return matchOpcode(opcode, "ampeg_vel2attack", ampegVel2AttackOpcode);
+  case opcodeHash("ampeg_vel2hold"):
+    return matchOpcode(opcode, "ampeg_vel2hold", ampegVel2HoldOpcode);
+  case opcodeHash("ampeg_vel2decay"):
+    return matchOpcode(opcode, "ampeg_vel2decay", ampegVel2DecayOpcode);
+  case opcodeHash("ampeg_vel2sustain"):
+    return matchOpcode(opcode, "ampeg_vel2sustain", ampegVel2SustainOpcode);
+  case opcodeHash("ampeg_vel2release"):
+    return matchOpcode(opcode, "ampeg_vel2release", ampegVel2ReleaseOpcode);
+  case opcodeHash("default_path"):
+    return matchOpcode(opcode, "default_path", defaultPathOpcode);
+  default:
+    return unknownOpcode;
+  }
+}
+
+inline bool isDigit(char c) { return (c >= '0') && (c <= '9'); }
+
+// Powers of ten that doubles hold exactly.
+const double exactPowersOfTen[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                   1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+double powerOfTen(int exponent)
+{
+  return (exponent <= 22) ? exactPowersOfTen[exponent] : std::pow(10.0, static_cast<double>(exponent));
+}
+}
+
+sfzero::Reader::Reader(sfzero::Sound *soundIn)
+    : sound_(soundIn), line_(1), includeDepth_(0), buildingRegion_(nullptr), inControl_(false)
+{
+}
 
 sfzero::Reader::~Reader() {}
 
 void sfzero::Reader::read(const juce::File &file)
 {
-  juce::MemoryBlock contents;
-  bool ok = file.loadFileAsData(contents);
-
-  if (!ok)
+  sfzero::Fragment::Ptr fragment = sfzero::ParseCache::getInstance().getFragment(file);
+  if (fragment == nullptr)
   {
     sound_->addError("Couldn't read \"" + file.getFullPathName() + "\"");
     return;
   }
 
-  read(static_cast<const char *>(contents.getData()), static_cast<int>(contents.getSize()));
+  begin();
+  apply(*fragment);
+  if (buildingRegion_ && (buildingRegion_ == &curRegion_))
+  {
+    finishRegion(buildingRegion_);
+  }
 }
 
 void sfzero::Reader::read(const char *text, unsigned int length)
 {
-  const char *p = text;
-  const char *end = text + length;
-  char c = 0;
+  sfzero::Fragment fragment(text, length);
+
+  begin();
+  apply(fragment);
+  if (buildingRegion_ && (buildingRegion_ == &curRegion_))
+  {
+    finishRegion(buildingRegion_);
+  }
+}
 
-  sfzero::Region curGroup;
-  sfzero::Region curRegion;
-  sfzero::Region *buildingRegion = nullptr;
-  bool inControl = false;
-  juce::String defaultPath;
+void sfzero::Reader::begin()
+{
+  line_ = 1;
+  fileName_ = juce::String();
+  includeDepth_ = 0;
+  curGroup_.clear();
+  curRegion_.clear();
+  buildingRegion_ = nullptr;
+  inControl_ = false;
+  defaultPath_ = juce::String();
+  defines_.clear();
+}
 
-  while (p < end)
+void sfzero::Reader::apply(const sfzero::Fragment &fragment)
+{
+  int numElements = fragment.getNumElements();
+  for (int i = 0; i < numElements; ++i)
   {
-    // We're at the start of a line; skip any whitespace.
-    while (p < end)
-    {
-      c = *p;
-      if ((c != ' ') && (c != '\t'))
-      {
-        break;
-      }
-      p += 1;
-    }
-    if (p >= end)
+    const sfzero::Fragment::Element &element = fragment.getElement(i);
+    line_ = element.line;
+    switch (element.type)
     {
+    case sfzero::Fragment::tagElement:
+      handleTag(fragment.getName(element));
+      break;
+    case sfzero::Fragment::opcodeElement:
+      handleOpcode(fragment.getName(element), expand(fragment.getValue(element)));
+      break;
+    case sfzero::Fragment::includeElement:
+      include(expand(fragment.getValue(element)));
+      break;
+    case sfzero::Fragment::defineElement:
+      define(fragment.getName(element), expand(fragment.getValue(element)));
+      break;
+    case sfzero::Fragment::errorElement:
+      error(fragment.getMessage(element));
       break;
     }
+  }
+}
 
-    // Check if it's a comment line.
-    if (c == '/')
+void sfzero::Reader::handleTag(const sfzero::StringSlice &tag)
+{
+  if (tag == "region")
+  {
+    if (buildingRegion_ && (buildingRegion_ == &curRegion_))
     {
-      // Skip to end of line.
-      while (p < end)
-      {
-        c = *++p;
-        if ((c == '\n') || (c == '\r'))
-        {
-          break;
-        }
-      }
-      p = handleLineEnd(p);
-      continue;
+      finishRegion(&curRegion_);
     }
+    curRegion_ = curGroup_;
+    buildingRegion_ = &curRegion_;
+    inControl_ = false;
+  }
+  else if (tag == "group")
+  {
+    if (buildingRegion_ && (buildingRegion_ == &curRegion_))
+    {
+      finishRegion(&curRegion_);
+    }
+    curGroup_.clear();
+    buildingRegion_ = &curGroup_;
+    inControl_ = false;
+  }
+  else if (tag == "control")
+  {
+    if (buildingRegion_ && (buildingRegion_ == &curRegion_))
+    {
+      finishRegion(&curRegion_);
+    }
+    curGroup_.clear();
+    buildingRegion_ = nullptr;
+    inControl_ = true;
+  }
+  else
+  {
+    error("Illegal tag");
+  }
+}
 
-    // Check if it's a blank line.
-    if ((c == '\r') || (c == '\n'))
+void sfzero::Reader::handleOpcode(const sfzero::StringSlice &opcode, const sfzero::StringSlice &value)
+{
+  Opcode which = lookupOpcode(opcode);
+  if (inControl_)
+  {
+    if (which == defaultPathOpcode)
     {
-      p = handleLineEnd(p);
-      continue;
+      defaultPath_ = value.toString();
     }
+    else
+    {
+      sound_->addUnsupportedOpcode(opcode.toString() + " (in <control>)");
+    }
+    return;
+  }
 
-    // Handle elements on the line.
-    while (p < end)
+  if (which == sampleOpcode)
+  {
+    if (value.isEmpty())
     {
-      c = *p;
+      error("Empty sample path");
+    }
+    else if (buildingRegion_)
+    {
+      buildingRegion_->sample = sound_->addSample(value.toString(), defaultPath_);
+    }
+    else
+    {
+      error("Adding sample outside a group or region");
+    }
+    return;
+  }
 
-      // Tag.
-      if (c == '<')
-      {
-        p += 1;
-        const char *tagStart = p;
-        while (p < end)
-        {
-          c = *p++;
-          if ((c == '\n') || (c == '\r'))
-          {
-            error("Unterminated tag");
-            goto fatalError;
-          }
-          else if (c == '>')
-          {
-            break;
-          }
-        }
-        if (p >= end)
-        {
-          error("Unterminated tag");
-          goto fatalError;
-        }
-        sfzero::StringSlice tag(tagStart, p - 1);
-        if (tag == "region")
-        {
-          if (buildingRegion && (buildingRegion == &curRegion))
-          {
-            finishRegion(&curRegion);
-          }
-          curRegion = curGroup;
-          buildingRegion = &curRegion;
-          inControl = false;
-        }
-        else if (tag == "group")
-        {
-          if (buildingRegion && (buildingRegion == &curRegion))
-          {
-            finishRegion(&curRegion);
-          }
-          curGroup.clear();
-          buildingRegion = &curGroup;
-          inControl = false;
-        }
-        else if (tag == "control")
-        {
-          if (buildingRegion && (buildingRegion == &curRegion))
-          {
-            finishRegion(&curRegion);
-          }
-          curGroup.clear();
-          buildingRegion = nullptr;
-          inControl = true;
-        }
-        else
-        {
-          error("Illegal tag");
-        }
-      }
-      // Comment.
-      else if (c == '/')
-      {
-        // Skip to end of line.
-        while (p < end)
-        {
-          c = *p;
-          if ((c == '\r') || (c == '\n'))
-          {
-            break;
-          }
-          p += 1;
-        }
-      }
-      // Parameter.
-      else
-      {
-        // Get the parameter name.
-        const char *parameterStart = p;
-        while (p < end)
-        {
-          c = *p++;
-          if ((c == '=') || (c == ' ') || (c == '\t') || (c == '\r') || (c == '\n'))
-          {
-            break;
-          }
-        }
-        if ((p >= end) || (c != '='))
-        {
-          error("Malformed parameter");
-          goto nextElement;
-        }
-        sfzero::StringSlice opcode(parameterStart, p - 1);
-        if (inControl)
-        {
-          if (opcode == "default_path")
-          {
-            p = readPathInto(&defaultPath, p, end);
-          }
-          else
-          {
-            const char *valueStart = p;
-            while (p < end)
-            {
-              c = *p;
-              if ((c == ' ') || (c == '\t') || (c == '\n') || (c == '\r'))
-              {
-                break;
-              }
-              p++;
-            }
-            juce::String value(valueStart, p - valueStart);
-            juce::String fauxOpcode = juce::String(opcode.getStart(), opcode.length()) + " (in <control>)";
-            sound_->addUnsupportedOpcode(fauxOpcode);
-          }
-        }
-        else if (opcode == "sample")
-        {
-          juce::String path;
-          p = readPathInto(&path, p, end);
-          if (!path.isEmpty())
-          {
-            if (buildingRegion)
-            {
-              buildingRegion->sample = sound_->addSample(path, defaultPath);
-            }
-            else
-            {
-              error("Adding sample outside a group or region");
-            }
-          }
-          else
-          {
-            error("Empty sample path");
-          }
-        }
-        else
-        {
-          const char *valueStart = p;
-          while (p < end)
-          {
-            c = *p;
-            if ((c == ' ') || (c == '\t') || (c == '\n') || (c == '\r'))
-            {
-              break;
-            }
-            p++;
-          }
-          juce::String value(valueStart, p - valueStart);
-          if (buildingRegion == nullptr)
-          {
-            error("Setting a parameter outside a region or group");
-          }
-          else if (opcode == "lokey")
-          {
-            buildingRegion->lokey = keyValue(value);
-          }
-          else if (opcode == "hikey")
-          {
-            buildingRegion->hikey = keyValue(value);
-          }
-          else if (opcode == "key")
-          {
-            buildingRegion->hikey = buildingRegion->lokey = buildingRegion->pitch_keycenter = keyValue(value);
-          }
-          else if (opcode == "lovel")
-          {
-            buildingRegion->lovel = value.getIntValue();
-          }
-          else if (opcode == "hivel")
-          {
-            buildingRegion->hivel = value.getIntValue();
-          }
-          else if (opcode == "trigger")
-          {
-            buildingRegion->trigger = static_cast<sfzero::Region::Trigger>(triggerValue(value));
-          }
-          else if (opcode == "group")
-          {
-            buildingRegion->group = static_cast<int>(value.getLargeIntValue());
-          }
-          else if (opcode == "off_by")
-          {
-            buildingRegion->off_by = value.getLargeIntValue();
-          }
-          else if (opcode == "offset")
-          {
-            buildingRegion->offset = value.getLargeIntValue();
-          }
-          else if (opcode == "end")
-          {
-            juce::int64 end2 = value.getLargeIntValue();
-            if (end2 < 0)
-            {
-              buildingRegion->negative_end = true;
-            }
-            else
-            {
-              buildingRegion->end = end2;
-            }
-          }
-          else if (opcode == "loop_mode")
-          {
-            bool modeIsSupported = value == "no_loop" || value == "one_shot" || value == "loop_continuous";
-            if (modeIsSupported)
-            {
-              buildingRegion->loop_mode = static_cast<sfzero::Region::LoopMode>(loopModeValue(value));
-            }
-            else
-            {
-              juce::String fauxOpcode = juce::String(opcode.getStart(), opcode.length()) + "=" + value;
-              sound_->addUnsupportedOpcode(fauxOpcode);
-            }
-          }
-          else if (opcode == "loop_start")
-          {
-            buildingRegion->loop_start = value.getLargeIntValue();
-          }
-          else if (opcode == "loop_end")
-          {
-            buildingRegion->loop_end = value.getLargeIntValue();
-          }
-          else if (opcode == "transpose")
-          {
-            buildingRegion->transpose = value.getIntValue();
-          }
-          else if (opcode == "tune")
-          {
-            buildingRegion->tune = value.getIntValue();
-          }
-          else if (opcode == "pitch_keycenter")
-          {
-            buildingRegion->pitch_keycenter = keyValue(value);
-          }
-          else if (opcode == "pitch_keytrack")
-          {
-            buildingRegion->pitch_keytrack = value.getIntValue();
-          }
-          else if (opcode == "bend_up")
-          {
-            buildingRegion->bend_up = value.getIntValue();
-          }
-          else if (opcode == "bend_down")
-          {
-            buildingRegion->bend_down = value.getIntValue();
-          }
-          else if (opcode == "volume")
-          {
-            buildingRegion->volume = value.getFloatValue();
-          }
-          else if (opcode == "pan")
-          {
-            buildingRegion->pan = value.getFloatValue();
-          }
-          else if (opcode == "amp_veltrack")
-          {
-            buildingRegion->amp_veltrack = value.getFloatValue();
-          }
-          else if (opcode == "ampeg_delay")
-          {
-            buildingRegion->ampeg.delay = value.getFloatValue();
-          }
-          else if (opcode == "ampeg_start")
-          {
-            buildingRegion->ampeg.start = value.getFloatValue();
-          }
-          else if (opcode == "ampeg_attack")
-          {
-            buildingRegion->ampeg.attack = value.getFloatValue();
-          }
-          else if (opcode == "ampeg_hold")
-          {
-            buildingRegion->ampeg.hold = value.getFloatValue();
-          }
-          else if (opcode == "ampeg_decay")
-          {
-            buildingRegion->ampeg.decay = value.getFloatValue();
-          }
-          else if (opcode == "ampeg_sustain")
-          {
-            buildingRegion->ampeg.sustain = value.getFloatValue();
-          }
-          else if (opcode == "ampeg_release")
-          {
-            buildingRegion->ampeg.release = value.getFloatValue();
-          }
-          else if (opcode == "ampeg_vel2delay")
-          {
-            buildingRegion->ampeg_veltrack.delay = value.getFloatValue();
-          }
-          else if (opcode == "ampeg_vel2attack")
-          {
-            buildingRegion->ampeg_veltrack.attack = value.getFloatValue();
-          }
-          else if (opcode == "ampeg_vel2hold")
-          {
-            buildingRegion->ampeg_veltrack.hold = value.getFloatValue();
-          }
-          else if (opcode == "ampeg_vel2decay")
-          {
-            buildingRegion->ampeg_veltrack.decay = value.getFloatValue();
-          }
-          else if (opcode == "ampeg_vel2sustain")
-          {
-            buildingRegion->ampeg_veltrack.sustain = value.getFloatValue();
-          }
-          else if (opcode == "ampeg_vel2release")
-          {
-            buildingRegion->ampeg_veltrack.release = value.getFloatValue();
-          }
-          else if (opcode == "default_path")
-          {
-            error("\"default_path\" outside of <control> tag");
-          }
-          else
-          {
-            sound_->addUnsupportedOpcode(juce::String(opcode.getStart(), opcode.length()));
-          }
-        }
-      }
+  if (buildingRegion_ == nullptr)
+  {
+    error("Setting a parameter outside a region or group");
+    return;
+  }
 
-    // Skip to next element.
-    nextElement:
-      c = 0;
-      while (p < end)
-      {
-        c = *p;
-        if ((c != ' ') && (c != '\t'))
-        {
-          break;
-        }
-        p += 1;
-      }
-      if ((c == '\r') || (c == '\n'))
-      {
-        p = handleLineEnd(p);
-        break;
-      }
+  switch (which)
+  {
+  case lokeyOpcode:
+    buildingRegion_->lokey = keyValue(value);
+    break;
+  case hikeyOpcode:
+    buildingRegion_->hikey = keyValue(value);
+    break;
+  case keyOpcode:
+    buildingRegion_->hikey = buildingRegion_->lokey = buildingRegion_->pitch_keycenter = keyValue(value);
+    break;
+  case lovelOpcode:
+    buildingRegion_->lovel = intValue(value);
+    break;
+  case hivelOpcode:
+    buildingRegion_->hivel = intValue(value);
+    break;
+  case triggerOpcode:
+    buildingRegion_->trigger = static_cast<sfzero::Region::Trigger>(triggerValue(value));
+    break;
+  case groupOpcode:
+    buildingRegion_->group = static_cast<int>(int64Value(value));
+    break;
+  case offByOpcode:
+    buildingRegion_->off_by = int64Value(value);
+    break;
+  case offsetOpcode:
+    buildingRegion_->offset = int64Value(value);
+    break;
+  case endOpcode:
+  {
+    juce::int64 end2 = int64Value(value);
+    if (end2 < 0)
+    {
+      buildingRegion_->negative_end = true;
+    }
+    else
+    {
+      buildingRegion_->end = end2;
     }
+    break;
   }
-
-fatalError:
-  if (buildingRegion && (buildingRegion == &curRegion))
+  case loopModeOpcode:
   {
-    finishRegion(buildingRegion);
+    bool modeIsSupported = value == "no_loop" || value == "one_shot" || value == "loop_continuous";
+    if (modeIsSupported)
+    {
+      buildingRegion_->loop_mode = static_cast<sfzero::Region::LoopMode>(loopModeValue(value));
+    }
+    else
+    {
+      sound_->addUnsupportedOpcode(opcode.toString() + "=" + value.toString());
+    }
+    break;
+  }
+  case loopStartOpcode:
+    buildingRegion_->loop_start = int64Value(value);
+    break;
+  case loopEndOpcode:
+    buildingRegion_->loop_end = int64Value(value);
+    break;
+  case loopCrossfadeOpcode:
+    buildingRegion_->loop_crossfade = juce::jmax(0.0f, floatValue(value));
+    break;
+  case transposeOpcode:
+    buildingRegion_->transpose = intValue(value);
+    break;
+  case tuneOpcode:
+    buildingRegion_->tune = intValue(value);
+    break;
+  case pitchKeycenterOpcode:
+    buildingRegion_->pitch_keycenter = keyValue(value);
+    break;
+  case pitchKeytrackOpcode:
+    buildingRegion_->pitch_keytrack = intValue(value);
+    break;
+  case bendUpOpcode:
+    buildingRegion_->bend_up = intValue(value);
+    break;
+  case bendDownOpcode:
+    buildingRegion_->bend_down = intValue(value);
+    break;
+  case volumeOpcode:
+    buildingRegion_->volume = floatValue(value);
+    break;
+  case panOpcode:
+    buildingRegion_->pan = floatValue(value);
+    break;
+  case ampVeltrackOpcode:
+    buildingRegion_->amp_veltrack = floatValue(value);
+    break;
+  case ampegDelayOpcode:
+    buildingRegion_->ampeg.delay = floatValue(value);
+    break;
+  case ampegStartOpcode:
+    buildingRegion_->ampeg.start = floatValue(value);
+    break;
+  case ampegAttackOpcode:
+    buildingRegion_->ampeg.attack = floatValue(value);
+    break;
+  case ampegHoldOpcode:
+    buildingRegion_->ampeg.hold = floatValue(value);
+    break;
+  case ampegDecayOpcode:
+    buildingRegion_->ampeg.decay = floatValue(value);
+    break;
+  case ampegSustainOpcode:
+    buildingRegion_->ampeg.sustain = floatValue(value);
+    break;
+  case ampegReleaseOpcode:
+    buildingRegion_->ampeg.release = floatValue(value);
+    break;
+  case ampegVel2DelayOpcode:
+    buildingRegion_->ampeg_veltrack.delay = floatValue(value);
+    break;
+  case ampegVel2AttackOpcode:
+    buildingRegion_->ampeg_veltrack.attack = floatValue(value);
+    break;
+  case ampegVel2HoldOpcode:
+    buildingRegion_->ampeg_veltrack.hold = floatValue(value);
+    break;
+  case ampegVel2DecayOpcode:
+    buildingRegion_->ampeg_veltrack.decay = floatValue(value);
+    break;
+  case ampegVel2SustainOpcode:
+    buildingRegion_->ampeg_veltrack.sustain = floatValue(value);
+    break;
+  case ampegVel2ReleaseOpcode:
+    buildingRegion_->ampeg_veltrack.release = floatValue(value);
+    break;
+  case defaultPathOpcode:
+    error("\"default_path\" outside of <control> tag");
+    break;
+  default:
+    sound_->addUnsupportedOpcode(opcode.toString());
+    break;
   }
 }
 
-const char *sfzero::Reader::handleLineEnd(const char *p)
+void sfzero::Reader::include(const sfzero::StringSlice &path)
 {
-  // Check for DOS-style line ending.
-  char lineEndChar = *p++;
+  if (includeDepth_ >= maxIncludeDepth)
+  {
+    error("#include nested too deeply");
+    return;
+  }
 
-  if ((lineEndChar == '\r') && (*p == '\n'))
+  juce::File file = sound_->getFile().getSiblingFile(path.toString().replaceCharacter('\\', '/'));
+  sfzero::Fragment::Ptr fragment = sfzero::ParseCache::getInstance().getFragment(file);
+  if (fragment == nullptr)
   {
-    p += 1;
+    error("Couldn't read included file \"" + path.toString() + "\"");
+    return;
+  }
+
+  int line = line_;
+  juce::String fileName = fileName_;
+  fileName_ = file.getFileName();
+  includeDepth_ += 1;
+  apply(*fragment);
+  includeDepth_ -= 1;
+  fileName_ = fileName;
+  line_ = line;
+}
+
+void sfzero::Reader::define(const sfzero::StringSlice &name, const sfzero::StringSlice &value)
+{
+  for (auto &define : defines_)
+  {
+    if (name == define.name.toRawUTF8())
+    {
+      define.value = value.toString();
+      return;
+    }
   }
-  line_ += 1;
-  return p;
+  Define define = {name.toString(), value.toString()};
+  defines_.add(define);
 }
 
-const char *sfzero::Reader::readPathInto(juce::String *pathOut, const char *pIn, const char *endIn)
+sfzero::StringSlice sfzero::Reader::expand(const sfzero::StringSlice &text)
 {
-  // Paths are kind of funny to parse because they can contain whitespace.
-  const char *p = pIn;
-  const char *end = endIn;
-  const char *pathStart = p;
-  const char *potentialEnd = nullptr;
+  if ((defines_.size() == 0) || (memchr(text.getStart(), '$', text.length()) == nullptr))
+  {
+    return text;
+  }
 
+  // Replace each "$name" that has been #defined; the result lives in
+  // expanded_ until the next call.
+  expanded_.reset();
+  const char *p = text.getStart();
+  const char *end = text.getEnd();
   while (p < end)
   {
-    char c = *p;
-    if (c == ' ')
+    if (*p != '$')
+    {
+      expanded_.writeByte(*p++);
+      continue;
+    }
+    const char *nameStart = p++;
+    while ((p < end) && (juce::CharacterFunctions::isLetterOrDigit(*p) || (*p == '_')))
     {
-      // Is this space part of the path?  Or the start of the next opcode?  We
-      // don't know yet.
-      potentialEnd = p;
       p += 1;
-      // Skip any more spaces.
-      while (p < end && *p == ' ')
+    }
+    sfzero::StringSlice name(nameStart, p);
+    const Define *match = nullptr;
+    for (auto &define : defines_)
+    {
+      if (name == define.name.toRawUTF8())
       {
-        p += 1;
+        match = &define;
+        break;
       }
     }
-    else if ((c == '\n') || (c == '\r') || (c == '\t'))
+    if (match)
     {
-      break;
+      expanded_.write(match->value.toRawUTF8(), match->value.getNumBytesAsUTF8());
     }
-    else if (c == '=')
+    else
     {
-      // We've been looking at an opcode; we need to rewind to
-      // potentialEnd.
-      p = potentialEnd;
-      break;
+      expanded_.write(nameStart, static_cast<size_t>(p - nameStart));
+    }
+  }
+  const char *expansion = static_cast<const char *>(expanded_.getData());
+  return sfzero::StringSlice(expansion, expansion + expanded_.getDataSize());
+}
+
+juce::int64 sfzero::Reader::int64Value(const sfzero::StringSlice &str)
+{
+  const char *p = str.getStart();
+  const char *end = str.getEnd();
+  bool negative = false;
+  if ((p < end) && ((*p == '-') || (*p == '+')))
+  {
+    negative = (*p++ == '-');
+  }
+  juce::uint64 value = 0;
+  while ((p < end) && isDigit(*p))
+  {
+    value = value * 10 + static_cast<juce::uint64>(*p++ - '0');
+  }
+  return negative ? -static_cast<juce::int64>(value) : static_cast<juce::int64>(value);
+}
+
+int sfzero::Reader::intValue(const sfzero::StringSlice &str) { return static_cast<int>(int64Value(str)); }
+
+float sfzero::Reader::floatValue(const sfzero::StringSlice &str)
+{
+  const char *p = str.getStart();
+  const char *end = str.getEnd();
+  bool negative = false;
+  if ((p < end) && ((*p == '-') || (*p == '+')))
+  {
+    negative = (*p++ == '-');
+  }
+
+  // Gather up to 19 significant digits as an integer, then scale it by the
+  // power of ten; exact for anything an SFZ file would reasonably hold.
+  juce::uint64 mantissa = 0;
+  int numDigits = 0, exponent = 0;
+  while ((p < end) && isDigit(*p))
+  {
+    if (numDigits < 19)
+    {
+      mantissa = mantissa * 10 + static_cast<juce::uint64>(*p - '0');
+      numDigits += (mantissa != 0);
+    }
+    else
+    {
+      exponent += 1;
     }
     p += 1;
   }
-  if (p > pathStart)
+  if ((p < end) && (*p == '.'))
   {
-    // Can't do this:
-    //      juce::String path(CharPointer_UTF8(pathStart), CharPointer_UTF8(p));
-    // It won't compile for some unfathomable reason.
-    juce::CharPointer_UTF8 end2(p);
-    juce::String path(juce::CharPointer_UTF8(pathStart), end2);
-    *pathOut = path;
+    p += 1;
+    while ((p < end) && isDigit(*p))
+    {
+      if (numDigits < 19)
+      {
+        mantissa = mantissa * 10 + static_cast<juce::uint64>(*p - '0');
+        numDigits += (mantissa != 0);
+        exponent -= 1;
+      }
+      p += 1;
+    }
   }
-  else
+  if ((p < end) && ((*p == 'e') || (*p == 'E')))
   {
-    *pathOut = juce::String();
+    exponent += intValue(sfzero::StringSlice(p + 1, end));
   }
-  return p;
+
+  double value = static_cast<double>(mantissa);
+  if (mantissa != 0)
+  {
+    value = (exponent < 0) ? (value / powerOfTen(-exponent)) : (value * powerOfTen(exponent));
+  }
+  return static_cast<float>(negative ? -value : value);
 }
 
-int sfzero::Reader::keyValue(const juce::String &str)
+int sfzero::Reader::keyValue(const sfzero::StringSlice &str)
 {
-  auto chars = str.toRawUTF8();
+  const char *chars = str.getStart();
+  if (str.isEmpty())
+  {
+    return 0;
+  }
 
   char c = chars[0];
 
   if ((c >= '0') && (c <= '9'))
   {
-    return str.getIntValue();
+    return intValue(str);
   }
 
   int note = 0;
@@ -520,7 +655,7 @@ int sfzero::Reader::keyValue(const juce::String &str)
   }
   int octaveStart = 1;
 
-  c = chars[1];
+  c = (str.length() > 1) ? chars[1] : 0;
   if ((c == 'b') || (c == '#'))
   {
     octaveStart += 1;
@@ -534,13 +669,13 @@ int sfzero::Reader::keyValue(const juce::String &str)
     }
   }
 
-  int octave = str.substring(octaveStart).getIntValue();
+  int octave = intValue(sfzero::StringSlice(juce::jmin(chars + octaveStart, str.getEnd()), str.getEnd()));
   // A3 == 57.
   int result = octave * 12 + note + (57 - 4 * 12);
   return result;
 }
 
-int sfzero::Reader::triggerValue(const juce::String &str)
+int sfzero::Reader::triggerValue(const sfzero::StringSlice &str)
 {
   if (str == "release")
   {
@@ -557,7 +692,7 @@ int sfzero::Reader::triggerValue(const juce::String &str)
   return sfzero::Region::attack;
 }
 
-int sfzero::Reader::loopModeValue(const juce::String &str)
+int sfzero::Reader::loopModeValue(const sfzero::StringSlice &str)
 {
   if (str == "no_loop")
   {
@@ -578,18 +713,31 @@ int sfzero::Reader::loopModeValue(const juce::String &str)
   return sfzero::Region::sample_loop;
 }
 
-void sfzero::Reader::finishRegion(sfzero::Region *region)
+void sfzero::Reader::finishRegion(sfzero::RegionDescription *region)
 {
-  sfzero::Region *newRegion = new sfzero::Region();
-
-  *newRegion = *region;
-  sound_->addRegion(newRegion);
+  if ((region->loop_crossfade > 0.0f) && region->sample && (region->loop_mode != sfzero::Region::no_loop) &&
+      (region->loop_mode != sfzero::Region::one_shot))
+  {
+    // Played from a copy of the sample with the crossfade rendered in, so
+    // the voice's loop stays a plain jump.
+    sfzero::RegionDescription crossfaded = *region;
+    crossfaded.sample = sound_->addCrossfadedSample(region->sample, region->loop_start, region->loop_end,
+                                                    region->loop_crossfade);
+    sound_->addRegion(crossfaded);
+    return;
+  }
+  sound_->addRegion(*region);
 }
 
 void sfzero::Reader::error(const juce::String &message)
 {
   juce::String fullMessage = message;
 
-  fullMessage += " (line " + juce::String(line_) + ").";
+  fullMessage += " (line " + juce::String(line_);
+  if (fileName_.isNotEmpty())
+  {
+    fullMessage += " of " + fileName_;
+  }
+  fullMessage += ").";
   sound_->addError(fullMessage);
 }
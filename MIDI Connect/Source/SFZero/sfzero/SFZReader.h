@@ -7,12 +7,32 @@
 #ifndef SFZREADER_H_INCLUDED
 #define SFZREADER_H_INCLUDED
 
-#include "SFZCommon.h"
+#include "SFZRegion.h"
 
 namespace sfzero
 {
 
-struct Region;
+// A run of characters in the text being read; nothing is copied.  Can be
+// passed around by value.
+class StringSlice
+{
+public:
+  StringSlice(const char *startIn, const char *endIn) : start_(startIn), end_(endIn) {}
+
+  unsigned int length() const { return static_cast<unsigned int>(end_ - start_); }
+  bool isEmpty() const { return (start_ == end_); }
+  bool operator==(const char *other) const { return (strncmp(start_, other, length()) == 0) && (other[length()] == 0); }
+  bool operator!=(const char *other) const { return !operator==(other); }
+  const char *getStart() const { return start_; }
+  const char *getEnd() const { return end_; }
+  juce::String toString() const { return juce::String(juce::CharPointer_UTF8(start_), juce::CharPointer_UTF8(end_)); }
+
+private:
+  const char *start_;
+  const char *end_;
+};
+
+class Fragment;
 class Sound;
 
 class Reader
@@ -21,40 +41,57 @@ public:
   explicit Reader(Sound *sound);
   ~Reader();
 
+  // Files come from the ParseCache, already lexed, and values are parsed
+  // where they lie in the text; the only allocations are for the regions,
+  // sample paths and messages.  #include paths are relative to the sound's
+  // file, and #define variables are replaced in opcode values.
   void read(const juce::File &file);
   void read(const char *text, unsigned int length);
 
+  // Parsers for opcode values.  Like juce::String's, they stop at the first
+  // character that doesn't fit.
+  static int intValue(const StringSlice &str);
+  static juce::int64 int64Value(const StringSlice &str);
+  static float floatValue(const StringSlice &str);
+  static int keyValue(const StringSlice &str);
+
 private:
-  const char *handleLineEnd(const char *p);
-  const char *readPathInto(juce::String *pathOut, const char *p, const char *end);
-  int keyValue(const juce::String &str);
-  int triggerValue(const juce::String &str);
-  int loopModeValue(const juce::String &str);
-  void finishRegion(Region *region);
+  enum
+  {
+    maxIncludeDepth = 32
+  };
+
+  struct Define
+  {
+    juce::String name, value;
+  };
+
+  void begin();
+  void apply(const Fragment &fragment);
+  void handleTag(const StringSlice &tag);
+  void handleOpcode(const StringSlice &opcode, const StringSlice &value);
+  void include(const StringSlice &path);
+  void define(const StringSlice &name, const StringSlice &value);
+  StringSlice expand(const StringSlice &text);
+  int triggerValue(const StringSlice &str);
+  int loopModeValue(const StringSlice &str);
+  void finishRegion(RegionDescription *region);
   void error(const juce::String &message);
 
   Sound *sound_;
   int line_;
+  juce::String fileName_; // Of the included file being read, for messages; empty for the sound's own.
+  int includeDepth_;
+  RegionDescription curGroup_;
+  RegionDescription curRegion_;
+  RegionDescription *buildingRegion_;
+  bool inControl_;
+  juce::String defaultPath_;
+  juce::Array<Define> defines_;
+  juce::MemoryOutputStream expanded_;
 
   JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Reader)
 };
-
-class StringSlice
-{
-public:
-  StringSlice(const char *startIn, const char *endIn) : start_(startIn), end_(endIn) {}
-  virtual ~StringSlice() {}
-
-  unsigned int length() { return static_cast<int>(end_ - start_); }
-  bool operator==(const char *other) { return (strncmp(start_, other, length()) == 0); }
-  bool operator!=(const char *other) { return (strncmp(start_, other, length()) != 0); }
-  const char *getStart() const { return start_; }
-  const char *getEnd() const { return end_; }
-private:
-  const char *start_;
-  const char *end_;
-  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(StringSlice)
-};
 }
 
 #endif // SFZREADER_H_INCLUDED
@@ -0,0 +1,355 @@
+/*************************************************************************************
+ * Original code copyright (C) 2012 Steve Folta
+ * Converted to Juce module (C) 2016 Leo Olivers
+ * Forked from https://github.com/stevefolta/SFZero
+ * For license info please see the LICENSE file distributed with this source code
+ *************************************************************************************/
+#include "SFZRealtimeCheck.h"
+
+const char *sfzero::RealtimeCheck::getKindName(Kind kind)
+{
+  switch (kind)
+  {
+  case allocation:
+    return "allocation";
+  case lock:
+    return "lock";
+  case contendedLock:
+    return "contended lock";
+  case blockingCall:
+    return "blocking call";
+  }
+  return "";
+}
+
+#if SFZERO_REALTIME_CHECKS
+#if JUCE_LINUX && defined(__GLIBC__)
+#define SFZ_INTERPOSE_LIBC 1
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+#else
+#define SFZ_INTERPOSE_LIBC 0
+#endif
+#include <iostream>
+
+#if defined(__GNUC__)
+// Initial-exec thread-locals are at a fixed offset from the thread pointer.
+// The default model for code that might end up in a shared library looks
+// them up through __tls_get_addr(), which can allocate the first time a
+// thread touches them, and that would recurse from malloc().
+#define SFZ_TLS_MODEL __attribute__((tls_model("initial-exec")))
+#else
+#define SFZ_TLS_MODEL
+#endif
+
+namespace
+{
+// How deep in ScopedAudioThreads this thread is.  Plain, trivially
+// initialised thread-locals, so there's no constructor to run on first use.
+thread_local int audioThreadDepth SFZ_TLS_MODEL = 0;
+// Set while recording a violation, which allocates and locks in its turn.
+thread_local bool reporting SFZ_TLS_MODEL = false;
+
+std::atomic<bool> enabled(true);
+std::atomic<bool> abortOnViolation(false);
+std::atomic<int> numViolations(0);
+
+struct Violations
+{
+  juce::CriticalSection lock;
+  juce::Array<sfzero::RealtimeCheck::Violation> list;
+  juce::HashMap<juce::int64, int> indexByStack;
+};
+
+Violations &getViolationList()
+{
+  static Violations violations;
+  return violations;
+}
+
+inline bool shouldCheck() { return (audioThreadDepth > 0) && !reporting && enabled.load(std::memory_order_relaxed); }
+
+// Violations are told apart by their return addresses, and only symbolised
+// the first time, as the same one usually happens every block.
+void recordViolation(sfzero::RealtimeCheck::Kind kind, const char *call)
+{
+  numViolations.fetch_add(1);
+  juce::String stack;
+  juce::uint64 key = 14695981039346656037ull;
+  key = (key ^ static_cast<juce::uint64>(kind)) * 1099511628211ull;
+  key = (key ^ static_cast<juce::uint64>(reinterpret_cast<juce::pointer_sized_int>(call))) * 1099511628211ull;
+#if SFZ_INTERPOSE_LIBC
+  void *frames[48];
+  int numFrames = backtrace(frames, 48);
+  for (int i = 0; i < numFrames; ++i)
+  {
+    key = (key ^ static_cast<juce::uint64>(reinterpret_cast<juce::pointer_sized_int>(frames[i]))) * 1099511628211ull;
+  }
+#else
+  stack = juce::SystemStats::getStackBacktrace();
+  key = (key ^ static_cast<juce::uint64>(stack.hashCode64())) * 1099511628211ull;
+#endif
+
+  Violations &violations = getViolationList();
+  const juce::ScopedLock locker(violations.lock);
+  int index = violations.indexByStack[static_cast<juce::int64>(key)] - 1;
+  if (index >= 0)
+  {
+    violations.list.getReference(index).count += 1;
+    return;
+  }
+
+#if SFZ_INTERPOSE_LIBC
+  // Without the frames for recordViolation() and report().
+  char **symbols = backtrace_symbols(frames, numFrames);
+  for (int i = 2; symbols && (i < numFrames); ++i)
+  {
+    stack << symbols[i] << "\n";
+  }
+  free(symbols);
+#endif
+  sfzero::RealtimeCheck::Violation violation = {kind, call, stack, 1};
+  violations.list.add(violation);
+  violations.indexByStack.set(static_cast<juce::int64>(key), violations.list.size());
+
+  if (abortOnViolation.load())
+  {
+    std::cerr << "Real-time violation: " << sfzero::RealtimeCheck::getKindName(kind) << " (" << call
+              << ") on the audio thread\n"
+              << stack << std::endl;
+    std::abort();
+  }
+}
+}
+
+void sfzero::RealtimeCheck::setEnabled(bool shouldBeEnabled) { enabled.store(shouldBeEnabled); }
+
+void sfzero::RealtimeCheck::setAbortOnViolation(bool shouldAbort) { abortOnViolation.store(shouldAbort); }
+
+void sfzero::RealtimeCheck::report(Kind kind, const char *call)
+{
+  if (!shouldCheck())
+  {
+    return;
+  }
+
+  // Recording allocates and locks in its turn; those calls are let through
+  // until everything it made has been freed again.
+  reporting = true;
+  recordViolation(kind, call);
+  reporting = false;
+}
+
+juce::Array<sfzero::RealtimeCheck::Violation> sfzero::RealtimeCheck::getViolations()
+{
+  Violations &violations = getViolationList();
+  const juce::ScopedLock locker(violations.lock);
+  return violations.list;
+}
+
+int sfzero::RealtimeCheck::getNumViolations() { return numViolations.load(); }
+
+void sfzero::RealtimeCheck::clear()
+{
+  Violations &violations = getViolationList();
+  const juce::ScopedLock locker(violations.lock);
+  violations.list.clear();
+  violations.indexByStack.clear();
+  numViolations.store(0);
+}
+
+void sfzero::RealtimeCheck::enter() { ++audioThreadDepth; }
+
+void sfzero::RealtimeCheck::leave() { --audioThreadDepth; }
+
+//==============================================================================
+// The interceptors.
+
+#if SFZ_INTERPOSE_LIBC
+
+// glibc's own allocator, under the names it exports for wrappers like these.
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *pointer, size_t size);
+extern "C" void __libc_free(void *pointer);
+
+extern "C" void *malloc(size_t size) __THROW
+{
+  sfzero::RealtimeCheck::report(sfzero::RealtimeCheck::allocation, "malloc");
+  return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size) __THROW
+{
+  sfzero::RealtimeCheck::report(sfzero::RealtimeCheck::allocation, "calloc");
+  return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *pointer, size_t size) __THROW
+{
+  sfzero::RealtimeCheck::report(sfzero::RealtimeCheck::allocation, "realloc");
+  return __libc_realloc(pointer, size);
+}
+
+extern "C" void free(void *pointer) __THROW
+{
+  if (pointer)
+  {
+    sfzero::RealtimeCheck::report(sfzero::RealtimeCheck::allocation, "free");
+  }
+  __libc_free(pointer);
+}
+
+// The rest call through to the next definition, looked up on first use.
+// The pointers are constant-initialised, so no static guard (which can take
+// a lock) is involved.
+#define SFZ_REAL_FUNCTION(name, type)                                                                                        \
+  static std::atomic<void *> real_##name(nullptr);                                                                           \
+  void *function_##name = real_##name.load(std::memory_order_relaxed);                                                     \
+  if (function_##name == nullptr)                                                                                          \
+  {                                                                                                                          \
+    function_##name = dlsym(RTLD_NEXT, #name);                                                                             \
+    real_##name.store(function_##name, std::memory_order_relaxed);                                                         \
+  }                                                                                                                          \
+  auto name##Function = reinterpret_cast<type>(function_##name);
+
+extern "C" int pthread_mutex_lock(pthread_mutex_t *mutex) __THROWNL
+{
+  SFZ_REAL_FUNCTION(pthread_mutex_trylock, int (*)(pthread_mutex_t *))
+  SFZ_REAL_FUNCTION(pthread_mutex_lock, int (*)(pthread_mutex_t *))
+  if (!shouldCheck())
+  {
+    return pthread_mutex_lockFunction(mutex);
+  }
+  if (pthread_mutex_trylockFunction(mutex) == 0)
+  {
+    sfzero::RealtimeCheck::report(sfzero::RealtimeCheck::lock, "pthread_mutex_lock");
+    return 0;
+  }
+  sfzero::RealtimeCheck::report(sfzero::RealtimeCheck::contendedLock, "pthread_mutex_lock");
+  return pthread_mutex_lockFunction(mutex);
+}
+
+#define SFZ_INTERCEPT_BLOCKING(returnType, name, parameters, arguments)                                                      \
+  extern "C" returnType name parameters                                                                                      \
+  {                                                                                                                          \
+    SFZ_REAL_FUNCTION(name, returnType(*) parameters)                                                                        \
+    sfzero::RealtimeCheck::report(sfzero::RealtimeCheck::blockingCall, #name);                                               \
+    return name##Function arguments;                                                                                         \
+  }
+
+SFZ_INTERCEPT_BLOCKING(ssize_t, read, (int fd, void *buffer, size_t size), (fd, buffer, size))
+SFZ_INTERCEPT_BLOCKING(ssize_t, write, (int fd, const void *buffer, size_t size), (fd, buffer, size))
+SFZ_INTERCEPT_BLOCKING(int, close, (int fd), (fd))
+SFZ_INTERCEPT_BLOCKING(int, nanosleep, (const struct timespec *duration, struct timespec *remaining), (duration, remaining))
+SFZ_INTERCEPT_BLOCKING(int, usleep, (useconds_t microseconds), (microseconds))
+SFZ_INTERCEPT_BLOCKING(int, poll, (struct pollfd *fds, nfds_t numFds, int timeout), (fds, numFds, timeout))
+SFZ_INTERCEPT_BLOCKING(int, sem_wait, (sem_t * semaphore), (semaphore))
+SFZ_INTERCEPT_BLOCKING(int, pthread_cond_wait, (pthread_cond_t * condition, pthread_mutex_t *mutex), (condition, mutex))
+SFZ_INTERCEPT_BLOCKING(int, pthread_cond_timedwait,
+                       (pthread_cond_t * condition, pthread_mutex_t *mutex, const struct timespec *time),
+                       (condition, mutex, time))
+SFZ_INTERCEPT_BLOCKING(int, pthread_join, (pthread_t thread, void **result), (thread, result))
+
+// The mode is only passed when a file may be created.
+#define SFZ_OPEN_MODE(lastFixed)                                                                                             \
+  mode_t mode = 0;                                                                                                           \
+  if (flags & (O_CREAT | O_TMPFILE))                                                                                         \
+  {                                                                                                                          \
+    va_list arguments;                                                                                                       \
+    va_start(arguments, lastFixed);                                                                                          \
+    mode = static_cast<mode_t>(va_arg(arguments, int));                                                                      \
+    va_end(arguments);                                                                                                       \
+  }
+
+extern "C" int open(const char *path, int flags, ...)
+{
+  SFZ_REAL_FUNCTION(open, int (*)(const char *, int, ...))
+  sfzero::RealtimeCheck::report(sfzero::RealtimeCheck::blockingCall, "open");
+  SFZ_OPEN_MODE(flags)
+  return openFunction(path, flags, mode);
+}
+
+// With 64-bit file offsets on a 32-bit system the headers already rename
+// open() to this.
+#ifndef __USE_FILE_OFFSET64
+extern "C" int open64(const char *path, int flags, ...)
+{
+  SFZ_REAL_FUNCTION(open64, int (*)(const char *, int, ...))
+  sfzero::RealtimeCheck::report(sfzero::RealtimeCheck::blockingCall, "open64");
+  SFZ_OPEN_MODE(flags)
+  return open64Function(path, flags, mode);
+}
+#endif
+
+extern "C" int openat(int directory, const char *path, int flags, ...)
+{
+  SFZ_REAL_FUNCTION(openat, int (*)(int, const char *, int, ...))
+  sfzero::RealtimeCheck::report(sfzero::RealtimeCheck::blockingCall, "openat");
+  SFZ_OPEN_MODE(flags)
+  return openatFunction(directory, path, flags, mode);
+}
+
+#undef SFZ_OPEN_MODE
+#undef SFZ_INTERCEPT_BLOCKING
+#undef SFZ_REAL_FUNCTION
+
+#else
+
+// Elsewhere only C++ allocations are caught.
+void *operator new(size_t size)
+{
+  sfzero::RealtimeCheck::report(sfzero::RealtimeCheck::allocation, "operator new");
+  if (void *pointer = std::malloc(size > 0 ? size : 1))
+  {
+    return pointer;
+  }
+  throw std::bad_alloc();
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+  sfzero::RealtimeCheck::report(sfzero::RealtimeCheck::allocation, "operator new");
+  return std::malloc(size > 0 ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &nothrow) noexcept { return operator new(size, nothrow); }
+
+void operator delete(void *pointer) noexcept
+{
+  if (pointer)
+  {
+    sfzero::RealtimeCheck::report(sfzero::RealtimeCheck::allocation, "operator delete");
+  }
+  std::free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept { operator delete(pointer); }
+void operator delete(void *pointer, size_t) noexcept { operator delete(pointer); }
+void operator delete[](void *pointer, size_t) noexcept { operator delete(pointer); }
+
+#endif
+#undef SFZ_INTERPOSE_LIBC
+#undef SFZ_TLS_MODEL
+
+#else
+
+void sfzero::RealtimeCheck::setEnabled(bool) {}
+void sfzero::RealtimeCheck::setAbortOnViolation(bool) {}
+void sfzero::RealtimeCheck::report(Kind, const char *) {}
+juce::Array<sfzero::RealtimeCheck::Violation> sfzero::RealtimeCheck::getViolations() { return {}; }
+int sfzero::RealtimeCheck::getNumViolations() { return 0; }
+void sfzero::RealtimeCheck::clear() {}
+void sfzero::RealtimeCheck::enter() {}
+void sfzero::RealtimeCheck::leave() {}
+
+#endif
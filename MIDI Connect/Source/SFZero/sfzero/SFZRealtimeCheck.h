@@ -0,0 +1,82 @@
+/*************************************************************************************
+ * Original code copyright (C) 2012 Steve Folta
+ * Converted to Juce module (C) 2016 Leo Olivers
+ * Forked from https://github.com/stevefolta/SFZero
+ * For license info please see the LICENSE file distributed with this source code
+ *************************************************************************************/
+#ifndef SFZREALTIMECHECK_H_INCLUDED
+#define SFZREALTIMECHECK_H_INCLUDED
+
+#include "SFZCommon.h"
+
+namespace sfzero
+{
+
+// Catches the audio thread doing what it mustn't: allocating or freeing
+// memory, taking a lock, or making a call that can block.  While a thread is
+// within a ScopedAudioThread (SFZeroAudioProcessor::processBlock() puts
+// itself in one), each such call is recorded with its call stack, once per
+// distinct stack, for a test or stress run to report.
+//
+// Only built with SFZERO_REALTIME_CHECKS, for debug builds of the console
+// tools such as SFZero Bench, whose --stress run is what CI uses it for.  The
+// calls are caught by replacing operator new and delete, and on Linux with
+// glibc by interposing malloc() and friends, pthread_mutex_lock() and the
+// usual blocking system calls as well.  That only works when the module is
+// linked into the executable itself: built into a plug-in, the host's calls
+// resolve to the real functions before the plug-in's, so nothing is caught.
+// Without the flag, ScopedAudioThread does nothing.
+class RealtimeCheck
+{
+public:
+  enum Kind
+  {
+    allocation,    // malloc(), free(), new or delete.
+    lock,          // A mutex that was free; still a priority inversion waiting to happen.
+    contendedLock, // A mutex the audio thread had to wait for.
+    blockingCall   // File I/O, sleeping or waiting on another thread.
+  };
+
+  struct Violation
+  {
+    Kind kind;
+    juce::String call;
+    juce::String stack;
+    int count; // Times it happened with this stack.
+  };
+
+  class ScopedAudioThread
+  {
+  public:
+#if SFZERO_REALTIME_CHECKS
+    ScopedAudioThread() { enter(); }
+    ~ScopedAudioThread() { leave(); }
+#else
+    ScopedAudioThread() {}
+#endif
+
+  private:
+    JUCE_DECLARE_NON_COPYABLE(ScopedAudioThread)
+  };
+
+  static bool isAvailable() { return SFZERO_REALTIME_CHECKS != 0; }
+  static void setEnabled(bool shouldBeEnabled);
+  // Prints the first violation and aborts, so a CI run fails at the culprit.
+  static void setAbortOnViolation(bool shouldAbort);
+
+  // Records "call" if this is an audio thread.  Called by the interceptors;
+  // code that knows it is about to do something unsafe can call it too.
+  static void report(Kind kind, const char *call);
+
+  static juce::Array<Violation> getViolations();
+  static int getNumViolations(); // Repeats included.
+  static void clear();
+  static const char *getKindName(Kind kind);
+
+private:
+  static void enter();
+  static void leave();
+};
+}
+
+#endif // SFZREALTIMECHECK_H_INCLUDED
@@ -7,6 +7,8 @@
 #include "SFZRegion.h"
 #include "SFZSample.h"
 
+static_assert(sizeof(sfzero::Region) <= 64, "Region should fit in a cache line");
+
 void sfzero::EGParameters::clear()
 {
   delay = 0.0;
@@ -24,9 +26,9 @@ void sfzero::EGParameters::clearMod()
   delay = start = attack = hold = decay = sustain = release = 0.0;
 }
 
-sfzero::Region::Region() { clear(); }
+sfzero::RegionDescription::RegionDescription() { clear(); }
 
-void sfzero::Region::clear()
+void sfzero::RegionDescription::clear()
 {
   memset(this, 0, sizeof(*this));
   hikey = 127;
@@ -41,11 +43,11 @@ void sfzero::Region::clear()
   ampeg_veltrack.clearMod();
 }
 
-void sfzero::Region::clearForSF2()
+void sfzero::RegionDescription::clearForSF2()
 {
   clear();
   pitch_keycenter = -1;
-  loop_mode = no_loop;
+  loop_mode = Region::no_loop;
 
   // SF2 defaults in timecents.
   ampeg.delay = -12000.0;
@@ -56,7 +58,7 @@ void sfzero::Region::clearForSF2()
   ampeg.release = -12000.0;
 }
 
-void sfzero::Region::clearForRelativeSF2()
+void sfzero::RegionDescription::clearForRelativeSF2()
 {
   clear();
   pitch_keytrack = 0;
@@ -64,7 +66,7 @@ void sfzero::Region::clearForRelativeSF2()
   ampeg.sustain = 0.0;
 }
 
-void sfzero::Region::addForSF2(sfzero::Region *other)
+void sfzero::RegionDescription::addForSF2(sfzero::RegionDescription *other)
 {
   offset += other->offset;
   end += other->end;
@@ -84,7 +86,7 @@ void sfzero::Region::addForSF2(sfzero::Region *other)
   ampeg.release += other->ampeg.release;
 }
 
-void sfzero::Region::sf2ToSFZ()
+void sfzero::RegionDescription::sf2ToSFZ()
 {
   // EG times need to be converted from timecents to seconds.
   ampeg.delay = timecents2Secs(static_cast<int>(ampeg.delay));
@@ -143,4 +145,4 @@ juce::String sfzero::Region::dump()
   return info;
 }
 
-float sfzero::Region::timecents2Secs(int timecents) { return static_cast<float>(pow(2.0, timecents / 1200.0)); }
+float sfzero::RegionDescription::timecents2Secs(int timecents) { return static_cast<float>(pow(2.0, timecents / 1200.0)); }
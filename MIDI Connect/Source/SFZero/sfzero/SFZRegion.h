@@ -13,8 +13,7 @@ namespace sfzero
 {
 
 class Sample;
-
-// Region is designed to be able to be bitwise-copied.
+class ModulationProgram;
 
 struct EGParameters
 {
@@ -24,9 +23,16 @@ struct EGParameters
   void clearMod();
 };
 
+struct RegionParameters;
+
+// A region as it is stored and played: the fields looked at when matching
+// notes and rendering, packed into a cache line, and a pointer to the rest,
+// which are only read when a note starts and are shared between all the
+// regions of a sound that have the same values.  Sounds make these from
+// RegionDescriptions; see Sound::addRegion().
 struct Region
 {
-  enum Trigger
+  enum Trigger : juce::uint8
   {
     attack,
     release,
@@ -34,7 +40,7 @@ struct Region
     legato
   };
 
-  enum LoopMode
+  enum LoopMode : juce::uint8
   {
     sample_loop,
     no_loop,
@@ -43,39 +49,80 @@ struct Region
     loop_sustain
   };
 
-  enum OffMode
+  enum OffMode : juce::uint8
   {
     fast,
     normal
   };
 
-  Region();
-  void clear();
-  void clearForSF2();
-  void clearForRelativeSF2();
-  void addForSF2(Region *other);
-  void sf2ToSFZ();
   juce::String dump();
 
   bool matches(int note, int velocity, Trigger trig)
   {
-    return (note >= lokey && note <= hikey && velocity >= lovel && velocity <= hivel &&
-            (trig == this->trigger || (this->trigger == attack && (trig == first || trig == legato))));
+    return (note >= lokey && note <= hikey && velocity >= lovel && velocity <= hivel && matchesTrigger(trig));
+  }
+
+  bool matchesTrigger(Trigger trig)
+  {
+    return (trig == this->trigger || (this->trigger == attack && (trig == first || trig == legato)));
   }
 
+  Sample *sample;
+  const RegionParameters *parameters;
+  juce::int64 offset;
+  juce::int64 end;
+  juce::int64 loop_start, loop_end;
+  juce::int16 lokey, hikey;
+  juce::int16 lovel, hivel;
+  Trigger trigger;
+  LoopMode loop_mode;
+  bool negative_end;
+};
+
+struct RegionParameters
+{
+  juce::int64 off_by;
+  int group;
+  int transpose;
+  int tune;
+  int pitch_keycenter, pitch_keytrack;
+  int bend_up, bend_down;
+
+  float volume, pan;
+  float amp_veltrack;
+
+  EGParameters ampeg, ampeg_veltrack;
+  const ModulationProgram *modulation; // SF2 modulators; null for SFZ regions.
+
+  Region::OffMode off_mode;
+};
+
+// Everything a region says, while it's being read: group settings are
+// copied into it, SF2 preset zones are added to instrument zones, and so
+// on.  RegionDescription is designed to be able to be bitwise-copied.
+struct RegionDescription
+{
+  RegionDescription();
+  void clear();
+  void clearForSF2();
+  void clearForRelativeSF2();
+  void addForSF2(RegionDescription *other);
+  void sf2ToSFZ();
+
   Sample *sample;
   int lokey, hikey;
   int lovel, hivel;
-  Trigger trigger;
+  Region::Trigger trigger;
   int group;
   juce::int64 off_by;
-  OffMode off_mode;
+  Region::OffMode off_mode;
 
   juce::int64 offset;
   juce::int64 end;
   bool negative_end;
-  LoopMode loop_mode;
+  Region::LoopMode loop_mode;
   juce::int64 loop_start, loop_end;
+  float loop_crossfade; // Seconds; rendered into the sample when it's loaded.
   int transpose;
   int tune;
   int pitch_keycenter, pitch_keytrack;
@@ -85,6 +132,7 @@ struct Region
   float amp_veltrack;
 
   EGParameters ampeg, ampeg_veltrack;
+  const ModulationProgram *modulation; // Interned by the sound.
 
   static float timecents2Secs(int timecents);
 };
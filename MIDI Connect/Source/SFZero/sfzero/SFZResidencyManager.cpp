@@ -0,0 +1,165 @@
+/*************************************************************************************
+ * Original code copyright (C) 2012 Steve Folta
+ * Converted to Juce module (C) 2016 Leo Olivers
+ * Forked from https://github.com/stevefolta/SFZero
+ * For license info please see the LICENSE file distributed with this source code
+ *************************************************************************************/
+#include "SFZResidencyManager.h"
+#include "SFZSample.h"
+
+sfzero::ResidencyManager::ResidencyManager(juce::AudioFormatManager &formatManagerIn)
+    : formatManager_(formatManagerIn), refaultingSound_(nullptr), numRemoved_(0), memoryBudget_(0), headLength_(8192), residentBytes_(0), numEvicted_(0)
+{
+}
+
+sfzero::ResidencyManager::~ResidencyManager()
+{
+  const juce::ScopedLock locker(soundsLock_);
+
+  for (int i = 0; i < sounds_.size(); ++i)
+  {
+    sounds_[i]->setResidencyManager(nullptr);
+  }
+}
+
+void sfzero::ResidencyManager::addSound(sfzero::Sound *sound)
+{
+  const juce::ScopedLock locker(soundsLock_);
+
+  if (sounds_.addIfNotAlreadyThere(sound))
+  {
+    sound->setResidencyManager(this);
+  }
+}
+
+void sfzero::ResidencyManager::removeSound(sfzero::Sound *sound)
+{
+  const juce::ScopedLock locker(soundsLock_);
+
+  sounds_.removeFirstMatchingValue(sound);
+  ++numRemoved_;
+  while (refaultingSound_ == sound)
+  {
+    const juce::ScopedUnlock unlocker(soundsLock_);
+    refaultFinished_.wait();
+  }
+}
+
+class LeastRecentlyUsedComparator
+{
+public:
+  static int compareElements(const sfzero::Sample *first, const sfzero::Sample *second)
+  {
+    juce::uint32 firstUsed = first->getLastUsed(), secondUsed = second->getLastUsed();
+    return (firstUsed < secondUsed) ? -1 : (firstUsed > secondUsed) ? 1 : 0;
+  }
+};
+
+int sfzero::ResidencyManager::useTimeSlice()
+{
+  // Samples that were played while evicted come back first.  Reading one can
+  // take a while (an SF3 sample is decoded), so it's done without the lock,
+  // holding up only a removeSound() for the sound it belongs to.
+  juce::Array<sfzero::Sound *> refaultSounds;
+  juce::Array<sfzero::Sample *> refaultSamples;
+  int numRemoved;
+  {
+    const juce::ScopedLock locker(soundsLock_);
+
+    numRemoved = numRemoved_;
+    juce::Array<sfzero::Sample *> samples;
+    for (int i = 0; i < sounds_.size(); ++i)
+    {
+      samples.clearQuick();
+      sounds_[i]->getSamples(samples);
+      for (int j = 0; j < samples.size(); ++j)
+      {
+        if (samples[j]->wantsRefault())
+        {
+          refaultSounds.add(sounds_[i]);
+          refaultSamples.add(samples[j]);
+        }
+      }
+    }
+  }
+  bool refaulted = false;
+  for (int i = 0; i < refaultSamples.size(); ++i)
+  {
+    {
+      const juce::ScopedLock locker(soundsLock_);
+
+      // Once a sound has gone, the rest wait for the next slice.
+      if (numRemoved_ != numRemoved)
+      {
+        break;
+      }
+      refaultingSound_ = refaultSounds[i];
+    }
+    refaultSamples[i]->refault(&formatManager_);
+    refaulted = true;
+    {
+      const juce::ScopedLock locker(soundsLock_);
+
+      refaultingSound_ = nullptr;
+    }
+    refaultFinished_.signal();
+  }
+
+  const juce::ScopedLock locker(soundsLock_);
+
+  juce::Array<sfzero::Sample *> samples;
+  for (int i = 0; i < sounds_.size(); ++i)
+  {
+    sounds_[i]->getSamples(samples);
+  }
+
+  // A buffer the arena found a duplicate of is shared by several samples,
+  // maybe of several sounds, so it's counted once.
+  juce::int64 bytes = 0;
+  juce::HashMap<juce::AudioSampleBuffer *, int> bufferUses;
+  juce::Array<sfzero::Sample *> candidates;
+  for (int i = 0; i < samples.size(); ++i)
+  {
+    sfzero::Sample *sample = samples[i];
+    bytes += sample->getMemoryUsage();
+    juce::AudioSampleBuffer *buffer = sample->getBuffer();
+    if (buffer)
+    {
+      int uses = bufferUses[buffer];
+      if (uses > 0)
+      {
+        bytes -= sample->getBufferMemoryUsage();
+      }
+      bufferUses.set(buffer, uses + 1);
+    }
+    if (sample->canEvict() && sample->isLoaded() && !sample->isEvicted() && !sample->isInUse())
+    {
+      candidates.add(sample);
+    }
+  }
+
+  juce::int64 budget = memoryBudget_.load();
+  if ((budget > 0) && (bytes > budget))
+  {
+    LeastRecentlyUsedComparator comparator;
+    candidates.sort(comparator);
+    int headLength = headLength_.load();
+    for (int i = 0; (i < candidates.size()) && (bytes > budget); ++i)
+    {
+      sfzero::Sample *sample = candidates[i];
+      juce::AudioSampleBuffer *buffer = sample->getBuffer();
+      juce::int64 before = sample->getMemoryUsage(), bufferBytes = sample->getBufferMemoryUsage();
+      if (sample->evict(headLength))
+      {
+        // The buffer is only freed once the last sample sharing it lets go.
+        int uses = bufferUses[buffer] - 1;
+        bufferUses.set(buffer, uses);
+        bytes -= before - sample->getMemoryUsage() - ((uses > 0) ? bufferBytes : 0);
+        numEvicted_.fetch_add(1);
+      }
+    }
+  }
+  residentBytes_.store(bytes);
+
+  return refaulted ? 10 : 100;
+}
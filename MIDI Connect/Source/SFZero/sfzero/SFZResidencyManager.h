@@ -0,0 +1,62 @@
+/*************************************************************************************
+ * Original code copyright (C) 2012 Steve Folta
+ * Converted to Juce module (C) 2016 Leo Olivers
+ * Forked from https://github.com/stevefolta/SFZero
+ * For license info please see the LICENSE file distributed with this source code
+ *************************************************************************************/
+#ifndef SFZRESIDENCYMANAGER_H_INCLUDED
+#define SFZRESIDENCYMANAGER_H_INCLUDED
+
+#include "SFZSound.h"
+
+namespace sfzero
+{
+
+// Keeps the samples of the sounds it's given within a memory budget.  When
+// they go over it, the least recently played samples that aren't playing
+// are cut back to their first few frames; a sample that's played again is
+// reloaded in the background while the note plays from those frames.
+// Samples that share a buffer (those of an SF2 file) are left alone, but an
+// SF2 file's samples are handled like any others when it loads presets on
+// demand; that's also how a newly selected preset's samples get read.
+//
+// Runs as a TimeSliceClient.  It must outlive the sounds given to it.
+class ResidencyManager : public juce::TimeSliceClient
+{
+public:
+  explicit ResidencyManager(juce::AudioFormatManager &formatManager);
+  ~ResidencyManager();
+
+  void addSound(Sound *sound); // Call once the sound's samples are loaded.
+  // Done by the sound before it deletes its samples.  Waits if one of them
+  // is being reloaded.
+  void removeSound(Sound *sound);
+
+  // A budget of zero means no limit.
+  void setMemoryBudget(juce::int64 bytes) { memoryBudget_.store(bytes); }
+  juce::int64 getMemoryBudget() const { return memoryBudget_.load(); }
+  void setHeadLength(int frames) { headLength_.store(frames); }
+  int getHeadLength() const { return headLength_.load(); }
+
+  juce::int64 getResidentBytes() const { return residentBytes_.load(); }
+  int getNumEvicted() const { return numEvicted_.load(); }
+
+  int useTimeSlice() override;
+
+private:
+  juce::AudioFormatManager &formatManager_;
+  juce::Array<Sound *> sounds_;
+  juce::CriticalSection soundsLock_; // Held while working on their samples, except to reload one.
+  Sound *refaultingSound_;           // Whose sample is being reloaded, if any.
+  int numRemoved_;                   // Tells useTimeSlice() its list of samples may be stale.
+  juce::WaitableEvent refaultFinished_;
+  std::atomic<juce::int64> memoryBudget_;
+  std::atomic<int> headLength_;
+  std::atomic<juce::int64> residentBytes_;
+  std::atomic<int> numEvicted_;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ResidencyManager)
+};
+}
+
+#endif // SFZRESIDENCYMANAGER_H_INCLUDED
@@ -5,51 +5,206 @@
  * For license info please see the LICENSE file distributed with this source code
  *************************************************************************************/
 #include "SFZSample.h"
-#include "SFZDebug.h"
+#include "SFZCompressedSample.h"
+#include "SFZLog.h"
+#include "SFZPCM.h"
+#include "SFZSampleArena.h"
 
-bool sfzero::Sample::load(juce::AudioFormatManager *formatManager)
+bool sfzero::Sample::load(juce::AudioFormatManager *formatManager, bool compress)
+{
+  juce::int64 start = juce::Time::getHighResolutionTicks();
+  juce::AudioSampleBuffer *buffer = read(formatManager);
+
+  if (buffer == nullptr)
+  {
+    return false;
+  }
+
+  if (compress)
+  {
+    sfzero::CompressedSample *compressed = sfzero::CompressedSample::compress(*buffer);
+    if (compressed)
+    {
+      sfzero::SampleArena::getInstance().releaseBuffer(buffer);
+      loadSeconds_.store(juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start));
+      compressed_.store(compressed, std::memory_order_release);
+      return true;
+    }
+  }
+
+  // Publish the buffer last; voices may pick it up as soon as it is set.
+  loadSeconds_.store(juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start));
+  buffer_.store(buffer, std::memory_order_release);
+  return true;
+}
+
+juce::AudioSampleBuffer *sfzero::Sample::read(juce::AudioFormatManager *formatManager)
+{
+  Metadata metadata = {sampleRate_, sampleLength_, loopStart_, loopEnd_};
+  juce::AudioSampleBuffer *buffer = readBuffer(formatManager, metadata);
+  if ((buffer != nullptr) && !hasMetadata_)
+  {
+    sampleRate_ = metadata.sampleRate;
+    sampleLength_ = metadata.sampleLength;
+    loopStart_ = metadata.loopStart;
+    loopEnd_ = metadata.loopEnd;
+    hasMetadata_ = true;
+  }
+  return buffer;
+}
+
+juce::AudioSampleBuffer *sfzero::Sample::readBuffer(juce::AudioFormatManager *formatManager, Metadata &metadata)
 {
   juce::AudioFormatReader *reader = formatManager->createReaderFor(file_);
 
   if (reader == nullptr)
   {
-    return false;
+    return nullptr;
   }
-  sampleRate_ = reader->sampleRate;
-  sampleLength_ = reader->lengthInSamples;
+  metadata.sampleRate = reader->sampleRate;
+  metadata.sampleLength = static_cast<juce::uint64>(reader->lengthInSamples);
   // Read some extra samples, which will be filled with zeros, so interpolation
   // can be done without having to check for the edge all the time.
-  jassert(sampleLength_ < std::numeric_limits<int>::max());
+  jassert(metadata.sampleLength < std::numeric_limits<int>::max());
 
-  buffer_ = new juce::AudioSampleBuffer(reader->numChannels, static_cast<int>(sampleLength_ + 4));
-  reader->read(buffer_, 0, static_cast<int>(sampleLength_ + 4), 0, true, true);
+  int numFrames = static_cast<int>(metadata.sampleLength + 4);
+  juce::AudioSampleBuffer *buffer = sfzero::SampleArena::getInstance().createBuffer(reader->numChannels, numFrames);
+  if (!sfzero::PCM::readWav(file_, *reader, *buffer))
+  {
+    reader->read(buffer, 0, numFrames, 0, true, true);
+  }
 
-  juce::StringPairArray *metadata = &reader->metadataValues;
-  int numLoops = metadata->getValue("NumSampleLoops", "0").getIntValue();
+  juce::StringPairArray *values = &reader->metadataValues;
+  int numLoops = values->getValue("NumSampleLoops", "0").getIntValue();
   if (numLoops > 0)
   {
-    loopStart_ = metadata->getValue("Loop0Start", "0").getLargeIntValue();
-    loopEnd_ = metadata->getValue("Loop0End", "0").getLargeIntValue();
+    metadata.loopStart = static_cast<juce::uint64>(values->getValue("Loop0Start", "0").getLargeIntValue());
+    metadata.loopEnd = static_cast<juce::uint64>(values->getValue("Loop0End", "0").getLargeIntValue());
   }
   delete reader;
-  return true;
+
+  // Identical audio elsewhere (under another name, or in another sound) ends
+  // up sharing one buffer.
+  return sfzero::SampleArena::getInstance().intern(buffer);
 }
 
-sfzero::Sample::~Sample() { delete buffer_; }
+sfzero::Sample::~Sample()
+{
+  sfzero::SampleArena &arena = sfzero::SampleArena::getInstance();
+  juce::AudioSampleBuffer *buffer = buffer_.load();
+  if (buffer != head_)
+  {
+    arena.releaseBuffer(buffer);
+  }
+  arena.releaseBuffer(head_);
+  delete compressed_.load();
+}
 
 juce::String sfzero::Sample::getShortName() { return (file_.getFileName()); }
 
 void sfzero::Sample::setBuffer(juce::AudioSampleBuffer *newBuffer)
 {
-  buffer_ = newBuffer;
-  sampleLength_ = buffer_->getNumSamples();
+  if (!hasMetadata_)
+  {
+    sampleLength_ = static_cast<juce::uint64>(newBuffer->getNumSamples());
+    hasMetadata_ = true;
+  }
+  buffer_.store(newBuffer, std::memory_order_release);
+}
+
+juce::AudioSampleBuffer *sfzero::Sample::detachBuffer() { return buffer_.exchange(nullptr); }
+
+static juce::int64 bufferBytes(const juce::AudioSampleBuffer *buffer)
+{
+  if (buffer == nullptr)
+  {
+    return 0;
+  }
+  return static_cast<juce::int64>(buffer->getNumChannels()) * buffer->getNumSamples() * sizeof(float);
+}
+
+juce::int64 sfzero::Sample::getMemoryUsage()
+{
+  juce::AudioSampleBuffer *buffer = getBuffer();
+  sfzero::CompressedSample *compressed = getCompressed();
+  return bufferBytes(buffer) + ((buffer != head_) ? bufferBytes(head_) : 0) + (compressed ? compressed->getMemoryUsage() : 0);
+}
+
+juce::int64 sfzero::Sample::getBufferMemoryUsage() { return bufferBytes(getBuffer()); }
+
+void sfzero::Sample::acquire()
+{
+  useCount_.fetch_add(1);
+  lastUsed_.store(juce::Time::getMillisecondCounter());
+  requestRefault();
+}
+
+void sfzero::Sample::requestRefault()
+{
+  if (evicted_.load())
+  {
+    refaultWanted_.store(true);
+  }
+}
+
+bool sfzero::Sample::evict(int headLength)
+{
+  juce::AudioSampleBuffer *buffer = buffer_.load();
+  if (!canEvict() || evicted_.load() || (buffer == nullptr) || isInUse())
+  {
+    return false;
+  }
+
+  if (head_ == nullptr)
+  {
+    int headSamples = juce::jmin(headLength + 4, buffer->getNumSamples());
+    head_ = sfzero::SampleArena::getInstance().createBuffer(buffer->getNumChannels(), headSamples);
+    for (int channel = 0; channel < buffer->getNumChannels(); ++channel)
+    {
+      head_->copyFrom(channel, 0, *buffer, channel, 0, headSamples);
+    }
+  }
+
+  // A voice that acquired the sample before the swap may have read the whole
+  // buffer, so back out if anyone started using it meanwhile.  One that
+  // acquires it after the swap gets the head, and sees it needs refaulting.
+  evicted_.store(true);
+  buffer_.exchange(head_);
+  if (isInUse())
+  {
+    buffer_.store(buffer);
+    evicted_.store(false);
+    return false;
+  }
+  sfzero::SampleArena::getInstance().releaseBuffer(buffer);
+  return true;
 }
 
-juce::AudioSampleBuffer *sfzero::Sample::detachBuffer()
+bool sfzero::Sample::refault(juce::AudioFormatManager *formatManager)
 {
-  juce::AudioSampleBuffer *result = buffer_;
-  buffer_ = nullptr;
-  return result;
+  refaultWanted_.store(false);
+  // A preset being loaded and the ResidencyManager can both ask for it at
+  // once; the one that gets here second waits, then finds it in (or, if the
+  // first couldn't read it, tries again).
+  const juce::ScopedLock locker(refaultLock_);
+
+  bool loaded = true;
+  if (evicted_.load())
+  {
+    juce::int64 start = juce::Time::getHighResolutionTicks();
+    juce::AudioSampleBuffer *buffer = read(formatManager);
+    if (buffer == nullptr)
+    {
+      loaded = false;
+    }
+    else
+    {
+      loadSeconds_.store(juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start));
+      buffer_.store(buffer, std::memory_order_release);
+      evicted_.store(false);
+    }
+  }
+  return loaded;
 }
 
 juce::String sfzero::Sample::dump() { return file_.getFullPathName() + "\n"; }
@@ -57,15 +212,16 @@ juce::String sfzero::Sample::dump() { return file_.getFullPathName() + "\n"; }
 #ifdef JUCE_DEBUG
 void sfzero::Sample::checkIfZeroed(const char *where)
 {
-  if (buffer_ == nullptr)
+  juce::AudioSampleBuffer *buffer = getBuffer();
+  if (buffer == nullptr)
   {
-    sfzero::dbgprintf("SFZSample::checkIfZeroed(%s): no buffer!", where);
+    sfzero::Log::debug("SFZSample::checkIfZeroed(%s): no buffer!", where);
     return;
   }
 
-  int samplesLeft = buffer_->getNumSamples();
+  int samplesLeft = buffer->getNumSamples();
   juce::int64 nonzero = 0, zero = 0;
-  const float *p = buffer_->getReadPointer(0);
+  const float *p = buffer->getReadPointer(0);
   for (; samplesLeft > 0; --samplesLeft)
   {
     if (*p++ == 0.0)
@@ -79,11 +235,11 @@ void sfzero::Sample::checkIfZeroed(const char *where)
   }
   if (nonzero > 0)
   {
-    sfzero::dbgprintf("Buffer not zeroed at %s (%lu vs. %lu).", where, nonzero, zero);
+    sfzero::Log::debug("Buffer not zeroed at %s (%lu vs. %lu).", where, nonzero, zero);
   }
   else
   {
-    sfzero::dbgprintf("Buffer zeroed at %s!  (%lu zeros)", where, zero);
+    sfzero::Log::debug("Buffer zeroed at %s!  (%lu zeros)", where, zero);
   }
 }
 
@@ -12,36 +12,118 @@
 namespace sfzero
 {
 
+class CompressedSample;
+
 class Sample
 {
 public:
-  explicit Sample(const juce::File &fileIn) : file_(fileIn), buffer_(nullptr), sampleRate_(0), sampleLength_(0), loopStart_(0), loopEnd_(0) {}
-  explicit Sample(double sampleRateIn) : buffer_(nullptr), sampleRate_(sampleRateIn), sampleLength_(0), loopStart_(0), loopEnd_(0) {}
+  explicit Sample(const juce::File &fileIn)
+      : file_(fileIn), buffer_(nullptr), head_(nullptr), sampleRate_(0), sampleLength_(0), loopStart_(0), loopEnd_(0),
+        hasMetadata_(false), useCount_(0), lastUsed_(0), evicted_(false), refaultWanted_(false),
+        compressed_(nullptr), loadSeconds_(0.0)
+  {
+  }
+  explicit Sample(double sampleRateIn)
+      : buffer_(nullptr), head_(nullptr), sampleRate_(sampleRateIn), sampleLength_(0), loopStart_(0), loopEnd_(0),
+        hasMetadata_(false), useCount_(0), lastUsed_(0), evicted_(false), refaultWanted_(false),
+        compressed_(nullptr), loadSeconds_(0.0)
+  {
+  }
   virtual ~Sample();
 
-  bool load(juce::AudioFormatManager *formatManager);
+  // With "compress", the sample is kept losslessly compressed instead of as
+  // a buffer, if it can be; voices then decode it a block at a time.
+  bool load(juce::AudioFormatManager *formatManager, bool compress = false);
 
   juce::File getFile() { return (file_); }
-  juce::AudioSampleBuffer *getBuffer() { return (buffer_); }
+  // The buffer is published only once it is completely filled, so this is
+  // safe to call from the audio thread while the sample is being loaded.
+  juce::AudioSampleBuffer *getBuffer() { return buffer_.load(std::memory_order_acquire); }
+  CompressedSample *getCompressed() { return compressed_.load(std::memory_order_acquire); }
+  bool isLoaded() const
+  {
+    return (buffer_.load(std::memory_order_acquire) != nullptr) || (compressed_.load(std::memory_order_acquire) != nullptr);
+  }
   double getSampleRate() { return (sampleRate_); }
   juce::String getShortName();
-  void setBuffer(juce::AudioSampleBuffer *newBuffer);
-  juce::AudioSampleBuffer *detachBuffer();
+  // The sample owns a SampleArena reference to its buffer.
+  void setBuffer(juce::AudioSampleBuffer *newBuffer); // Takes over a reference.
+  juce::AudioSampleBuffer *detachBuffer();            // Hands back the reference.
   juce::String dump();
+  // The sample rate, length and loop are set by the first read that succeeds,
+  // before the buffer is first published, and never change after that; a
+  // refault only brings the buffer back.  So the audio thread can read them
+  // once the sample is loaded.
   juce::uint64 getSampleLength() const { return sampleLength_; }
   juce::uint64 getLoopStart() const { return loopStart_; }
   juce::uint64 getLoopEnd() const { return loopEnd_; }
+  juce::int64 getMemoryUsage();
+  // The part of that taken by the buffer, which other samples may share.
+  juce::int64 getBufferMemoryUsage();
+  // How long the last load() or refault() took to read and decode it.
+  double getLoadSeconds() const { return loadSeconds_.load(); }
+
+  // Residency.  Voices acquire() a sample for as long as they play it, which
+  // is safe on the audio thread.  While nothing is using it, evict() may
+  // replace its buffer with a copy of just the first "headLength" frames; the
+  // next acquire() asks for it to be refaulted, and notes play from the head
+  // until the whole buffer is back.
+  void acquire();
+  void release() { useCount_.fetch_sub(1); }
+  void requestRefault(); // Asks for an evicted sample to be reloaded, without using it.
+  bool isInUse() const { return useCount_.load() > 0; }
+  juce::uint32 getLastUsed() const { return lastUsed_.load(); }
+  bool canEvict() const { return (file_ != juce::File()) && (compressed_.load() == nullptr); }
+  bool isEvicted() const { return evicted_.load(); }
+  bool wantsRefault() const { return refaultWanted_.load(); }
+  bool evict(int headLength);
+  // Reloads an evicted sample, returning false if it couldn't be read.  If
+  // another thread is already reloading it, waits for that one to finish.
+  bool refault(juce::AudioFormatManager *formatManager);
 
 #ifdef JUCE_DEBUG
   void checkIfZeroed(const char *where);
 
 #endif
 
+protected:
+  // For samples read on demand: they start out evicted with no head, so
+  // using one (or requestRefault()) asks for it to be loaded.
+  Sample(const juce::File &fileIn, double sampleRateIn, juce::uint64 sampleLengthIn)
+      : file_(fileIn), buffer_(nullptr), head_(nullptr), sampleRate_(sampleRateIn), sampleLength_(sampleLengthIn),
+        loopStart_(0), loopEnd_(0), hasMetadata_(false), useCount_(0), lastUsed_(0), evicted_(true),
+        refaultWanted_(false), compressed_(nullptr), loadSeconds_(0.0)
+  {
+  }
+
+  // What a read found out about the sample.
+  struct Metadata
+  {
+    double sampleRate;
+    juce::uint64 sampleLength, loopStart, loopEnd;
+  };
+
+  // Returns a new buffer holding the sample, with a SampleArena reference
+  // for the caller, and fills in "metadata", which starts out as what the
+  // sample was constructed with.  Called by load() and refault(); it mustn't
+  // change the sample itself, as voices may be playing its head meanwhile.
+  virtual juce::AudioSampleBuffer *readBuffer(juce::AudioFormatManager *formatManager, Metadata &metadata);
+
 private:
+  juce::AudioSampleBuffer *read(juce::AudioFormatManager *formatManager);
+
   juce::File file_;
-  juce::AudioSampleBuffer *buffer_;
+  std::atomic<juce::AudioSampleBuffer *> buffer_;
+  juce::AudioSampleBuffer *head_; // Kept once made, as a voice may still be reading it.
   double sampleRate_;
   juce::uint64 sampleLength_, loopStart_, loopEnd_;
+  bool hasMetadata_; // Only written before the buffer is first published.
+  std::atomic<int> useCount_;
+  std::atomic<juce::uint32> lastUsed_;
+  std::atomic<bool> evicted_, refaultWanted_;
+  juce::CriticalSection refaultLock_; // Held by whoever is refaulting.
+  std::atomic<CompressedSample *> compressed_;
+  std::atomic<double> loadSeconds_;
 
   JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Sample)
 };
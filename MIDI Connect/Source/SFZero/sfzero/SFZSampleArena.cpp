@@ -0,0 +1,412 @@
+/*************************************************************************************
+ * Original code copyright (C) 2012 Steve Folta
+ * Converted to Juce module (C) 2016 Leo Olivers
+ * Forked from https://github.com/stevefolta/SFZero
+ * For license info please see the LICENSE file distributed with this source code
+ *************************************************************************************/
+#include "SFZSampleArena.h"
+
+#if JUCE_WINDOWS
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+// Slabs are this big unless a buffer needs more: a whole number of 2 MB huge
+// pages, and few enough mappings for even a large bank.
+const size_t slabSize = 32 * 1024 * 1024;
+// Buffers start on cache line boundaries.
+const size_t carveAlignment = 64;
+}
+
+sfzero::SampleArena &sfzero::SampleArena::getInstance()
+{
+  static SampleArena arena;
+  return arena;
+}
+
+sfzero::SampleArena::SampleArena()
+    : prefault_(true), useHugePages_(false), lockMemory_(false), deduplicate_(true), lockedBytes_(0), unlockedBytes_(0),
+      deduplicatedBytes_(0)
+{
+}
+
+sfzero::SampleArena::~SampleArena()
+{
+  for (juce::HashMap<juce::AudioSampleBuffer *, Mapping>::Iterator i(mappings_); i.next();)
+  {
+    delete i.getKey();
+  }
+  while (!slabs_.isEmpty())
+  {
+    unmap(slabs_.getLast());
+  }
+}
+
+juce::AudioSampleBuffer *sfzero::SampleArena::createBuffer(int numChannels, int numSamples)
+{
+  // Each channel starts on a 16-byte boundary, for SIMD.
+  size_t channelFloats = (static_cast<size_t>(numSamples) + 3) & ~static_cast<size_t>(3);
+  size_t size = juce::jmax(static_cast<size_t>(1), numChannels * channelFloats * sizeof(float));
+
+  size = (size + carveAlignment - 1) & ~(carveAlignment - 1);
+
+  Mapping mapping = {nullptr, 0, size, 1, 0, false, 0};
+  bool carved;
+  {
+    const juce::ScopedLock locker(lock_);
+    carved = carve(size, mapping);
+  }
+  if (!carved)
+  {
+    // Map a new slab outside the lock, as prefaulting it takes a while.
+    Slab *slab = map(juce::jmax(slabSize, size));
+    const juce::ScopedLock locker(lock_);
+    if (slab != nullptr)
+    {
+      slabs_.add(slab);
+    }
+    carved = carve(size, mapping);
+  }
+
+  juce::AudioSampleBuffer *buffer;
+  if (carved)
+  {
+    juce::HeapBlock<float *> channels(static_cast<size_t>(numChannels));
+    float *data = reinterpret_cast<float *>(mapping.slab->data + mapping.offset);
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+      channels[channel] = data + channel * channelFloats;
+    }
+    buffer = new juce::AudioSampleBuffer(channels.get(), numChannels, numSamples);
+  }
+  else
+  {
+    // Fall back on the heap.
+    buffer = new juce::AudioSampleBuffer(numChannels, numSamples);
+  }
+
+  const juce::ScopedLock locker(lock_);
+  mappings_.set(buffer, mapping);
+  return buffer;
+}
+
+void sfzero::SampleArena::retainBuffer(juce::AudioSampleBuffer *buffer)
+{
+  const juce::ScopedLock locker(lock_);
+
+  jassert(mappings_.contains(buffer));
+  Mapping mapping = mappings_[buffer];
+  mapping.refCount += 1;
+  mappings_.set(buffer, mapping);
+}
+
+int sfzero::SampleArena::getReferenceCount(const juce::AudioSampleBuffer *buffer)
+{
+  const juce::ScopedLock locker(lock_);
+
+  juce::AudioSampleBuffer *key = const_cast<juce::AudioSampleBuffer *>(buffer);
+  return mappings_.contains(key) ? mappings_[key].refCount : 0;
+}
+
+void sfzero::SampleArena::releaseBuffer(juce::AudioSampleBuffer *buffer)
+{
+  if (buffer == nullptr)
+  {
+    return;
+  }
+
+  const juce::ScopedLock locker(lock_);
+  if (!mappings_.contains(buffer))
+  {
+    delete buffer;
+    return;
+  }
+
+  Mapping mapping = mappings_[buffer];
+  mapping.refCount -= 1;
+  if (mapping.refCount > 0)
+  {
+    // Which holder let go can't be told, so assume the duplicates go first;
+    // at most all but one of the holders can be duplicates.
+    if (mapping.numDuplicates > mapping.refCount - 1)
+    {
+      mapping.numDuplicates -= 1;
+      deduplicatedBytes_.fetch_sub(static_cast<juce::int64>(mapping.size));
+    }
+    mappings_.set(buffer, mapping);
+    return;
+  }
+  mappings_.remove(buffer);
+  if (mapping.interned)
+  {
+    interned_.remove(static_cast<juce::int64>(mapping.hash));
+  }
+  delete buffer;
+  if (mapping.slab)
+  {
+    giveBack(mapping);
+  }
+}
+
+juce::AudioSampleBuffer *sfzero::SampleArena::intern(juce::AudioSampleBuffer *buffer)
+{
+  if ((buffer == nullptr) || !deduplicate_.load())
+  {
+    return buffer;
+  }
+
+  // Hash outside the lock; it's a pass over the whole buffer.
+  juce::uint64 hash = hashContents(*buffer);
+  juce::int64 key = static_cast<juce::int64>(hash);
+
+  juce::AudioSampleBuffer *existing = nullptr;
+  {
+    const juce::ScopedLock locker(lock_);
+    if (!mappings_.contains(buffer))
+    {
+      return buffer;
+    }
+    existing = interned_[key];
+    if (existing == nullptr)
+    {
+      Mapping mapping = mappings_[buffer];
+      mapping.interned = true;
+      mapping.hash = hash;
+      mappings_.set(buffer, mapping);
+      interned_.set(key, buffer);
+      return buffer;
+    }
+    // Keep it alive while comparing.
+    retainBuffer(existing);
+  }
+
+  if (sameContents(*existing, *buffer))
+  {
+    // The reference taken above is now the caller's.
+    {
+      const juce::ScopedLock locker(lock_);
+      Mapping mapping = mappings_[existing];
+      mapping.numDuplicates += 1;
+      mappings_.set(existing, mapping);
+      deduplicatedBytes_.fetch_add(static_cast<juce::int64>(mapping.size));
+    }
+    releaseBuffer(buffer);
+    return existing;
+  }
+
+  // A hash collision; keep both.
+  releaseBuffer(existing);
+  return buffer;
+}
+
+juce::uint64 sfzero::SampleArena::hashContents(const juce::AudioSampleBuffer &buffer)
+{
+  // 64 bits at a time; a match is confirmed by comparing the contents, so
+  // this only has to be fast and spread well.
+  int numChannels = buffer.getNumChannels(), numSamples = buffer.getNumSamples();
+  juce::uint64 hash = 0xcbf29ce484222325ULL ^ (static_cast<juce::uint64>(numChannels) << 32) ^ static_cast<juce::uint64>(numSamples);
+  for (int channel = 0; channel < numChannels; ++channel)
+  {
+    const float *data = buffer.getReadPointer(channel);
+    int i = 0;
+    for (; i + 2 <= numSamples; i += 2)
+    {
+      juce::uint64 word;
+      memcpy(&word, data + i, sizeof(word));
+      hash = (hash ^ word) * 0x9e3779b97f4a7c15ULL;
+      hash ^= hash >> 29;
+    }
+    if (i < numSamples)
+    {
+      juce::uint32 word;
+      memcpy(&word, data + i, sizeof(word));
+      hash = (hash ^ word) * 0x9e3779b97f4a7c15ULL;
+      hash ^= hash >> 29;
+    }
+  }
+  return hash;
+}
+
+bool sfzero::SampleArena::sameContents(const juce::AudioSampleBuffer &a, const juce::AudioSampleBuffer &b)
+{
+  if ((a.getNumChannels() != b.getNumChannels()) || (a.getNumSamples() != b.getNumSamples()))
+  {
+    return false;
+  }
+  for (int channel = 0; channel < a.getNumChannels(); ++channel)
+  {
+    if (memcmp(a.getReadPointer(channel), b.getReadPointer(channel), a.getNumSamples() * sizeof(float)) != 0)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+size_t sfzero::SampleArena::getPageSize()
+{
+#if JUCE_WINDOWS
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwPageSize;
+#else
+  return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+bool sfzero::SampleArena::carve(size_t size, Mapping &mapping)
+{
+  // First fit, newest slab first: older slabs are the likelier to empty out
+  // and be unmapped.
+  for (int i = slabs_.size(); --i >= 0;)
+  {
+    Slab *slab = slabs_[i];
+    for (int j = 0; j < slab->free.size(); ++j)
+    {
+      FreeRange range = slab->free.getReference(j);
+      if (range.size < size)
+      {
+        continue;
+      }
+      mapping.slab = slab;
+      mapping.offset = range.offset;
+      if (range.size == size)
+      {
+        slab->free.remove(j);
+      }
+      else
+      {
+        range.offset += size;
+        range.size -= size;
+        slab->free.set(j, range);
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+void sfzero::SampleArena::giveBack(const Mapping &mapping)
+{
+  Slab *slab = mapping.slab;
+  FreeRange range = {mapping.offset, mapping.size};
+
+  int index = 0;
+  while ((index < slab->free.size()) && (slab->free.getReference(index).offset < range.offset))
+  {
+    ++index;
+  }
+  // Merge with the ranges either side, if they touch.
+  if ((index < slab->free.size()) && (range.offset + range.size == slab->free.getReference(index).offset))
+  {
+    range.size += slab->free.getReference(index).size;
+    slab->free.remove(index);
+  }
+  if (index > 0)
+  {
+    FreeRange &before = slab->free.getReference(index - 1);
+    if (before.offset + before.size == range.offset)
+    {
+      before.size += range.size;
+      range = before;
+      index -= 1;
+      slab->free.remove(index);
+    }
+  }
+  slab->free.insert(index, range);
+
+  // Keep the last slab around, so loading and unloading a single sound
+  // doesn't map and prefault every time.
+  if ((range.size == slab->size) && (slabs_.size() > 1))
+  {
+    unmap(slab);
+  }
+}
+
+sfzero::SampleArena::Slab *sfzero::SampleArena::map(size_t size)
+{
+  size_t pageSize = getPageSize();
+  size = (size + pageSize - 1) / pageSize * pageSize;
+
+#if JUCE_WINDOWS
+  // Large pages need SeLockMemoryPrivilege, which plug-in hosts don't have,
+  // so Windows only gets prefaulting and locking.
+  void *data = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+  if (data == nullptr)
+  {
+    return nullptr;
+  }
+#else
+  // Not MAP_POPULATE: that would fault the pages in before madvise() could
+  // ask for huge ones.
+  void *data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (data == MAP_FAILED)
+  {
+    return nullptr;
+  }
+#ifdef MADV_HUGEPAGE
+  if (useHugePages_.load())
+  {
+    madvise(data, size, MADV_HUGEPAGE);
+  }
+#endif
+#endif
+
+  bool prefaulted = false;
+#ifdef MADV_POPULATE_WRITE
+  // Linux 5.14 and later fault the whole range in at once; older kernels
+  // reject it, and the pages are touched instead.
+  if (prefault_.load())
+  {
+    prefaulted = madvise(data, size, MADV_POPULATE_WRITE) == 0;
+  }
+#endif
+  if (prefault_.load() && !prefaulted)
+  {
+    // Writing is what makes the OS back a page with real memory; reading
+    // would just map the shared zero page.
+    volatile char *bytes = static_cast<volatile char *>(data);
+    for (size_t offset = 0; offset < size; offset += pageSize)
+    {
+      bytes[offset] = 0;
+    }
+  }
+
+  bool locked = false;
+  if (lockMemory_.load())
+  {
+#if JUCE_WINDOWS
+    locked = VirtualLock(data, size) != 0;
+#else
+    locked = mlock(data, size) == 0;
+#endif
+  }
+  (locked ? lockedBytes_ : unlockedBytes_).fetch_add(static_cast<juce::int64>(size));
+
+  Slab *slab = new Slab();
+  slab->data = static_cast<char *>(data);
+  slab->size = size;
+  slab->locked = locked;
+  FreeRange all = {0, size};
+  slab->free.add(all);
+  return slab;
+}
+
+void sfzero::SampleArena::unmap(Slab *slab)
+{
+  (slab->locked ? lockedBytes_ : unlockedBytes_).fetch_sub(static_cast<juce::int64>(slab->size));
+#if JUCE_WINDOWS
+  if (slab->locked)
+  {
+    VirtualUnlock(slab->data, slab->size);
+  }
+  VirtualFree(slab->data, 0, MEM_RELEASE);
+#else
+  munmap(slab->data, slab->size);
+#endif
+  slabs_.removeObject(slab);
+}
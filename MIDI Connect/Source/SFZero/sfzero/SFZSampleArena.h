@@ -0,0 +1,111 @@
+/*************************************************************************************
+ * Original code copyright (C) 2012 Steve Folta
+ * Converted to Juce module (C) 2016 Leo Olivers
+ * Forked from https://github.com/stevefolta/SFZero
+ * For license info please see the LICENSE file distributed with this source code
+ *************************************************************************************/
+#ifndef SFZSAMPLEARENA_H_INCLUDED
+#define SFZSAMPLEARENA_H_INCLUDED
+
+#include "SFZCommon.h"
+
+namespace sfzero
+{
+
+// Where sample buffers get their memory.  Buffers are carved out of large
+// slabs mapped straight from the OS with their pages faulted in up front, so
+// the audio thread never takes the first-touch page fault when a note starts;
+// slabs can optionally be locked into RAM so they aren't paged out under
+// memory pressure, and (on Linux) backed by transparent huge pages.  Carving
+// keeps a bank of thousands of small samples to a handful of mappings and
+// lets small buffers share huge pages.
+//
+// Buffers made by createBuffer() are reference counted, starting at one, and
+// must be freed with releaseBuffer(), never deleted directly.
+//
+// Once filled, a buffer can be interned: if a buffer with the same contents
+// already exists (the same release or noise sample shipped under another
+// name, in another file or another bank), that one is shared instead.
+class SampleArena
+{
+public:
+  static SampleArena &getInstance();
+
+  // These apply to slabs mapped after they're set.
+  void setPrefault(bool shouldPrefault) { prefault_.store(shouldPrefault); }
+  void setUseHugePages(bool shouldUse) { useHugePages_.store(shouldUse); }
+  void setLockMemory(bool shouldLock) { lockMemory_.store(shouldLock); }
+  void setDeduplicate(bool shouldDeduplicate) { deduplicate_.store(shouldDeduplicate); }
+  bool getPrefault() const { return prefault_.load(); }
+  bool getUseHugePages() const { return useHugePages_.load(); }
+  bool getLockMemory() const { return lockMemory_.load(); }
+  bool getDeduplicate() const { return deduplicate_.load(); }
+
+  juce::AudioSampleBuffer *createBuffer(int numChannels, int numSamples);
+  void retainBuffer(juce::AudioSampleBuffer *buffer);
+  void releaseBuffer(juce::AudioSampleBuffer *buffer);
+  // Zero for a buffer that isn't the arena's.
+  int getReferenceCount(const juce::AudioSampleBuffer *buffer);
+
+  // Returns the buffer to use in place of "buffer", which must not have been
+  // shared yet: either "buffer" itself, or an existing one with the same
+  // contents, in which case "buffer" is released.
+  juce::AudioSampleBuffer *intern(juce::AudioSampleBuffer *buffer);
+
+  // The bytes mapped for slabs.  Locked bytes are those the OS agreed to
+  // pin; locking can fail (for instance past RLIMIT_MEMLOCK), leaving them
+  // unlocked.
+  juce::int64 getLockedBytes() const { return lockedBytes_.load(); }
+  juce::int64 getUnlockedBytes() const { return unlockedBytes_.load(); }
+  // What the buffers intern() found duplicates of would otherwise take up.
+  // References a sound takes to share its own buffer don't count.
+  juce::int64 getDeduplicatedBytes() const { return deduplicatedBytes_.load(); }
+
+private:
+  SampleArena();
+  ~SampleArena();
+
+  struct FreeRange
+  {
+    size_t offset, size;
+  };
+
+  struct Slab
+  {
+    char *data;
+    size_t size;
+    bool locked;
+    juce::Array<FreeRange> free; // In order of offset, never adjacent.
+  };
+
+  struct Mapping
+  {
+    Slab *slab; // Null if the buffer had to go on the heap.
+    size_t offset, size;
+    int refCount;
+    int numDuplicates; // intern() hits still holding a reference, as near as can be told.
+    bool interned;
+    juce::uint64 hash;
+  };
+
+  static size_t getPageSize();
+  static juce::uint64 hashContents(const juce::AudioSampleBuffer &buffer);
+  static bool sameContents(const juce::AudioSampleBuffer &a, const juce::AudioSampleBuffer &b);
+  // Both called with lock_ held.
+  bool carve(size_t size, Mapping &mapping);
+  void giveBack(const Mapping &mapping);
+  Slab *map(size_t size);
+  void unmap(Slab *slab);
+
+  juce::HashMap<juce::AudioSampleBuffer *, Mapping> mappings_;
+  juce::HashMap<juce::int64, juce::AudioSampleBuffer *> interned_;
+  juce::OwnedArray<Slab> slabs_;
+  juce::CriticalSection lock_;
+  std::atomic<bool> prefault_, useHugePages_, lockMemory_, deduplicate_;
+  std::atomic<juce::int64> lockedBytes_, unlockedBytes_, deduplicatedBytes_;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SampleArena)
+};
+}
+
+#endif // SFZSAMPLEARENA_H_INCLUDED
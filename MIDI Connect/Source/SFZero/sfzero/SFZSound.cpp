@@ -5,20 +5,96 @@
  * For license info please see the LICENSE file distributed with this source code
  *************************************************************************************/
 #include "SFZSound.h"
+#include "SFZModulation.h"
 #include "SFZReader.h"
 #include "SFZRegion.h"
+#include "SFZResidencyManager.h"
 #include "SFZSample.h"
+#include "SFZSampleArena.h"
+#include "SFZTrace.h"
 
-sfzero::Sound::Sound(const juce::File &fileIn) : file_(fileIn) {}
-sfzero::Sound::~Sound()
+// A sample with a loop crossfade rendered in; see
+// Sound::addCrossfadedSample().
+class CrossfadedSample : public sfzero::Sample
 {
-  int numRegions = regions_.size();
+public:
+  CrossfadedSample(const juce::File &file, juce::int64 loopStart, juce::int64 loopEnd, float crossfade)
+      : sfzero::Sample(file), regionLoopStart_(loopStart), regionLoopEnd_(loopEnd), crossfade_(crossfade)
+  {
+  }
 
-  for (int i = 0; i < numRegions; ++i)
+protected:
+  juce::AudioSampleBuffer *readBuffer(juce::AudioFormatManager *formatManager, Metadata &metadata) override
+  {
+    juce::AudioSampleBuffer *original = sfzero::Sample::readBuffer(formatManager, metadata);
+    if (original == nullptr)
+    {
+      return nullptr;
+    }
+
+    juce::int64 loopStart = regionLoopStart_, loopEnd = regionLoopEnd_;
+    if (loopStart >= loopEnd)
+    {
+      loopStart = static_cast<juce::int64>(metadata.loopStart);
+      loopEnd = static_cast<juce::int64>(metadata.loopEnd);
+    }
+    // The fade takes audio from before the loop start, so it can't be longer
+    // than that or than the loop.
+    juce::int64 maxFrames = juce::jmin(loopStart, loopEnd - loopStart);
+    int numFrames =
+        static_cast<int>(juce::jmin(static_cast<juce::int64>(crossfade_ * metadata.sampleRate), maxFrames));
+    if ((numFrames < 2) || (loopEnd >= original->getNumSamples()))
+    {
+      return original;
+    }
+
+    // The original buffer may be shared, so the fade goes into a copy.
+    sfzero::SampleArena &arena = sfzero::SampleArena::getInstance();
+    juce::AudioSampleBuffer *buffer = arena.createBuffer(original->getNumChannels(), original->getNumSamples());
+    for (int channel = 0; channel < original->getNumChannels(); ++channel)
+    {
+      buffer->copyFrom(channel, 0, *original, channel, 0, original->getNumSamples());
+    }
+    arena.releaseBuffer(original);
+
+    // Equal-power, ending at the loop end on the frame just before the loop
+    // start, which is where the voice jumps to next.
+    int fadeStart = static_cast<int>(loopEnd) - numFrames + 1;
+    int loopLength = static_cast<int>(loopEnd - loopStart) + 1;
+    for (int channel = 0; channel < buffer->getNumChannels(); ++channel)
+    {
+      float *samples = buffer->getWritePointer(channel);
+      for (int i = 0; i < numFrames; ++i)
+      {
+        double angle = juce::MathConstants<double>::halfPi * (i + 1) / numFrames;
+        int position = fadeStart + i;
+        samples[position] = static_cast<float>(samples[position] * cos(angle) + samples[position - loopLength] * sin(angle));
+      }
+    }
+    return arena.intern(buffer);
+  }
+
+private:
+  juce::int64 regionLoopStart_, regionLoopEnd_;
+  float crossfade_;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CrossfadedSample)
+};
+
+sfzero::Sound::Sound(const juce::File &fileIn)
+    : file_(fileIn), numInLastBlock_(0), activeRegions_(&regions_), loaded_(false), useNeighboursWhileLoading_(true),
+      compressSamples_(false), numNotesPlayed_(0), neighbourRegions_(nullptr), parseSeconds_(0.0),
+      sampleLoadSeconds_(0.0), residencyManager_(nullptr)
+{
+  for (int i = 0; i < numRecentNotes; ++i)
   {
-    delete regions_[i];
-    regions_.set(i, nullptr);
+    recentNotes_[i] = 0;
   }
+}
+
+sfzero::Sound::~Sound()
+{
+  leaveResidencyManager();
 
   for (juce::HashMap<juce::String, sfzero::Sample *>::Iterator i(samples_); i.next();)
   {
@@ -26,6 +102,15 @@ sfzero::Sound::~Sound()
   }
 }
 
+void sfzero::Sound::leaveResidencyManager()
+{
+  if (residencyManager_)
+  {
+    residencyManager_->removeSound(this);
+    residencyManager_ = nullptr;
+  }
+}
+
 bool sfzero::Sound::appliesToNote(int /*midiNoteNumber*/)
 {
   // Just say yes; we can't truly know unless we're told the velocity as well.
@@ -33,7 +118,102 @@ bool sfzero::Sound::appliesToNote(int /*midiNoteNumber*/)
 }
 
 bool sfzero::Sound::appliesToChannel(int /*midiChannel*/) { return true; }
-void sfzero::Sound::addRegion(sfzero::Region *region) { regions_.add(region); }
+sfzero::Region *sfzero::Sound::addRegion(const sfzero::RegionDescription &description)
+{
+  sfzero::Region *region = makeRegion(description);
+  regions_.add(region);
+  return region;
+}
+
+sfzero::Region *sfzero::Sound::makeRegion(const sfzero::RegionDescription &description)
+{
+  // Cleared first so the padding is the same in every copy, and they can be
+  // compared as bytes.
+  sfzero::RegionParameters parameters;
+  memset(&parameters, 0, sizeof(parameters));
+  parameters.off_by = description.off_by;
+  parameters.group = description.group;
+  parameters.transpose = description.transpose;
+  parameters.tune = description.tune;
+  parameters.pitch_keycenter = description.pitch_keycenter;
+  parameters.pitch_keytrack = description.pitch_keytrack;
+  parameters.bend_up = description.bend_up;
+  parameters.bend_down = description.bend_down;
+  parameters.volume = description.volume;
+  parameters.pan = description.pan;
+  parameters.amp_veltrack = description.amp_veltrack;
+  parameters.ampeg = description.ampeg;
+  parameters.ampeg_veltrack = description.ampeg_veltrack;
+  parameters.modulation = description.modulation;
+  parameters.off_mode = description.off_mode;
+
+  if ((numInLastBlock_ == 0) || (numInLastBlock_ == regionBlockSize))
+  {
+    regionBlocks_.add(new juce::HeapBlock<sfzero::Region>(static_cast<size_t>(regionBlockSize)));
+    numInLastBlock_ = 0;
+  }
+  sfzero::Region *region = regionBlocks_.getLast()->get() + numInLastBlock_++;
+  region->sample = description.sample;
+  region->parameters = internParameters(parameters);
+  region->offset = description.offset;
+  region->end = description.end;
+  region->loop_start = description.loop_start;
+  region->loop_end = description.loop_end;
+  region->lokey = static_cast<juce::int16>(description.lokey);
+  region->hikey = static_cast<juce::int16>(description.hikey);
+  region->lovel = static_cast<juce::int16>(description.lovel);
+  region->hivel = static_cast<juce::int16>(description.hivel);
+  region->trigger = description.trigger;
+  region->loop_mode = description.loop_mode;
+  region->negative_end = description.negative_end;
+  return region;
+}
+
+const sfzero::RegionParameters *sfzero::Sound::internParameters(const sfzero::RegionParameters &parameters)
+{
+  // FNV-1a over the bytes.  On the rare collision, the newcomer just isn't
+  // shared.
+  const juce::uint8 *bytes = reinterpret_cast<const juce::uint8 *>(&parameters);
+  juce::uint64 hash = 14695981039346656037ull;
+  for (size_t i = 0; i < sizeof(parameters); ++i)
+  {
+    hash = (hash ^ bytes[i]) * 1099511628211ull;
+  }
+
+  sfzero::RegionParameters *existing = parametersByHash_[static_cast<juce::int64>(hash)];
+  if (existing && (memcmp(existing, &parameters, sizeof(parameters)) == 0))
+  {
+    return existing;
+  }
+
+  sfzero::RegionParameters *copy = new sfzero::RegionParameters;
+  memcpy(copy, &parameters, sizeof(parameters));
+  parameters_.add(copy);
+  if (existing == nullptr)
+  {
+    parametersByHash_.set(static_cast<juce::int64>(hash), copy);
+  }
+  return copy;
+}
+const sfzero::ModulationProgram *sfzero::Sound::internModulation(sfzero::ModulationProgram program)
+{
+  program.removeInactive();
+  juce::int64 hash = static_cast<juce::int64>(program.hash());
+  sfzero::ModulationProgram *existing = modulationByHash_[hash];
+  if (existing && (*existing == program))
+  {
+    return existing;
+  }
+
+  sfzero::ModulationProgram *copy = new sfzero::ModulationProgram(program);
+  modulationPrograms_.add(copy);
+  if (existing == nullptr)
+  {
+    modulationByHash_.set(hash, copy);
+  }
+  return copy;
+}
+
 sfzero::Sample *sfzero::Sound::addSample(juce::String path, juce::String defaultPath)
 {
   path = path.replaceCharacter('\\', '/');
@@ -58,6 +238,20 @@ sfzero::Sample *sfzero::Sound::addSample(juce::String path, juce::String default
   return sample;
 }
 
+sfzero::Sample *sfzero::Sound::addCrossfadedSample(sfzero::Sample *sample, juce::int64 loopStart, juce::int64 loopEnd,
+                                                  float crossfade)
+{
+  juce::String key;
+  key << sample->getFile().getFullPathName() << "|" << loopStart << "-" << loopEnd << "|" << crossfade;
+  sfzero::Sample *crossfaded = samples_[key];
+  if (crossfaded == nullptr)
+  {
+    crossfaded = new CrossfadedSample(sample->getFile(), loopStart, loopEnd, crossfade);
+    samples_.set(key, crossfaded);
+  }
+  return crossfaded;
+}
+
 void sfzero::Sound::addError(const juce::String &message) { errors_.add(message); }
 
 void sfzero::Sound::addUnsupportedOpcode(const juce::String &opcode)
@@ -71,30 +265,119 @@ void sfzero::Sound::addUnsupportedOpcode(const juce::String &opcode)
   }
 }
 
+sfzero::Sound::ScopedLoadTimer::ScopedLoadTimer(sfzero::Sound &sound, LoadStage stage)
+    : sound_(sound), stage_(stage), start_(juce::Time::getHighResolutionTicks())
+{
+  sfzero::Trace::getInstance().add(sfzero::Trace::loadBegin, 0, 0, 0,
+                                   (stage_ == parsing) ? sfzero::Trace::parsing : sfzero::Trace::loadingSamples);
+}
+
+sfzero::Sound::ScopedLoadTimer::~ScopedLoadTimer()
+{
+  double seconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start_);
+  (stage_ == parsing ? sound_.parseSeconds_ : sound_.sampleLoadSeconds_).store(seconds);
+  sfzero::Trace::getInstance().add(sfzero::Trace::loadEnd, 0, 0, 0,
+                                   (stage_ == parsing) ? sfzero::Trace::parsing : sfzero::Trace::loadingSamples);
+}
+
 void sfzero::Sound::loadRegions()
 {
+  ScopedLoadTimer timer(*this, parsing);
   sfzero::Reader reader(this);
 
   reader.read(file_);
 }
 
+namespace
+{
+struct PendingSample
+{
+  sfzero::Sample *sample;
+  int lokey, hikey;
+  int priority;
+};
+}
+
 void sfzero::Sound::loadSamples(juce::AudioFormatManager *formatManager, double *progressVar, juce::Thread *thread)
 {
+  ScopedLoadTimer timer(*this, loadingSamples);
   if (progressVar)
   {
     *progressVar = 0.0;
   }
 
-  double numSamplesLoaded = 1.0, numSamples = samples_.size();
+  // Find the range of keys each sample is played for, so they can be loaded
+  // in order of how soon they're likely to be needed.
+  juce::Array<PendingSample> pending;
+  juce::HashMap<sfzero::Sample *, int> pendingIndices;
+  pending.ensureStorageAllocated(samples_.size());
   for (juce::HashMap<juce::String, sfzero::Sample *>::Iterator i(samples_); i.next();)
   {
-    sfzero::Sample *sample = i.getValue();
-    bool ok = sample->load(formatManager);
-    if (!ok)
+    PendingSample pendingSample = {i.getValue(), 128, -1, 0};
+    pendingIndices.set(pendingSample.sample, pending.size());
+    pending.add(pendingSample);
+  }
+  for (int i = 0; i < regions_.size(); ++i)
+  {
+    sfzero::Region *region = regions_[i];
+    if ((region->sample != nullptr) && pendingIndices.contains(region->sample))
+    {
+      PendingSample &pendingSample = pending.getReference(pendingIndices[region->sample]);
+      pendingSample.lokey = juce::jmin(pendingSample.lokey, static_cast<int>(region->lokey));
+      pendingSample.hikey = juce::jmax(pendingSample.hikey, static_cast<int>(region->hikey));
+    }
+  }
+
+  // Samples no region plays (those only played crossfaded) aren't loaded.
+  for (int i = pending.size(); --i >= 0;)
+  {
+    if (pending.getReference(i).lokey > pending.getReference(i).hikey)
+    {
+      pending.remove(i);
+    }
+  }
+
+  double numSamplesLoaded = 1.0, numSamples = pending.size();
+  int notesPlayedWhenSorted = -1;
+  bool notifiedPlayable = false;
+  for (int next = 0; next < pending.size(); ++next)
+  {
+    // Re-prioritise whatever is left whenever new notes have been played.
+    int notesPlayed = numNotesPlayed_.load();
+    if (notesPlayed != notesPlayedWhenSorted)
+    {
+      notesPlayedWhenSorted = notesPlayed;
+      int notes[numRecentNotes];
+      int numNotes = getRecentNotes(notes);
+      for (int i = next; i < pending.size(); ++i)
+      {
+        PendingSample &pendingSample = pending.getReference(i);
+        pendingSample.priority = loadPriority(pendingSample.lokey, pendingSample.hikey, notes, numNotes);
+      }
+      std::stable_sort(pending.begin() + next, pending.end(),
+                       [](const PendingSample &a, const PendingSample &b) { return a.priority < b.priority; });
+    }
+
+    sfzero::Sample *sample = pending.getReference(next).sample;
+    bool ok = sample->load(formatManager, compressSamples_);
+    if (ok)
+    {
+      sampleLoaded(sample);
+    }
+    else
     {
       addError("Couldn't load sample \"" + sample->getShortName() + "\"");
     }
 
+    if (!notifiedPlayable && ((next + 1 == pending.size()) || (pending.getReference(next + 1).priority > 0)))
+    {
+      notifiedPlayable = true;
+      if (onPlayable)
+      {
+        onPlayable();
+      }
+    }
+
     numSamplesLoaded += 1.0;
     if (progressVar)
     {
@@ -106,6 +389,11 @@ void sfzero::Sound::loadSamples(juce::AudioFormatManager *formatManager, double
     }
   }
 
+  setLoaded(true);
+  if (!notifiedPlayable && onPlayable)
+  {
+    onPlayable();
+  }
   if (progressVar)
   {
     *progressVar = 1.0;
@@ -114,11 +402,12 @@ void sfzero::Sound::loadSamples(juce::AudioFormatManager *formatManager, double
 
 sfzero::Region *sfzero::Sound::getRegionFor(int note, int velocity, sfzero::Region::Trigger trigger)
 {
-  int numRegions = regions_.size();
+  juce::Array<sfzero::Region *> &regions = getActiveRegions();
+  int numRegions = regions.size();
 
   for (int i = 0; i < numRegions; ++i)
   {
-    sfzero::Region *region = regions_[i];
+    sfzero::Region *region = regions[i];
     if (region->matches(note, velocity, trigger))
     {
       return region;
@@ -128,9 +417,198 @@ sfzero::Region *sfzero::Sound::getRegionFor(int note, int velocity, sfzero::Regi
   return nullptr;
 }
 
-int sfzero::Sound::getNumRegions() { return regions_.size(); }
+int sfzero::Sound::getNumRegions() { return getActiveRegions().size(); }
+
+void sfzero::Sound::notePlayed(int midiNoteNumber)
+{
+  int which = numNotesPlayed_.load();
+  recentNotes_[which % numRecentNotes].store(midiNoteNumber);
+  numNotesPlayed_.store(which + 1);
+}
+
+void sfzero::Sound::copyRecentNotesFrom(sfzero::Sound *other)
+{
+  if (other == nullptr)
+  {
+    return;
+  }
+
+  int notes[numRecentNotes];
+  int numNotes = other->getRecentNotes(notes);
+  for (int i = numNotes; --i >= 0;)
+  {
+    notePlayed(notes[i]);
+  }
+}
+
+namespace
+{
+int keyDistance(const sfzero::Region *region, int note)
+{
+  return (note < region->lokey) ? (region->lokey - note) : (note > region->hikey) ? (note - region->hikey) : 0;
+}
+
+int neighbourCell(int trigger, int velocity, int note) { return (trigger * 128 + velocity) * 128 + note; }
+}
+
+sfzero::Region *sfzero::Sound::getLoadedNeighbour(int note, int velocity, sfzero::Region::Trigger trigger)
+{
+  // The table is only good for the regions it was made for; a subsound
+  // switch since has to wait for the next sample to come in.
+  juce::Array<sfzero::Region *> *regions = neighbourRegions_.load(std::memory_order_acquire);
+  if (!useNeighboursWhileLoading_ || (regions == nullptr) || (regions != activeRegions_.load(std::memory_order_acquire)))
+  {
+    return nullptr;
+  }
+
+  int cell = neighbourCell(neighbourTrigger(trigger), juce::jlimit(0, 127, velocity), juce::jlimit(0, 127, note));
+  int index = neighbours_[cell].load(std::memory_order_acquire) - 1;
+  return juce::isPositiveAndBelow(index, regions->size()) ? regions->getUnchecked(index) : nullptr;
+}
+
+int sfzero::Sound::neighbourTrigger(sfzero::Region::Trigger trigger)
+{
+  switch (trigger)
+  {
+  case sfzero::Region::release:
+    return 0;
+  case sfzero::Region::legato:
+    return 2;
+  default:
+    return 1;
+  }
+}
+
+void sfzero::Sound::sampleLoaded(sfzero::Sample *sample)
+{
+  if (!useNeighboursWhileLoading_ || isLoaded())
+  {
+    return;
+  }
+  if (neighbours_ == nullptr)
+  {
+    neighbours_.calloc(numNeighbourTriggers * 128 * 128);
+  }
 
-sfzero::Region *sfzero::Sound::regionAt(int index) { return regions_[index]; }
+  juce::Array<sfzero::Region *> *regions = activeRegions_.load(std::memory_order_acquire);
+  if (regions == neighbourRegions_.load(std::memory_order_relaxed))
+  {
+    if (firstRegionBySample_.contains(sample))
+    {
+      for (int i = firstRegionBySample_[sample]; i >= 0; i = nextRegionWithSample_.getUnchecked(i))
+      {
+        addNeighbour(*regions, i);
+      }
+    }
+    return;
+  }
+
+  // The regions in use have changed (or this is the first sample): index
+  // them by sample, and start again from every region whose sample is in.
+  neighbourRegions_.store(nullptr, std::memory_order_release);
+  for (int cell = 0; cell < numNeighbourTriggers * 128 * 128; ++cell)
+  {
+    neighbours_[cell].store(0, std::memory_order_relaxed);
+  }
+  firstRegionBySample_.clear();
+  nextRegionWithSample_.clearQuick();
+  nextRegionWithSample_.insertMultiple(0, -1, regions->size());
+  for (int i = regions->size(); --i >= 0;)
+  {
+    sfzero::Region *region = regions->getUnchecked(i);
+    if (region->sample != nullptr)
+    {
+      if (firstRegionBySample_.contains(region->sample))
+      {
+        nextRegionWithSample_.set(i, firstRegionBySample_[region->sample]);
+      }
+      firstRegionBySample_.set(region->sample, i);
+    }
+  }
+  for (int i = 0; i < regions->size(); ++i)
+  {
+    sfzero::Region *region = regions->getUnchecked(i);
+    if ((region->sample != nullptr) && ((region->sample == sample) || region->sample->isLoaded()))
+    {
+      addNeighbour(*regions, i);
+    }
+  }
+  neighbourRegions_.store(regions, std::memory_order_release);
+}
+
+void sfzero::Sound::addNeighbour(juce::Array<sfzero::Region *> &regions, int index)
+{
+  // The nearest by key wins, and of those the first, as with getRegionFor().
+  sfzero::Region *region = regions.getUnchecked(index);
+  for (int trigger = 0; trigger < numNeighbourTriggers; ++trigger)
+  {
+    static const sfzero::Region::Trigger triggers[] = {sfzero::Region::release, sfzero::Region::first,
+                                                        sfzero::Region::legato};
+    if (!region->matchesTrigger(triggers[trigger]))
+    {
+      continue;
+    }
+    int lovel = juce::jmax(0, static_cast<int>(region->lovel)), hivel = juce::jmin(127, static_cast<int>(region->hivel));
+    for (int velocity = lovel; velocity <= hivel; ++velocity)
+    {
+      for (int note = 0; note < 128; ++note)
+      {
+        std::atomic<juce::int32> &cell = neighbours_[neighbourCell(trigger, velocity, note)];
+        int current = cell.load(std::memory_order_relaxed) - 1;
+        if (current >= 0)
+        {
+          int distance = keyDistance(region, note), currentDistance = keyDistance(regions.getUnchecked(current), note);
+          if ((distance > currentDistance) || ((distance == currentDistance) && (index > current)))
+          {
+            continue;
+          }
+        }
+        cell.store(index + 1, std::memory_order_release);
+      }
+    }
+  }
+}
+
+int sfzero::Sound::getRecentNotes(int *notes)
+{
+  // Most recent first.
+  int numPlayed = numNotesPlayed_.load();
+  int numNotes = juce::jmin(numPlayed, static_cast<int>(numRecentNotes));
+  for (int i = 0; i < numNotes; ++i)
+  {
+    notes[i] = recentNotes_[(numPlayed - 1 - i) % numRecentNotes].load();
+  }
+  return numNotes;
+}
+
+int sfzero::Sound::loadPriority(int lokey, int hikey, const int *notes, int numNotes)
+{
+  // Lower is sooner: the distance in keys from the nearest recently played
+  // note, or from middle C if nothing has been played yet.  Samples no region
+  // uses go last.
+  if (lokey > hikey)
+  {
+    return 128;
+  }
+
+  static const int middleC = 60;
+  if (numNotes == 0)
+  {
+    notes = &middleC;
+    numNotes = 1;
+  }
+
+  int priority = 128;
+  for (int i = 0; i < numNotes; ++i)
+  {
+    int note = notes[i];
+    int distance = (note < lokey) ? (lokey - note) : (note > hikey) ? (note - hikey) : 0;
+    priority = juce::jmin(priority, distance);
+  }
+  return priority;
+}
+
+sfzero::Region *sfzero::Sound::regionAt(int index) { return getActiveRegions()[index]; }
 
 int sfzero::Sound::numSubsounds() { return 1; }
 
@@ -140,6 +618,36 @@ void sfzero::Sound::useSubsound(int /*whichSubsound*/) {}
 
 int sfzero::Sound::selectedSubsound() { return 0; }
 
+juce::int64 sfzero::Sound::getSampleMemoryUsage()
+{
+  juce::int64 bytes = 0;
+  for (juce::HashMap<juce::String, sfzero::Sample *>::Iterator i(samples_); i.next();)
+  {
+    bytes += i.getValue()->getMemoryUsage();
+  }
+  return bytes;
+}
+
+juce::int64 sfzero::Sound::getRegionMemoryUsage()
+{
+  juce::int64 bytes = static_cast<juce::int64>(regionBlocks_.size()) * regionBlockSize * sizeof(sfzero::Region) +
+                      static_cast<juce::int64>(parameters_.size()) * sizeof(sfzero::RegionParameters) +
+                      static_cast<juce::int64>(regions_.size()) * sizeof(sfzero::Region *);
+  for (auto *program : modulationPrograms_)
+  {
+    bytes += sizeof(sfzero::ModulationProgram) + program->getNumModulators() * sizeof(sfzero::Modulator);
+  }
+  return bytes;
+}
+
+void sfzero::Sound::getSamples(juce::Array<sfzero::Sample *> &samples)
+{
+  for (juce::HashMap<juce::String, sfzero::Sample *>::Iterator i(samples_); i.next();)
+  {
+    samples.add(i.getValue());
+  }
+}
+
 juce::String sfzero::Sound::dump()
 {
   juce::String info;
@@ -166,12 +674,13 @@ juce::String sfzero::Sound::dump()
     info << "no warnings.\n";
   }
 
-  if (regions_.size() > 0)
+  juce::Array<sfzero::Region *> &regions = getActiveRegions();
+  if (regions.size() > 0)
   {
-    info << regions_.size() << " regions: \n";
-    for (int i = 0; i < regions_.size(); ++i)
+    info << regions.size() << " regions: \n";
+    for (int i = 0; i < regions.size(); ++i)
     {
-      info << regions_[i]->dump();
+      info << regions[i]->dump();
     }
   }
   else
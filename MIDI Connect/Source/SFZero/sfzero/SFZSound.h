@@ -12,7 +12,9 @@
 namespace sfzero
 {
 
+class ModulationProgram;
 class Sample;
+class ResidencyManager;
 
 class Sound : public juce::SynthesiserSound
 {
@@ -25,8 +27,20 @@ public:
   bool appliesToNote(int midiNoteNumber) override;
   bool appliesToChannel(int midiChannel) override;
 
-  void addRegion(Region *region); // Takes ownership of the region.
+  // Stores a region, sharing its parameters with any other region of the
+  // sound that has the same ones, and returns it.  The sound owns it.
+  Region *addRegion(const RegionDescription &description);
+  // The same, but without adding it to the regions the sound plays (for
+  // SF2 presets, which keep their own lists).
+  Region *makeRegion(const RegionDescription &description);
+  // Returns the sound's copy of "program", for RegionDescription::modulation,
+  // dropping its inactive modulators first.
+  const ModulationProgram *internModulation(ModulationProgram program);
   Sample *addSample(juce::String path, juce::String defaultPath = juce::String());
+  // A copy of "sample" with "crossfade" seconds of the audio before the loop
+  // start faded in over the end of the loop, when it's loaded.  The loop is
+  // the sample's own if "loopStart" isn't before "loopEnd".
+  Sample *addCrossfadedSample(Sample *sample, juce::int64 loopStart, juce::int64 loopEnd, float crossfade);
   void addError(const juce::String &message);
   void addUnsupportedOpcode(const juce::String &opcode);
 
@@ -34,10 +48,33 @@ public:
   virtual void loadSamples(juce::AudioFormatManager *formatManager, double *progressVar = nullptr,
                            juce::Thread *thread = nullptr);
 
+  // These look at the regions in use, which a subsound switch can change at
+  // any time; the switch is a single pointer store, so they are safe to call
+  // from the audio thread.
   Region *getRegionFor(int note, int velocity, Region::Trigger trigger = Region::attack);
   int getNumRegions();
   Region *regionAt(int index);
 
+  // Progressive loading.  The sound is playable as soon as its regions are
+  // read; loadSamples() then loads the samples nearest the recently played
+  // notes first.  While that is going on, a region whose sample isn't loaded
+  // yet can be stood in for by the nearest region that is (or stays silent).
+  // The loader keeps a table of those by trigger, velocity and key as the
+  // samples come in, so finding one is a single lookup on the audio thread.
+  bool isLoaded() const { return loaded_.load(); }
+  void notePlayed(int midiNoteNumber); // Safe to call from the audio thread.
+  void copyRecentNotesFrom(Sound *other);
+  void setUseNeighboursWhileLoading(bool shouldUse) { useNeighboursWhileLoading_ = shouldUse; }
+  Region *getLoadedNeighbour(int note, int velocity, Region::Trigger trigger = Region::attack);
+
+  // Keep samples losslessly compressed in memory, where possible (see
+  // CompressedSample).  Set before loadSamples().
+  void setCompressSamples(bool shouldCompress) { compressSamples_ = shouldCompress; }
+
+  // Called on the loading thread once the samples nearest the recently played
+  // notes are in, before loadSamples() has finished with the rest.
+  std::function<void()> onPlayable;
+
   const juce::StringArray &getErrors() { return errors_; }
   const juce::StringArray &getWarnings() { return warnings_; }
 
@@ -46,17 +83,102 @@ public:
   virtual void useSubsound(int whichSubsound);
   virtual int selectedSubsound();
 
+  // Bytes of sample data currently loaded.
+  virtual juce::int64 getSampleMemoryUsage();
+  // Bytes taken by the regions and their shared parameters.
+  juce::int64 getRegionMemoryUsage();
+  int getNumRegionParameters() { return parameters_.size(); }
+  // How long loadRegions() and loadSamples() took; see SoundReport.
+  double getParseSeconds() const { return parseSeconds_.load(); }
+  double getSampleLoadSeconds() const { return sampleLoadSeconds_.load(); }
+  virtual void getSamples(juce::Array<Sample *> &samples);
+  // Also the samples getSamples() leaves out because they can't be evicted.
+  virtual void getAllSamples(juce::Array<Sample *> &samples) { getSamples(samples); }
+  void setResidencyManager(ResidencyManager *manager) { residencyManager_ = manager; } // By ResidencyManager::addSound().
+
   juce::String dump();
   juce::Array<Region *> &getRegions() { return regions_; }
   juce::File &getFile() { return file_; }
 
+protected:
+  enum LoadStage
+  {
+    parsing,
+    loadingSamples
+  };
+
+  // Times a loadRegions() or loadSamples() implementation, however it returns.
+  class ScopedLoadTimer
+  {
+  public:
+    ScopedLoadTimer(Sound &sound, LoadStage stage);
+    ~ScopedLoadTimer();
+
+  private:
+    Sound &sound_;
+    LoadStage stage_;
+    juce::int64 start_;
+
+    JUCE_DECLARE_NON_COPYABLE(ScopedLoadTimer)
+  };
+
+  void setLoaded(bool isNowLoaded) { loaded_.store(isNowLoaded); }
+  // Takes the sound off its ResidencyManager, which mustn't work on samples
+  // that are being deleted.  A subclass with samples of its own calls this
+  // first thing in its destructor.
+  void leaveResidencyManager();
+  // Loading thread: records that "sample" has just been loaded, for
+  // getLoadedNeighbour().  Calls must not overlap.
+  void sampleLoaded(Sample *sample);
+  // Switches the regions in use; "regions" must outlive the sound.
+  void setActiveRegions(juce::Array<Region *> *regions) { activeRegions_.store(regions, std::memory_order_release); }
+  juce::Array<Region *> &getActiveRegions() { return *activeRegions_.load(std::memory_order_acquire); }
+
 private:
+  enum
+  {
+    numRecentNotes = 16,
+    regionBlockSize = 256, // Regions are allocated this many at a time, so the ones read together lie together.
+    numNeighbourTriggers = 3 // release, first and legato; attack regions are in the last two.
+  };
+
+  const RegionParameters *internParameters(const RegionParameters &parameters);
+  int loadPriority(int lokey, int hikey, const int *notes, int numNotes);
+  int getRecentNotes(int *notes);
+  static int neighbourTrigger(Region::Trigger trigger);
+  void addNeighbour(juce::Array<Region *> &regions, int index);
+
   juce::File file_;
   juce::Array<Region *> regions_;
+  juce::OwnedArray<juce::HeapBlock<Region>> regionBlocks_;
+  int numInLastBlock_;
+  juce::OwnedArray<RegionParameters> parameters_;
+  juce::HashMap<juce::int64, RegionParameters *> parametersByHash_;
+  juce::OwnedArray<ModulationProgram> modulationPrograms_;
+  juce::HashMap<juce::int64, ModulationProgram *> modulationByHash_;
+  std::atomic<juce::Array<Region *> *> activeRegions_;
   juce::HashMap<juce::String, Sample *> samples_;
   juce::StringArray errors_;
   juce::StringArray warnings_;
   juce::HashMap<juce::String, juce::String> unsupportedOpcodes_;
+  std::atomic<bool> loaded_;
+  bool useNeighboursWhileLoading_;
+  bool compressSamples_;
+  std::atomic<int> recentNotes_[numRecentNotes];
+  std::atomic<int> numNotesPlayed_;
+  // For each trigger, velocity and key, one plus the index in
+  // *neighbourRegions_ of the nearest region whose sample is loaded, or zero.
+  // Allocated by the first sampleLoaded(); neighbourRegions_ is set once it's
+  // filled in for those regions.
+  juce::HeapBlock<std::atomic<juce::int32>> neighbours_;
+  std::atomic<juce::Array<Region *> *> neighbourRegions_;
+  // Which of *neighbourRegions_ play each sample, so sampleLoaded() needn't
+  // look through them all: the index of the first, and for each region the
+  // index of the next with the same sample, or -1.
+  juce::HashMap<Sample *, int> firstRegionBySample_;
+  juce::Array<int> nextRegionWithSample_;
+  std::atomic<double> parseSeconds_, sampleLoadSeconds_;
+  ResidencyManager *residencyManager_;
 
   JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Sound)
 };
@@ -0,0 +1,191 @@
+/*************************************************************************************
+ * Original code copyright (C) 2012 Steve Folta
+ * Converted to Juce module (C) 2016 Leo Olivers
+ * Forked from https://github.com/stevefolta/SFZero
+ * For license info please see the LICENSE file distributed with this source code
+ *************************************************************************************/
+#include "SFZSoundReport.h"
+#include "SFZModulation.h"
+#include "SFZSample.h"
+#include "SFZSampleArena.h"
+#include "SFZSound.h"
+
+namespace
+{
+juce::int64 bytesOfBuffer(const juce::AudioSampleBuffer *buffer)
+{
+  return buffer ? static_cast<juce::int64>(buffer->getNumChannels()) * buffer->getNumSamples() * sizeof(float) : 0;
+}
+
+juce::String megabytes(juce::int64 bytes) { return juce::String(bytes / (1024.0 * 1024.0), 1) + " MB"; }
+}
+
+sfzero::SoundReport::SoundReport(sfzero::Sound &sound)
+    : file(sound.getFile()), sampleBytes(0), uniqueBytes(0), sharedBytes(0), regionBytes(sound.getRegionMemoryUsage()),
+      parseSeconds(sound.getParseSeconds()), sampleLoadSeconds(sound.getSampleLoadSeconds()), decodeSeconds(0.0),
+      totalSeconds(parseSeconds + sampleLoadSeconds)
+{
+  // The sound's own samples, then any others its regions play (an SF2
+  // file's, when they share the whole file's buffer).
+  juce::Array<sfzero::Sample *> soundSamples;
+  sound.getSamples(soundSamples);
+  int numRegions = sound.getNumRegions();
+  for (int i = 0; i < numRegions; ++i)
+  {
+    sfzero::Region *region = sound.regionAt(i);
+    if (region && region->sample)
+    {
+      soundSamples.addIfNotAlreadyThere(region->sample);
+    }
+  }
+
+  // A buffer is shared if something other than this sound's samples holds
+  // it, so count all of them, not just those listed: an SF2 file's buffer is
+  // also held by per-rate samples that no region of the selected preset uses.
+  juce::Array<sfzero::Sample *> allSamples;
+  sound.getAllSamples(allSamples);
+  for (auto *sample : soundSamples)
+  {
+    allSamples.addIfNotAlreadyThere(sample);
+  }
+  juce::HashMap<juce::AudioSampleBuffer *, int> bufferUses;
+  for (auto *sample : allSamples)
+  {
+    juce::AudioSampleBuffer *buffer = sample->getBuffer();
+    if (buffer)
+    {
+      bufferUses.set(buffer, bufferUses[buffer] + 1);
+    }
+  }
+
+  juce::HashMap<sfzero::Sample *, int> sampleIndices;
+  for (auto *sample : soundSamples)
+  {
+    sampleIndices.set(sample, samples.size());
+    SampleInfo info = {sample->getShortName(), sample->getMemoryUsage(), false, sample->getCompressed() != nullptr,
+                       sample->isEvicted(), sample->getLoadSeconds(), 0};
+    samples.add(info);
+    decodeSeconds += info.loadSeconds;
+  }
+
+  // Each buffer counts once.  Heads of evicted samples and compressed data
+  // are always the sample's own.
+  sfzero::SampleArena &arena = sfzero::SampleArena::getInstance();
+  juce::HashMap<juce::AudioSampleBuffer *, bool> counted;
+  for (int i = 0; i < soundSamples.size(); ++i)
+  {
+    SampleInfo &info = samples.getReference(i);
+    juce::AudioSampleBuffer *buffer = soundSamples.getUnchecked(i)->getBuffer();
+    juce::int64 bufferBytes = bytesOfBuffer(buffer);
+    uniqueBytes += info.bytes - bufferBytes;
+    sampleBytes += info.bytes - bufferBytes;
+    if (buffer == nullptr)
+    {
+      continue;
+    }
+    info.shared = arena.getReferenceCount(buffer) > bufferUses[buffer];
+    if (!counted.contains(buffer))
+    {
+      counted.set(buffer, true);
+      sampleBytes += bufferBytes;
+      (info.shared ? sharedBytes : uniqueBytes) += bufferBytes;
+    }
+  }
+
+  // Regions split what they have in common evenly.
+  juce::HashMap<const sfzero::RegionParameters *, int> parameterUses;
+  juce::HashMap<const sfzero::ModulationProgram *, int> modulationUses;
+  for (int i = 0; i < numRegions; ++i)
+  {
+    sfzero::Region *region = sound.regionAt(i);
+    parameterUses.set(region->parameters, parameterUses[region->parameters] + 1);
+    if (region->parameters->modulation)
+    {
+      modulationUses.set(region->parameters->modulation, modulationUses[region->parameters->modulation] + 1);
+    }
+    if (region->sample)
+    {
+      samples.getReference(sampleIndices[region->sample]).numRegions += 1;
+    }
+  }
+  for (int i = 0; i < numRegions; ++i)
+  {
+    sfzero::Region *region = sound.regionAt(i);
+    const sfzero::ModulationProgram *modulation = region->parameters->modulation;
+    RegionInfo info = {region->lokey, region->hikey, region->lovel, region->hivel, -1, 0, 0};
+    info.bytes = sizeof(sfzero::Region) + sizeof(sfzero::RegionParameters) / parameterUses[region->parameters];
+    if (modulation)
+    {
+      info.bytes += (sizeof(sfzero::ModulationProgram) + modulation->getNumModulators() * sizeof(sfzero::Modulator)) /
+                    modulationUses[modulation];
+    }
+    if (region->sample)
+    {
+      info.sample = sampleIndices[region->sample];
+      const SampleInfo &sample = samples.getReference(info.sample);
+      info.sampleBytes = sample.bytes / juce::jmax(1, sample.numRegions);
+    }
+    regions.add(info);
+  }
+}
+
+juce::var sfzero::SoundReport::toJSON() const
+{
+  juce::Array<juce::var> sampleList;
+  for (auto &sample : samples)
+  {
+    juce::DynamicObject::Ptr entry = new juce::DynamicObject();
+    entry->setProperty("name", sample.name);
+    entry->setProperty("bytes", sample.bytes);
+    entry->setProperty("shared", sample.shared);
+    entry->setProperty("compressed", sample.compressed);
+    entry->setProperty("evicted", sample.evicted);
+    entry->setProperty("load_seconds", sample.loadSeconds);
+    entry->setProperty("regions", sample.numRegions);
+    sampleList.add(juce::var(entry.get()));
+  }
+
+  juce::Array<juce::var> regionList;
+  for (auto &region : regions)
+  {
+    juce::DynamicObject::Ptr entry = new juce::DynamicObject();
+    entry->setProperty("lokey", region.lokey);
+    entry->setProperty("hikey", region.hikey);
+    entry->setProperty("lovel", region.lovel);
+    entry->setProperty("hivel", region.hivel);
+    entry->setProperty("sample", region.sample);
+    entry->setProperty("bytes", region.bytes);
+    entry->setProperty("sample_bytes", region.sampleBytes);
+    regionList.add(juce::var(entry.get()));
+  }
+
+  juce::DynamicObject::Ptr report = new juce::DynamicObject();
+  report->setProperty("file", file.getFullPathName());
+  report->setProperty("sample_bytes", sampleBytes);
+  report->setProperty("unique_bytes", uniqueBytes);
+  report->setProperty("shared_bytes", sharedBytes);
+  report->setProperty("region_bytes", regionBytes);
+  report->setProperty("parse_seconds", parseSeconds);
+  report->setProperty("sample_load_seconds", sampleLoadSeconds);
+  report->setProperty("decode_seconds", decodeSeconds);
+  report->setProperty("total_seconds", totalSeconds);
+  report->setProperty("samples", sampleList);
+  report->setProperty("regions", regionList);
+  return juce::var(report.get());
+}
+
+bool sfzero::SoundReport::writeJSON(const juce::File &destination) const
+{
+  return destination.replaceWithText(juce::JSON::toString(toJSON()));
+}
+
+juce::String sfzero::SoundReport::summary() const
+{
+  juce::String info;
+  info << file.getFileName() << ": " << megabytes(sampleBytes) << " of samples (" << megabytes(uniqueBytes)
+       << " its own, " << megabytes(sharedBytes) << " shared), " << megabytes(regionBytes) << " of regions\n";
+  info << samples.size() << " samples, " << regions.size() << " regions; parsed in " << juce::String(parseSeconds, 3)
+       << " s, samples loaded in " << juce::String(sampleLoadSeconds, 3) << " s (" << juce::String(decodeSeconds, 3)
+       << " s decoding), " << juce::String(totalSeconds, 3) << " s in all\n";
+  return info;
+}
@@ -0,0 +1,70 @@
+/*************************************************************************************
+ * Original code copyright (C) 2012 Steve Folta
+ * Converted to Juce module (C) 2016 Leo Olivers
+ * Forked from https://github.com/stevefolta/SFZero
+ * For license info please see the LICENSE file distributed with this source code
+ *************************************************************************************/
+#ifndef SFZSOUNDREPORT_H_INCLUDED
+#define SFZSOUNDREPORT_H_INCLUDED
+
+#include "SFZCommon.h"
+
+namespace sfzero
+{
+
+class Sound;
+
+// What a sound costs: the memory its samples and regions take, and how long
+// it took to load.  For sizing deployments, and finding the instruments that
+// blow a memory budget.  Made from a sound once it's loaded; it's a copy, so
+// it doesn't change when samples are evicted or refaulted afterwards.
+//
+// A sample buffer is "shared" when something besides this sound holds it:
+// another sound loaded from the same file, or identical audio interned by
+// the SampleArena.  Unloading the sound wouldn't free those bytes.
+struct SoundReport
+{
+  explicit SoundReport(Sound &sound);
+
+  struct SampleInfo
+  {
+    juce::String name;
+    juce::int64 bytes; // As Sample::getMemoryUsage().
+    bool shared;
+    bool compressed;
+    bool evicted;
+    double loadSeconds; // Reading and decoding it.
+    int numRegions;     // Of those in use that play it.
+  };
+
+  struct RegionInfo
+  {
+    int lokey, hikey, lovel, hivel;
+    int sample; // Index into "samples", or -1.
+    // The region itself and its share of the parameters and modulators it
+    // has in common with others.
+    juce::int64 bytes;
+    // Its share of its sample, which the regions playing it split evenly.
+    juce::int64 sampleBytes;
+  };
+
+  juce::File file;
+  juce::Array<SampleInfo> samples;
+  juce::Array<RegionInfo> regions; // Those in use, which for an SF2 file is the selected preset's.
+
+  // Bytes of sample data, each buffer counted once.
+  juce::int64 sampleBytes, uniqueBytes, sharedBytes;
+  juce::int64 regionBytes; // As Sound::getRegionMemoryUsage().
+
+  double parseSeconds;      // loadRegions().
+  double sampleLoadSeconds; // loadSamples(), wall time.
+  double decodeSeconds;     // Summed over the samples, which SF2 files load on several threads.
+  double totalSeconds;
+
+  juce::var toJSON() const;
+  bool writeJSON(const juce::File &destination) const;
+  juce::String summary() const;
+};
+}
+
+#endif // SFZSOUNDREPORT_H_INCLUDED
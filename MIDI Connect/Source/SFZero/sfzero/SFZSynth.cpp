@@ -5,10 +5,18 @@
  * For license info please see the LICENSE file distributed with this source code
  *************************************************************************************/
 #include "SFZSynth.h"
+#include "SFZProgramBank.h"
+#include "SFZSample.h"
 #include "SFZSound.h"
+#include "SFZTelemetry.h"
+#include "SFZTrace.h"
 #include "SFZVoice.h"
 
-sfzero::Synth::Synth() : Synthesiser() {}
+sfzero::Synth::Synth()
+    : Synthesiser(), currentSound_(nullptr), programBank_(nullptr), telemetry_(nullptr), renderPass_(0),
+      numVoicesUsed_(0), numStartedVoices_(0)
+{
+}
 
 void sfzero::Synth::noteOn(int midiChannel, int midiNoteNumber, float velocity)
 {
@@ -17,18 +25,19 @@ void sfzero::Synth::noteOn(int midiChannel, int midiNoteNumber, float velocity)
   const juce::ScopedLock locker(lock);
 
   int midiVelocity = static_cast<int>(velocity * 127);
+  sfzero::Trace::getInstance().add(sfzero::Trace::noteOn, 0, midiChannel, midiNoteNumber, midiVelocity);
 
   // First, stop any currently-playing sounds in the group.
   //*** Currently, this only pays attention to the first matching region.
   int group = 0;
-  sfzero::Sound *sound = dynamic_cast<sfzero::Sound *>(getSound(0).get()); // commented out to prevent a build error
+  sfzero::Sound *sound = getCurrentSound();
 
   if (sound)
   {
     sfzero::Region *region = sound->getRegionFor(midiNoteNumber, midiVelocity);
     if (region)
     {
-      group = region->group;
+      group = region->parameters->group;
     }
   }
   if (group != 0)
@@ -43,6 +52,10 @@ void sfzero::Synth::noteOn(int midiChannel, int midiNoteNumber, float velocity)
       if (voice->getOffBy() == group)
       {
         voice->stopNoteForGroup();
+        if (telemetry_)
+        {
+          telemetry_->voiceCulled();
+        }
       }
     }
   }
@@ -66,6 +79,10 @@ void sfzero::Synth::noteOn(int midiChannel, int midiNoteNumber, float velocity)
           if (!voice->isPlayingOneShot())
           {
             voice->stopNoteQuick();
+            if (telemetry_)
+            {
+              telemetry_->voiceCulled();
+            }
           }
         }
         else
@@ -80,17 +97,44 @@ void sfzero::Synth::noteOn(int midiChannel, int midiNoteNumber, float velocity)
   sfzero::Region::Trigger trigger = (anyNotesPlaying ? sfzero::Region::legato : sfzero::Region::first);
   if (sound)
   {
+    sound->notePlayed(midiNoteNumber);
+
+    bool soundIsLoading = !sound->isLoaded();
+    sfzero::Region *lastStandIn = nullptr;
     int numRegions = sound->getNumRegions();
     for (i = 0; i < numRegions; ++i)
     {
       sfzero::Region *region = sound->regionAt(i);
       if (region->matches(midiNoteNumber, midiVelocity, trigger))
       {
+        if (soundIsLoading && (region->sample != nullptr) && !region->sample->isLoaded())
+        {
+          // Its sample hasn't been loaded yet; play the nearest region that
+          // has been instead (once, even if several regions need it).
+          region = sound->getLoadedNeighbour(midiNoteNumber, midiVelocity, trigger);
+          if ((region == nullptr) || (region == lastStandIn))
+          {
+            continue;
+          }
+          lastStandIn = region;
+        }
         sfzero::Voice *voice =
             dynamic_cast<sfzero::Voice *>(findFreeVoice(sound, midiNoteNumber, midiChannel, isNoteStealingEnabled()));
         if (voice)
         {
+          bool stolen = voice->getCurrentlyPlayingNote() >= 0;
+          if (stolen)
+          {
+            sfzero::Trace::getInstance().add(sfzero::Trace::voiceSteal, voice->getTraceId(), midiChannel,
+                                             voice->getCurrentlyPlayingNote(), 0);
+          }
+          if (telemetry_)
+          {
+            telemetry_->noteStarted(stolen);
+            addStartedVoice(voice);
+          }
           voice->setRegion(region);
+          voice->setChannelState(getChannelState(midiChannel));
           startVoice(voice, sound, midiChannel, midiNoteNumber, velocity);
         }
       }
@@ -104,10 +148,12 @@ void sfzero::Synth::noteOff(int midiChannel, int midiNoteNumber, float velocity,
 {
   const juce::ScopedLock locker(lock);
 
+  sfzero::Trace::getInstance().add(sfzero::Trace::noteOff, 0, midiChannel, midiNoteNumber,
+                                   static_cast<int>(velocity * 127));
   Synthesiser::noteOff(midiChannel, midiNoteNumber, velocity, allowTailOff);
 
   // Start release region.
-  sfzero::Sound *sound = dynamic_cast<sfzero::Sound *>(getSound(0).get()); // commented out to prevent a build error
+  sfzero::Sound *sound = getCurrentSound();
   if (sound)
   {
     sfzero::Region *region = sound->getRegionFor(midiNoteNumber, noteVelocities_[midiNoteNumber], sfzero::Region::release);
@@ -118,25 +164,161 @@ void sfzero::Synth::noteOff(int midiChannel, int midiNoteNumber, float velocity,
       {
         // Synthesiser is too locked-down (ivars are private rt protected), so
         // we have to use a "setRegion()" mechanism.
+        if (telemetry_)
+        {
+          telemetry_->noteStarted(false);
+          addStartedVoice(voice);
+        }
         voice->setRegion(region);
+        voice->setChannelState(getChannelState(midiChannel));
         startVoice(voice, sound, midiChannel, midiNoteNumber, noteVelocities_[midiNoteNumber] / 127.0f);
       }
     }
   }
 }
 
-int sfzero::Synth::numVoicesUsed()
+void sfzero::Synth::handleProgramChange(int /*midiChannel*/, int programNumber)
+{
+  if (programBank_)
+  {
+    programBank_->selectProgram(programNumber);
+  }
+}
+
+void sfzero::Synth::handleController(int midiChannel, int controllerNumber, int controllerValue)
+{
+  // Recorded before the voices hear of it, so they read the new value.
+  if ((controllerNumber >= 0) && (controllerNumber < 128))
+  {
+    getChannelState(midiChannel)->controllers[controllerNumber] = controllerValue;
+  }
+  Synthesiser::handleController(midiChannel, controllerNumber, controllerValue);
+}
+
+void sfzero::Synth::handleChannelPressure(int midiChannel, int channelPressureValue)
+{
+  getChannelState(midiChannel)->pressure = channelPressureValue;
+  Synthesiser::handleChannelPressure(midiChannel, channelPressureValue);
+}
+
+sfzero::ChannelState *sfzero::Synth::getChannelState(int midiChannel)
+{
+  return &channels_[juce::jlimit(1, 16, midiChannel) - 1];
+}
+
+void sfzero::Synth::setSound(sfzero::Sound *newSound)
+{
+  const juce::ScopedLock locker(retireLock_);
+
+  currentSound_.store(newSound);
+  if (ownedSound_ != nullptr)
+  {
+    retireSound(ownedSound_.get());
+  }
+  ownedSound_ = newSound;
+}
+
+void sfzero::Synth::retireSound(sfzero::Sound *sound)
+{
+  const juce::ScopedLock locker(retireLock_);
+
+  // Retired twice, it's held once, or its own reference would keep it alive;
+  // it waits for a pass after the later retirement.
+  int index = retiredSounds_.indexOf(sound);
+  if (index >= 0)
+  {
+    retiredAtPass_.set(index, renderPass_.load());
+    return;
+  }
+  retiredSounds_.add(sound);
+  retiredAtPass_.add(renderPass_.load());
+}
+
+void sfzero::Synth::collectGarbage()
+{
+  const juce::ScopedLock locker(retireLock_);
+
+  // Once a render pass has started since the swap, any note-on that read the
+  // old pointer has finished, so the voices' references are all that can be
+  // keeping it alive.  A retired sound may also have been selected again (by
+  // a program change) in the meantime, so it stays while it's current.
+  juce::uint64 pass = renderPass_.load();
+  sfzero::Sound *current = currentSound_.load();
+  for (int i = retiredSounds_.size(); --i >= 0;)
+  {
+    sfzero::Sound *sound = retiredSounds_.getObjectPointerUnchecked(i);
+    if ((retiredAtPass_[i] < pass) && (sound != current) && (sound->getReferenceCount() == 1))
+    {
+      retiredSounds_.remove(i);
+      retiredAtPass_.remove(i);
+    }
+  }
+}
+
+int sfzero::Synth::useTimeSlice()
+{
+  collectGarbage();
+  return 250;
+}
+
+void sfzero::Synth::renderVoices(juce::AudioSampleBuffer &outputBuffer, int startSample, int numSamples)
 {
+  renderPass_.fetch_add(1);
+  juce::int64 start = telemetry_ ? juce::Time::getHighResolutionTicks() : 0;
+
+  // What Synthesiser::renderVoices() does, counting the voices still playing
+  // on the way.
   int numUsed = 0;
+  for (int i = 0; i < voices.size(); ++i)
+  {
+    juce::SynthesiserVoice *voice = voices.getUnchecked(i);
+    voice->renderNextBlock(outputBuffer, startSample, numSamples);
+    if (voice->getCurrentlyPlayingNote() >= 0)
+    {
+      numUsed += 1;
+    }
+  }
+  numVoicesUsed_.store(numUsed, std::memory_order_relaxed);
+
+  if (telemetry_ == nullptr)
+  {
+    numStartedVoices_ = 0;
+    return;
+  }
+  juce::int64 end = juce::Time::getHighResolutionTicks();
+  telemetry_->addVoiceTicks(end - start);
+
+  // Notes started since the last pass have now rendered their first samples.
+  for (int i = 0; i < numStartedVoices_; ++i)
+  {
+    juce::int64 startTicks = startedVoices_[i]->takeStartTicks();
+    if (startTicks != 0)
+    {
+      telemetry_->addNoteLatency(end - startTicks);
+    }
+  }
+  numStartedVoices_ = 0;
+}
 
+void sfzero::Synth::addStartedVoice(sfzero::Voice *voice)
+{
+  if (numStartedVoices_ < juce::numElementsInArray(startedVoices_))
+  {
+    startedVoices_[numStartedVoices_++] = voice;
+  }
+}
+
+void sfzero::Synth::setFixedPointPhase(bool shouldUseFixedPoint)
+{
+  const juce::ScopedLock locker(lock);
   for (int i = voices.size(); --i >= 0;)
   {
-    if (voices.getUnchecked(i)->getCurrentlyPlayingNote() >= 0)
+    sfzero::Voice *voice = dynamic_cast<sfzero::Voice *>(voices.getUnchecked(i));
+    if (voice)
     {
-      numUsed += 1;
+      voice->setFixedPointPhase(shouldUseFixedPoint);
     }
   }
-  return numUsed;
 }
 
 juce::String sfzero::Synth::voiceInfoString()
@@ -7,12 +7,17 @@
 #ifndef SFZSYNTH_H_INCLUDED
 #define SFZSYNTH_H_INCLUDED
 
-#include "SFZCommon.h"
+#include "SFZModulation.h"
+#include "SFZSound.h"
 
 namespace sfzero
 {
 
-class Synth : public juce::Synthesiser
+class ProgramBank;
+class Telemetry;
+class Voice;
+
+class Synth : public juce::Synthesiser, public juce::TimeSliceClient
 {
 public:
   Synth();
@@ -20,12 +25,68 @@ public:
 
   void noteOn(int midiChannel, int midiNoteNumber, float velocity) override;
   void noteOff(int midiChannel, int midiNoteNumber, float velocity, bool allowTailOff) override;
+  void handleProgramChange(int midiChannel, int programNumber) override;
+  void handleController(int midiChannel, int controllerNumber, int controllerValue) override;
+  void handleChannelPressure(int midiChannel, int channelPressureValue) override;
+
+  // The sound that new notes are started with.  setSound() publishes a new
+  // one with a single atomic swap and must be called off the audio thread.
+  // Voices still playing the previous sound keep it alive to finish their
+  // release tails; it is then deleted by collectGarbage(), which runs on
+  // whatever thread this is registered with as a TimeSliceClient, never on the
+  // audio thread.
+  void setSound(Sound *newSound);
+  Sound *getCurrentSound() const { return currentSound_.load(std::memory_order_acquire); }
+  void collectGarbage();
+  int useTimeSlice() override;
+
+  // Makes a sound someone else keeps alive current, from any thread including
+  // the audio thread.  When the owner lets go of it, it must hand it to
+  // retireSound() rather than dropping its reference.
+  void selectSound(Sound *sound) { currentSound_.store(sound); }
+  void retireSound(Sound *sound);
+
+  // MIDI program changes select programs from "bank", if set.
+  void setProgramBank(ProgramBank *bank) { programBank_ = bank; }
+  // Counts notes, steals and culls into "telemetry", and times the voices.
+  void setTelemetry(Telemetry *telemetry) { telemetry_ = telemetry; }
+
+  // Has the voices step through samples in fixed point, for output that's
+  // bit-for-bit repeatable; see Voice::setFixedPointPhase().
+  void setFixedPointPhase(bool shouldUseFixedPoint);
 
-  int numVoicesUsed();
+  // As of the last render pass; counted while rendering, so it's cheap.
+  int numVoicesUsed() const { return numVoicesUsed_.load(std::memory_order_relaxed); }
   juce::String voiceInfoString();
 
+protected:
+  using juce::Synthesiser::renderVoices;
+  void renderVoices(juce::AudioSampleBuffer &outputBuffer, int startSample, int numSamples) override;
+
 private:
   int noteVelocities_[128];
+  // What the voices' SF2 modulators read, per MIDI channel.
+  ChannelState channels_[16];
+
+  ChannelState *getChannelState(int midiChannel);
+  void addStartedVoice(Voice *voice);
+
+  std::atomic<Sound *> currentSound_;
+  Sound::Ptr ownedSound_;
+  ProgramBank *programBank_;
+  Telemetry *telemetry_;
+  // Counts render passes, so a retired sound is only reclaimed once the audio
+  // thread can no longer be holding the raw pointer it read before the swap.
+  std::atomic<juce::uint64> renderPass_;
+  std::atomic<int> numVoicesUsed_;
+  // Voices started since the last render pass, whose note latency the
+  // telemetry is waiting for.  More than this many in one pass go uncounted.
+  Voice *startedVoices_[128];
+  int numStartedVoices_;
+  juce::ReferenceCountedArray<Sound> retiredSounds_;
+  juce::Array<juce::uint64> retiredAtPass_;
+  juce::CriticalSection retireLock_;
+
   JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Synth)
 };
 }
@@ -0,0 +1,153 @@
+/*************************************************************************************
+ * Original code copyright (C) 2012 Steve Folta
+ * Converted to Juce module (C) 2016 Leo Olivers
+ * Forked from https://github.com/stevefolta/SFZero
+ * For license info please see the LICENSE file distributed with this source code
+ *************************************************************************************/
+#include "SFZTelemetry.h"
+
+namespace
+{
+double ticksToMicros(juce::int64 ticks)
+{
+  return juce::Time::highResolutionTicksToSeconds(ticks) * 1000000.0;
+}
+}
+
+sfzero::Telemetry::Telemetry() : resetRequested_(false), blockVoiceTicks_(0) { clear(); }
+
+bool sfzero::Telemetry::addBlock(int numSamples, double sampleRate, juce::int64 ticks, juce::int64 synthTicks,
+                                 int activeVoices)
+{
+  if (resetRequested_.exchange(false))
+  {
+    clear();
+  }
+
+  double micros = ticksToMicros(ticks);
+  blockTimes_.add(micros);
+  increment(numBlocks_);
+  bool missed = (sampleRate > 0.0) && (micros > numSamples * 1000000.0 / sampleRate);
+  if (missed)
+  {
+    increment(numDeadlineMisses_);
+  }
+  if (ticks > maxBlockTicks_.load(std::memory_order_relaxed))
+  {
+    maxBlockTicks_.store(ticks, std::memory_order_relaxed);
+  }
+
+  activeVoices_.store(activeVoices, std::memory_order_relaxed);
+  if (activeVoices > peakVoices_.load(std::memory_order_relaxed))
+  {
+    peakVoices_.store(activeVoices, std::memory_order_relaxed);
+  }
+
+  increment(voiceTicks_, blockVoiceTicks_);
+  increment(eventTicks_, juce::jmax(static_cast<juce::int64>(0), synthTicks - blockVoiceTicks_));
+  increment(otherTicks_, juce::jmax(static_cast<juce::int64>(0), ticks - synthTicks));
+  blockVoiceTicks_ = 0;
+  return missed;
+}
+
+void sfzero::Telemetry::addNoteLatency(juce::int64 ticks)
+{
+  noteLatencies_.add(ticksToMicros(ticks));
+  if (ticks > maxNoteLatencyTicks_.load(std::memory_order_relaxed))
+  {
+    maxNoteLatencyTicks_.store(ticks, std::memory_order_relaxed);
+  }
+}
+
+void sfzero::Telemetry::noteStarted(bool stolen)
+{
+  increment(numNotes_);
+  if (stolen)
+  {
+    increment(numSteals_);
+  }
+}
+
+void sfzero::Telemetry::getSnapshot(sfzero::TelemetrySnapshot &snapshot) const
+{
+  snapshot.numBlocks = numBlocks_.load(std::memory_order_relaxed);
+  snapshot.blockMedian = blockTimes_.percentile(0.5);
+  snapshot.blockP99 = blockTimes_.percentile(0.99);
+  snapshot.blockMax = ticksToMicros(maxBlockTicks_.load(std::memory_order_relaxed));
+  snapshot.numDeadlineMisses = numDeadlineMisses_.load(std::memory_order_relaxed);
+
+  snapshot.activeVoices = activeVoices_.load(std::memory_order_relaxed);
+  snapshot.peakVoices = peakVoices_.load(std::memory_order_relaxed);
+  snapshot.numNotes = numNotes_.load(std::memory_order_relaxed);
+  snapshot.numSteals = numSteals_.load(std::memory_order_relaxed);
+  snapshot.numCulls = numCulls_.load(std::memory_order_relaxed);
+
+  snapshot.noteLatencyMedian = noteLatencies_.percentile(0.5);
+  snapshot.noteLatencyMax = ticksToMicros(maxNoteLatencyTicks_.load(std::memory_order_relaxed));
+
+  double numBlocks = static_cast<double>(juce::jmax(static_cast<juce::uint64>(1), snapshot.numBlocks));
+  snapshot.eventMicros = ticksToMicros(eventTicks_.load(std::memory_order_relaxed)) / numBlocks;
+  snapshot.voiceMicros = ticksToMicros(voiceTicks_.load(std::memory_order_relaxed)) / numBlocks;
+  snapshot.otherMicros = ticksToMicros(otherTicks_.load(std::memory_order_relaxed)) / numBlocks;
+}
+
+void sfzero::Telemetry::clear()
+{
+  blockTimes_.clear();
+  noteLatencies_.clear();
+  numBlocks_.store(0);
+  numDeadlineMisses_.store(0);
+  maxBlockTicks_.store(0);
+  maxNoteLatencyTicks_.store(0);
+  activeVoices_.store(0);
+  peakVoices_.store(0);
+  numNotes_.store(0);
+  numSteals_.store(0);
+  numCulls_.store(0);
+  eventTicks_.store(0);
+  voiceTicks_.store(0);
+  otherTicks_.store(0);
+}
+
+void sfzero::Telemetry::Histogram::add(double micros)
+{
+  // Bucket n holds times up to 2^((n + 1) / bucketsPerOctave) - 1.
+  int bucket = static_cast<int>(std::log2(juce::jmax(0.0, micros) + 1.0) * bucketsPerOctave);
+  increment(buckets[juce::jlimit(0, static_cast<int>(numBuckets) - 1, bucket)]);
+}
+
+double sfzero::Telemetry::Histogram::percentile(double fraction) const
+{
+  juce::uint32 counts[numBuckets];
+  juce::uint64 total = 0;
+  for (int i = 0; i < numBuckets; ++i)
+  {
+    counts[i] = buckets[i].load(std::memory_order_relaxed);
+    total += counts[i];
+  }
+  if (total == 0)
+  {
+    return 0.0;
+  }
+
+  juce::uint64 wanted = static_cast<juce::uint64>(std::ceil(fraction * total));
+  juce::uint64 seen = 0;
+  int bucket = 0;
+  for (; bucket < numBuckets - 1; ++bucket)
+  {
+    seen += counts[bucket];
+    if (seen >= wanted)
+    {
+      break;
+    }
+  }
+  return std::exp2(static_cast<double>(bucket + 1) / bucketsPerOctave) - 1.0;
+}
+
+void sfzero::Telemetry::Histogram::clear()
+{
+  for (auto &bucket : buckets)
+  {
+    bucket.store(0);
+  }
+}
@@ -0,0 +1,98 @@
+/*************************************************************************************
+ * Original code copyright (C) 2012 Steve Folta
+ * Converted to Juce module (C) 2016 Leo Olivers
+ * Forked from https://github.com/stevefolta/SFZero
+ * For license info please see the LICENSE file distributed with this source code
+ *************************************************************************************/
+#ifndef SFZTELEMETRY_H_INCLUDED
+#define SFZTELEMETRY_H_INCLUDED
+
+#include "SFZCommon.h"
+
+namespace sfzero
+{
+
+// What Telemetry has counted since it was last reset.  Times are in
+// microseconds; percentiles are the upper edge of the histogram bucket they
+// fall in, so they're within a fifth of the real value.
+struct TelemetrySnapshot
+{
+  juce::uint64 numBlocks;
+  double blockMedian, blockP99, blockMax;
+  juce::uint64 numDeadlineMisses; // Blocks that took longer than the audio they made.
+
+  int activeVoices; // In the last block.
+  int peakVoices;
+  juce::uint64 numNotes;  // Voices started.
+  juce::uint64 numSteals; // Voices taken from a playing note.
+  juce::uint64 numCulls;  // Voices cut short by an off_by group or a retriggered note.
+
+  // From a voice starting until its first samples have been rendered.
+  double noteLatencyMedian, noteLatencyMax;
+
+  // Mean per block, by stage: MIDI handling (the keyboard state and the
+  // synth's note and controller events), rendering and mixing the voices
+  // (they add themselves into the output), and everything else.
+  double eventMicros, voiceMicros, otherMicros;
+};
+
+// Performance counters for a Synth and the processor driving it.  The audio
+// thread writes them with relaxed atomic stores and no locks; any other
+// thread can take a snapshot at any time without holding it up.  Each value
+// is consistent on its own, but a snapshot can straddle a block.
+class Telemetry
+{
+public:
+  Telemetry();
+
+  // Audio thread.  "ticks" are juce::Time high resolution ticks.
+  // Returns true if the block missed its deadline.
+  bool addBlock(int numSamples, double sampleRate, juce::int64 ticks, juce::int64 synthTicks, int activeVoices);
+  void addVoiceTicks(juce::int64 ticks) { blockVoiceTicks_ += ticks; }
+  void addNoteLatency(juce::int64 ticks);
+  void noteStarted(bool stolen);
+  void voiceCulled() { increment(numCulls_); }
+
+  // Any thread.
+  void getSnapshot(TelemetrySnapshot &snapshot) const;
+  // Done by the audio thread at its next block.
+  void reset() { resetRequested_.store(true); }
+
+private:
+  enum
+  {
+    bucketsPerOctave = 4,
+    numBuckets = 24 * bucketsPerOctave // Up to 16 seconds.
+  };
+
+  // Counts of times, in buckets a quarter octave wide.
+  struct Histogram
+  {
+    std::atomic<juce::uint32> buckets[numBuckets];
+
+    void add(double micros);
+    double percentile(double fraction) const;
+    void clear();
+  };
+
+  Histogram blockTimes_, noteLatencies_;
+  std::atomic<juce::uint64> numBlocks_, numDeadlineMisses_;
+  std::atomic<juce::int64> maxBlockTicks_, maxNoteLatencyTicks_;
+  std::atomic<int> activeVoices_, peakVoices_;
+  std::atomic<juce::uint64> numNotes_, numSteals_, numCulls_;
+  std::atomic<juce::int64> eventTicks_, voiceTicks_, otherTicks_;
+  std::atomic<bool> resetRequested_;
+  juce::int64 blockVoiceTicks_; // Audio thread only.
+
+  template <typename Type>
+  static void increment(std::atomic<Type> &counter, Type amount = 1)
+  {
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+  }
+  void clear();
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Telemetry)
+};
+}
+
+#endif // SFZTELEMETRY_H_INCLUDED
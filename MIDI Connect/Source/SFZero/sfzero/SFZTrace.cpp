@@ -0,0 +1,267 @@
+/*************************************************************************************
+ * Original code copyright (C) 2012 Steve Folta
+ * Converted to Juce module (C) 2016 Leo Olivers
+ * Forked from https://github.com/stevefolta/SFZero
+ * For license info please see the LICENSE file distributed with this source code
+ *************************************************************************************/
+#include "SFZTrace.h"
+
+namespace
+{
+// Lanes ("threads" to the trace viewer).
+enum
+{
+  blockLane = 1,
+  loadLane = 2,
+  firstVoiceLane = 1000
+};
+
+const char *egSegmentNames[] = {"delay", "attack", "hold", "decay", "sustain", "release", "done"};
+
+juce::DynamicObject::Ptr makeTraceEvent(const char *name, const char *phase, double micros, int lane)
+{
+  juce::DynamicObject::Ptr event = new juce::DynamicObject();
+  event->setProperty("name", name);
+  event->setProperty("ph", phase);
+  event->setProperty("ts", micros);
+  event->setProperty("pid", 1);
+  event->setProperty("tid", lane);
+  return event;
+}
+}
+
+sfzero::Trace &sfzero::Trace::getInstance()
+{
+  static Trace trace;
+  return trace;
+}
+
+sfzero::Trace::Trace() : nextPosition_(0), enabled_(true), dumpWanted_(false), dumping_(false), lastDumpTime_(0)
+{
+  slots_.calloc(capacity);
+}
+
+sfzero::Trace::~Trace() {}
+
+void sfzero::Trace::add(EventType type, int voice, int channel, int note, int value)
+{
+  if (!enabled_.load(std::memory_order_relaxed))
+  {
+    return;
+  }
+
+  juce::uint64 position = nextPosition_.fetch_add(1, std::memory_order_relaxed);
+  Slot &slot = slots_[static_cast<int>(position & (capacity - 1))];
+  slot.sequence.store(position * 2 + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.ticks.store(juce::Time::getHighResolutionTicks(), std::memory_order_relaxed);
+  slot.fields.store(static_cast<juce::uint64>(type) | (static_cast<juce::uint64>(channel & 0xFF) << 8) |
+                        (static_cast<juce::uint64>(note & 0xFF) << 16) |
+                        (static_cast<juce::uint64>(static_cast<juce::uint32>(voice)) << 32),
+                    std::memory_order_relaxed);
+  slot.value.store(value, std::memory_order_relaxed);
+  slot.sequence.store(position * 2 + 2, std::memory_order_release);
+}
+
+void sfzero::Trace::deadlineMissed()
+{
+  add(deadlineMiss, 0, 0, 0, 0);
+  dumpWanted_.store(true);
+}
+
+void sfzero::Trace::setAutoDumpDirectory(const juce::File &directory)
+{
+  const juce::ScopedLock locker(directoryLock_);
+  autoDumpDirectory_ = directory;
+}
+
+void sfzero::Trace::getEvents(juce::Array<sfzero::Trace::Event> &events) const
+{
+  juce::uint64 end = nextPosition_.load(std::memory_order_acquire);
+  juce::uint64 start = (end > static_cast<juce::uint64>(capacity)) ? end - capacity : 0;
+  events.ensureStorageAllocated(static_cast<int>(end - start));
+  for (juce::uint64 position = start; position < end; ++position)
+  {
+    // Skipped if it's still being written, or has been overwritten since.
+    const Slot &slot = slots_[static_cast<int>(position & (capacity - 1))];
+    if (slot.sequence.load(std::memory_order_acquire) != position * 2 + 2)
+    {
+      continue;
+    }
+    juce::int64 ticks = slot.ticks.load(std::memory_order_relaxed);
+    juce::uint64 fields = slot.fields.load(std::memory_order_relaxed);
+    juce::int64 value = slot.value.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) != position * 2 + 2)
+    {
+      continue;
+    }
+
+    Event event = {ticks,
+                   static_cast<EventType>(fields & 0xFF),
+                   static_cast<int>(fields >> 32),
+                   static_cast<int>((fields >> 8) & 0xFF),
+                   static_cast<int>((fields >> 16) & 0xFF),
+                   static_cast<int>(value)};
+    if (event.type < numEventTypes)
+    {
+      events.add(event);
+    }
+  }
+
+  // Threads can finish writing out of order.
+  std::stable_sort(events.begin(), events.end(), [](const Event &a, const Event &b) { return a.ticks < b.ticks; });
+}
+
+juce::var sfzero::Trace::toChromeJSON() const
+{
+  juce::Array<Event> events;
+  getEvents(events);
+
+  juce::Array<juce::var> traceEvents;
+  juce::HashMap<int, int> openSpans; // By lane.
+  juce::Array<int> lanes;
+  juce::int64 firstTicks = events.isEmpty() ? 0 : events.getReference(0).ticks;
+  for (auto &event : events)
+  {
+    double micros = juce::Time::highResolutionTicksToSeconds(event.ticks - firstTicks) * 1000000.0;
+    int lane = (event.voice != 0) ? firstVoiceLane + event.voice : blockLane;
+    const char *name = "";
+    const char *phase = "i";
+    switch (event.type)
+    {
+    case blockBegin:
+    case blockEnd:
+      name = "processBlock";
+      phase = (event.type == blockBegin) ? "B" : "E";
+      break;
+    case deadlineMiss:
+      name = "deadline miss";
+      break;
+    case noteOn:
+      name = "note on";
+      break;
+    case noteOff:
+      name = "note off";
+      break;
+    case voiceStart:
+    case voiceKill:
+      name = "note";
+      phase = (event.type == voiceStart) ? "B" : "E";
+      break;
+    case voiceSteal:
+      name = "steal";
+      break;
+    case egSegment:
+      name = juce::isPositiveAndBelow(event.value, 7) ? egSegmentNames[event.value] : "eg";
+      break;
+    case loadBegin:
+    case loadEnd:
+      lane = loadLane;
+      name = (event.value == parsing) ? "parse" : "load samples";
+      phase = (event.type == loadBegin) ? "B" : "E";
+      break;
+    default:
+      continue;
+    }
+
+    // A span whose beginning has already been overwritten is left out.
+    if (*phase == 'E')
+    {
+      if (openSpans[lane] == 0)
+      {
+        continue;
+      }
+      openSpans.set(lane, openSpans[lane] - 1);
+    }
+    else if (*phase == 'B')
+    {
+      openSpans.set(lane, openSpans[lane] + 1);
+    }
+
+    juce::DynamicObject::Ptr traceEvent = makeTraceEvent(name, phase, micros, lane);
+    juce::DynamicObject::Ptr arguments = new juce::DynamicObject();
+    switch (event.type)
+    {
+    case blockBegin:
+      arguments->setProperty("samples", event.value);
+      break;
+    case noteOn:
+    case noteOff:
+      arguments->setProperty("channel", event.channel);
+      arguments->setProperty("note", event.note);
+      arguments->setProperty("velocity", event.value);
+      break;
+    case voiceStart:
+    case voiceSteal:
+      arguments->setProperty("channel", event.channel);
+      arguments->setProperty("note", event.note);
+      break;
+    default:
+      break;
+    }
+    traceEvent->setProperty("args", juce::var(arguments.get()));
+    if (*phase == 'i')
+    {
+      traceEvent->setProperty("s", (event.type == deadlineMiss) ? "g" : "t");
+    }
+    traceEvents.add(juce::var(traceEvent.get()));
+    lanes.addIfNotAlreadyThere(lane);
+  }
+
+  // Name the lanes.
+  for (int lane : lanes)
+  {
+    juce::DynamicObject::Ptr metadata = makeTraceEvent("thread_name", "M", 0.0, lane);
+    juce::DynamicObject::Ptr arguments = new juce::DynamicObject();
+    if (lane == blockLane)
+    {
+      arguments->setProperty("name", "audio");
+    }
+    else if (lane == loadLane)
+    {
+      arguments->setProperty("name", "loading");
+    }
+    else
+    {
+      arguments->setProperty("name", "voice " + juce::String(lane - firstVoiceLane));
+    }
+    metadata->setProperty("args", juce::var(arguments.get()));
+    traceEvents.add(juce::var(metadata.get()));
+  }
+
+  juce::DynamicObject::Ptr trace = new juce::DynamicObject();
+  trace->setProperty("traceEvents", traceEvents);
+  trace->setProperty("displayTimeUnit", "ms");
+  return juce::var(trace.get());
+}
+
+bool sfzero::Trace::writeChromeJSON(const juce::File &destination) const
+{
+  return destination.replaceWithText(juce::JSON::toString(toChromeJSON(), true));
+}
+
+int sfzero::Trace::useTimeSlice()
+{
+  if (!dumpWanted_.exchange(false) || dumping_.exchange(true))
+  {
+    return 100;
+  }
+
+  // Misses come in runs; only the first of each is written out.
+  juce::File directory;
+  {
+    const juce::ScopedLock locker(directoryLock_);
+    directory = autoDumpDirectory_;
+  }
+  juce::uint32 now = juce::Time::getMillisecondCounter();
+  if ((directory != juce::File()) && ((lastDumpTime_ == 0) || (now - lastDumpTime_ >= 10000)))
+  {
+    lastDumpTime_ = now;
+    directory.createDirectory();
+    writeChromeJSON(directory.getNonexistentChildFile(
+        "sfzero-trace-" + juce::Time::getCurrentTime().formatted("%Y%m%d-%H%M%S"), ".json", false));
+  }
+  dumping_.store(false);
+  return 100;
+}
@@ -0,0 +1,112 @@
+/*************************************************************************************
+ * Original code copyright (C) 2012 Steve Folta
+ * Converted to Juce module (C) 2016 Leo Olivers
+ * Forked from https://github.com/stevefolta/SFZero
+ * For license info please see the LICENSE file distributed with this source code
+ *************************************************************************************/
+#ifndef SFZTRACE_H_INCLUDED
+#define SFZTRACE_H_INCLUDED
+
+#include "SFZCommon.h"
+
+namespace sfzero
+{
+
+// A record of what the synth has just been doing, for working out what went
+// wrong when the audio thread misses a deadline.  Events are timestamped and
+// written into a ring buffer, overwriting the oldest, with a few relaxed
+// atomic stores and no locks, so it can stay on in production.  Any thread
+// can add events; all the processors in the application share the one
+// buffer.
+//
+// The buffer can be written out in the Chrome trace event format, which
+// chrome://tracing and Perfetto open: blocks and loads are spans on lanes of
+// their own, each voice's notes are spans on the voice's lane, and the rest
+// are instants.  Given a directory, it's written there automatically
+// (at most every ten seconds) when a block misses its deadline.
+//
+// Runs as a TimeSliceClient for that, on the DiagnosticsThread.
+class Trace : public juce::TimeSliceClient
+{
+public:
+  enum EventType
+  {
+    blockBegin,   // "value" is the number of samples.
+    blockEnd,
+    deadlineMiss,
+    noteOn,       // "value" is the velocity.
+    noteOff,
+    voiceStart,
+    voiceSteal,   // "note" is the one that was playing.
+    voiceKill,
+    egSegment,    // "value" is the EG's new segment.
+    loadBegin,    // "value" is a LoadStage.
+    loadEnd,
+    numEventTypes
+  };
+
+  enum LoadStage
+  {
+    parsing,
+    loadingSamples
+  };
+
+  static Trace &getInstance();
+
+  // Voices are numbered by the voices themselves; zero for other events.
+  void add(EventType type, int voice, int channel, int note, int value);
+  // Adds a deadlineMiss and asks for the buffer to be written out.
+  void deadlineMissed();
+
+  void setEnabled(bool shouldBeEnabled) { enabled_.store(shouldBeEnabled); }
+  bool isEnabled() const { return enabled_.load(); }
+  void setAutoDumpDirectory(const juce::File &directory); // juce::File() turns it off.
+
+  // What's in the buffer, oldest first.
+  juce::var toChromeJSON() const;
+  bool writeChromeJSON(const juce::File &destination) const;
+
+  int useTimeSlice() override;
+
+private:
+  Trace();
+  ~Trace();
+
+  enum
+  {
+    capacity = 1 << 15 // Events, a power of two.
+  };
+
+  // The event is packed into "fields"; "sequence" is twice its position in
+  // the stream while it's being written and twice plus two once it's done,
+  // so a reader can tell a torn or overwritten slot.
+  struct Slot
+  {
+    std::atomic<juce::uint64> sequence;
+    std::atomic<juce::int64> ticks;
+    std::atomic<juce::uint64> fields;
+    std::atomic<juce::int64> value;
+  };
+
+  struct Event
+  {
+    juce::int64 ticks;
+    EventType type;
+    int voice, channel, note, value;
+  };
+
+  void getEvents(juce::Array<Event> &events) const;
+
+  juce::HeapBlock<Slot> slots_;
+  std::atomic<juce::uint64> nextPosition_;
+  std::atomic<bool> enabled_;
+  std::atomic<bool> dumpWanted_, dumping_;
+  juce::File autoDumpDirectory_;
+  juce::CriticalSection directoryLock_;
+  juce::uint32 lastDumpTime_;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Trace)
+};
+}
+
+#endif // SFZTRACE_H_INCLUDED
@@ -4,24 +4,51 @@
  * Forked from https://github.com/stevefolta/SFZero
  * For license info please see the LICENSE file distributed with this source code
  *************************************************************************************/
-#include "SFZDebug.h"
+#include "SFZCompressedSample.h"
+#include "SFZPortableMath.h"
 #include "SFZRegion.h"
 #include "SFZSample.h"
 #include "SFZSound.h"
+#include "SFZTrace.h"
 #include "SFZVoice.h"
 #include <math.h>
 
 static const float globalGain = -1.0;
 
+// For notes started without a channel state.
+static const sfzero::ChannelState defaultChannelState;
+
+// Trace lanes; zero is for events that aren't a voice's.
+static std::atomic<int> nextTraceId(1);
+
+// How far past the playhead compressed samples are decoded at a time, so no
+// render pays for a whole block.
+static const int decodeAheadFrames = 64;
+
 sfzero::Voice::Voice()
-    : region_(nullptr), trigger_(0), curMidiNote_(0), curPitchWheel_(0), pitchRatio_(0), noteGainLeft_(0), noteGainRight_(0),
-      sourceSamplePosition_(0), sampleEnd_(0), loopStart_(0), loopEnd_(0), numLoops_(0), curVelocity_(0)
+    : region_(nullptr), sample_(nullptr), trigger_(0), curMidiNote_(0), curPitchWheel_(0), curPolyPressure_(0),
+      channel_(&defaultChannelState), pitchRatio_(0), noteGainLeft_(0), noteGainRight_(0), sourceSamplePosition_(0),
+      fixedPointPhase_(false), phase_(0), phaseIncrement_(0), startTicks_(0), traceId_(nextTraceId.fetch_add(1)),
+      sampleEnd_(0), loopStart_(0), loopEnd_(0),
+      window_(2, sfzero::CompressedSample::blockFrames + 1), loopStartKnown_(false), loopStartLeft_(0),
+      loopStartRight_(0), numLoops_(0), curVelocity_(0)
 {
+  windowCursor_.block = -1;
+  windowCursor_.numFrames = 0;
+  loopCursor_.block = -1;
+  loopCursor_.numFrames = 0;
+  modulation_.attenuation = modulation_.pan = modulation_.pitch = 0.0f;
   ampeg_.setExponentialDecay(true);
 }
 
 sfzero::Voice::~Voice() {}
 
+void sfzero::Voice::setFixedPointPhase(bool shouldUseFixedPoint)
+{
+  fixedPointPhase_ = shouldUseFixedPoint;
+  ampeg_.setPortableMath(shouldUseFixedPoint);
+}
+
 bool sfzero::Voice::canPlaySound(juce::SynthesiserSound *sound) { return dynamic_cast<sfzero::Sound *>(sound) != nullptr; }
 
 void sfzero::Voice::startNote(int midiNoteNumber, float floatVelocity, juce::SynthesiserSound *soundIn,
@@ -41,7 +68,18 @@ void sfzero::Voice::startNote(int midiNoteNumber, float floatVelocity, juce::Syn
   {
     region_ = sound->getRegionFor(midiNoteNumber, velocity);
   }
-  if ((region_ == nullptr) || (region_->sample == nullptr) || (region_->sample->getBuffer() == nullptr))
+  if ((region_ == nullptr) || (region_->sample == nullptr))
+  {
+    killNote();
+    return;
+  }
+  if (sample_)
+  {
+    sample_->release();
+  }
+  sample_ = region_->sample;
+  sample_->acquire();
+  if (!sample_->isLoaded())
   {
     killNote();
     return;
@@ -52,30 +90,31 @@ void sfzero::Voice::startNote(int midiNoteNumber, float floatVelocity, juce::Syn
     return;
   }
 
-  // Pitch.
+  startTicks_ = juce::Time::getHighResolutionTicks();
+  sfzero::Trace::getInstance().add(sfzero::Trace::voiceStart, traceId_, 0, midiNoteNumber, velocity);
+
+  // Modulation.
   curMidiNote_ = midiNoteNumber;
   curPitchWheel_ = currentPitchWheelPosition;
+  curPolyPressure_ = 0;
+  if (channel_ == nullptr)
+  {
+    channel_ = &defaultChannelState;
+  }
+  calcModulation();
+
+  // Pitch.
   calcPitchRatio();
 
   // Gain.
-  double noteGainDB = globalGain + region_->volume;
-  // Thanks to <http:://www.drealm.info/sfz/plj-sfz.xhtml> for explaining the
-  // velocity curve in a way that I could understand, although they mean
-  // "log10" when they say "log".
-  double velocityGainDB = -20.0 * log10((127.0 * 127.0) / (velocity * velocity));
-  velocityGainDB *= region_->amp_veltrack / 100.0;
-  noteGainDB += velocityGainDB;
-  noteGainLeft_ = noteGainRight_ = static_cast<float>(juce::Decibels::decibelsToGain(noteGainDB));
-  // The SFZ spec is silent about the pan curve, but a 3dB pan law seems
-  // common.  This sqrt() curve matches what Dimension LE does; Alchemy Free
-  // seems closer to sin(adjustedPan * pi/2).
-  double adjustedPan = (region_->pan + 100.0) / 200.0;
-  noteGainLeft_ *= static_cast<float>(sqrt(1.0 - adjustedPan));
-  noteGainRight_ *= static_cast<float>(sqrt(adjustedPan));
-  ampeg_.startNote(&region_->ampeg, floatVelocity, getSampleRate(), &region_->ampeg_veltrack);
+  const sfzero::RegionParameters &parameters = *region_->parameters;
+  calcNoteGain();
+  ampeg_.startNote(&parameters.ampeg, floatVelocity, getSampleRate(), &parameters.ampeg_veltrack);
+  traceSegment();
 
   // Offset/end.
   sourceSamplePosition_ = static_cast<double>(region_->offset);
+  phase_ = static_cast<juce::int64>(region_->offset) << 32;
   sampleEnd_ = region_->sample->getSampleLength();
   if ((region_->end > 0) && (region_->end < sampleEnd_))
   {
@@ -110,6 +149,10 @@ void sfzero::Voice::startNote(int midiNoteNumber, float floatVelocity, juce::Syn
     }
   }
   numLoops_ = 0;
+
+  windowCursor_.block = -1;
+  loopCursor_.block = -1;
+  loopStartKnown_ = false;
 }
 
 void sfzero::Voice::stopNote(float /*velocity*/, bool allowTailOff)
@@ -123,6 +166,7 @@ void sfzero::Voice::stopNote(float /*velocity*/, bool allowTailOff)
   if (region_->loop_mode != sfzero::Region::one_shot)
   {
     ampeg_.noteOff();
+    traceSegment();
   }
   if (region_->loop_mode == sfzero::Region::loop_sustain)
   {
@@ -133,7 +177,7 @@ void sfzero::Voice::stopNote(float /*velocity*/, bool allowTailOff)
 
 void sfzero::Voice::stopNoteForGroup()
 {
-  if (region_->off_mode == sfzero::Region::fast)
+  if (region_->parameters->off_mode == sfzero::Region::fast)
   {
     ampeg_.fastRelease();
   }
@@ -141,9 +185,15 @@ void sfzero::Voice::stopNoteForGroup()
   {
     ampeg_.noteOff();
   }
+  traceSegment();
+}
+
+void sfzero::Voice::stopNoteQuick()
+{
+  ampeg_.fastRelease();
+  traceSegment();
 }
 
-void sfzero::Voice::stopNoteQuick() { ampeg_.fastRelease(); }
 void sfzero::Voice::pitchWheelMoved(int newValue)
 {
   if (region_ == nullptr)
@@ -152,10 +202,28 @@ void sfzero::Voice::pitchWheelMoved(int newValue)
   }
 
   curPitchWheel_ = newValue;
-  calcPitchRatio();
+  if (region_->parameters->modulation)
+  {
+    modulationSourceChanged();
+  }
+  else
+  {
+    calcPitchRatio();
+  }
 }
 
-void sfzero::Voice::controllerMoved(int /*controllerNumber*/, int /*newValue*/) { /***/}
+// The synth records controllers and channel pressure in the channel state
+// before passing them on.
+void sfzero::Voice::controllerMoved(int /*controllerNumber*/, int /*newValue*/) { modulationSourceChanged(); }
+
+void sfzero::Voice::aftertouchChanged(int newAftertouchValue)
+{
+  curPolyPressure_ = newAftertouchValue;
+  modulationSourceChanged();
+}
+
+void sfzero::Voice::channelPressureChanged(int /*newChannelPressureValue*/) { modulationSourceChanged(); }
+
 void sfzero::Voice::renderNextBlock(juce::AudioSampleBuffer &outputBuffer, int startSample, int numSamples)
 {
   if (region_ == nullptr)
@@ -163,18 +231,40 @@ void sfzero::Voice::renderNextBlock(juce::AudioSampleBuffer &outputBuffer, int s
     return;
   }
 
-  juce::AudioSampleBuffer *buffer = region_->sample->getBuffer();
-  const float *inL = buffer->getReadPointer(0, 0);
-  const float *inR = buffer->getNumChannels() > 1 ? buffer->getReadPointer(1, 0) : nullptr;
+  // The sample is read from inL/inR, indexed from windowStart.  That's the
+  // whole buffer, or for a compressed sample the block around the playhead,
+  // which covers frames windowStart to windowEnd inclusive once decoded.
+  const float *inL, *inR;
+  int bufferNumSamples; // leoo
+  int windowStart = 0, windowEnd;
+  sfzero::CompressedSample *compressed = sample_->getCompressed();
+  if (compressed)
+  {
+    inL = window_.getReadPointer(0);
+    inR = compressed->getNumChannels() > 1 ? window_.getReadPointer(1) : nullptr;
+    bufferNumSamples = compressed->getNumFrames();
+    windowStart = windowCursor_.block * sfzero::CompressedSample::blockFrames;
+    windowEnd = (windowCursor_.block < 0)
+                    ? windowStart
+                    : juce::jmin(windowStart + sfzero::CompressedSample::blockFrames, bufferNumSamples);
+  }
+  else
+  {
+    juce::AudioSampleBuffer *buffer = sample_->getBuffer();
+    inL = buffer->getReadPointer(0, 0);
+    inR = buffer->getNumChannels() > 1 ? buffer->getReadPointer(1, 0) : nullptr;
+    bufferNumSamples = buffer->getNumSamples();
+    windowEnd = bufferNumSamples;
+  }
 
   float *outL = outputBuffer.getWritePointer(0, startSample);
   float *outR = outputBuffer.getNumChannels() > 1 ? outputBuffer.getWritePointer(1, startSample) : nullptr;
 
-  int bufferNumSamples = buffer->getNumSamples(); // leoo
-
   // Cache some values, to give them at least some chance of ending up in
   // registers.
   double sourceSamplePosition = this->sourceSamplePosition_;
+  juce::int64 phase = this->phase_;
+  const bool fixedPoint = fixedPointPhase_;
   float ampegGain = ampeg_.getLevel();
   float ampegSlope = ampeg_.getSlope();
   int samplesUntilNextAmpSegment = ampeg_.getSamplesUntilNextSegment();
@@ -182,12 +272,49 @@ void sfzero::Voice::renderNextBlock(juce::AudioSampleBuffer &outputBuffer, int s
   float loopStart = static_cast<float>(this->loopStart_);
   float loopEnd = static_cast<float>(this->loopEnd_);
   float sampleEnd = static_cast<float>(this->sampleEnd_);
+  if (sampleEnd > bufferNumSamples - 4)
+  {
+    // Only the head of the sample is loaded; stop at its end if it isn't back
+    // in time.
+    sampleEnd = static_cast<float>(bufferNumSamples - 4);
+  }
+  const juce::int64 loopStartPhase = this->loopStart_ << 32;
+  const juce::int64 loopEndPhase = this->loopEnd_ << 32;
+  const juce::int64 sampleEndPhase = static_cast<juce::int64>(sampleEnd) << 32;
 
   while (--numSamples >= 0)
   {
-    int pos = static_cast<int>(sourceSamplePosition);
+    int pos = fixedPoint ? static_cast<int>(phase >> 32) : static_cast<int>(sourceSamplePosition);
     jassert(pos >= 0 && pos < bufferNumSamples); // leoo
-    float alpha = static_cast<float>(sourceSamplePosition - pos);
+    if (compressed)
+    {
+      if ((pos < windowStart) || (pos >= windowEnd))
+      {
+        // Start on the block the playhead has moved into.
+        int block = pos / sfzero::CompressedSample::blockFrames;
+        if (block >= compressed->getNumBlocks())
+        {
+          killNote();
+          break;
+        }
+        if ((block == loopCursor_.block) && (pos >= loopStart_))
+        {
+          windowCursor_ = loopCursor_;
+        }
+        else
+        {
+          compressed->startBlock(block, windowCursor_);
+        }
+        windowStart = block * sfzero::CompressedSample::blockFrames;
+        windowEnd = juce::jmin(windowStart + sfzero::CompressedSample::blockFrames, bufferNumSamples);
+      }
+      if (pos + 1 - windowStart >= windowCursor_.numFrames)
+      {
+        decodeWindow(compressed, pos + 2 - windowStart + decodeAheadFrames);
+      }
+    }
+    float alpha = fixedPoint ? static_cast<float>(static_cast<juce::uint32>(phase)) * (1.0f / 4294967296.0f)
+                             : static_cast<float>(sourceSamplePosition - pos);
     float invAlpha = 1.0f - alpha;
     int nextPos = pos + 1;
     if ((loopStart < loopEnd) && (nextPos > loopEnd))
@@ -196,10 +323,33 @@ void sfzero::Voice::renderNextBlock(juce::AudioSampleBuffer &outputBuffer, int s
     }
 
     // Simple linear interpolation with buffer overrun check
-    float nextL = nextPos < bufferNumSamples ? inL[nextPos] : inL[pos];
-    float nextR = inR ? (nextPos < bufferNumSamples ? inR[nextPos] : inR[pos]) : nextL;
-    float l = (inL[pos] * invAlpha + nextL * alpha);
-    float r = inR ? (inR[pos] * invAlpha + nextR * alpha) : l;
+    float curL = inL[pos - windowStart];
+    float curR = inR ? inR[pos - windowStart] : curL;
+    float nextL, nextR;
+    if (nextPos >= bufferNumSamples)
+    {
+      nextL = curL;
+      nextR = curR;
+    }
+    else if (nextPos == pos + 1)
+    {
+      nextL = inL[nextPos - windowStart];
+      nextR = inR ? inR[nextPos - windowStart] : nextL;
+    }
+    else if (compressed)
+    {
+      // A note started past the loop start hasn't seen it yet; hold the
+      // current frame across the first wrap.
+      nextL = loopStartKnown_ ? loopStartLeft_ : curL;
+      nextR = loopStartKnown_ ? loopStartRight_ : curR;
+    }
+    else
+    {
+      nextL = inL[nextPos];
+      nextR = inR ? inR[nextPos] : nextL;
+    }
+    float l = (curL * invAlpha + nextL * alpha);
+    float r = inR ? (curR * invAlpha + nextR * alpha) : l;
 
     //// Simple linear interpolation, old version (possible buffer overrun with non-loop??)
     // float l = (inL[pos] * invAlpha + inL[nextPos] * alpha);
@@ -222,11 +372,23 @@ void sfzero::Voice::renderNextBlock(juce::AudioSampleBuffer &outputBuffer, int s
     }
 
     // Next sample.
-    sourceSamplePosition += pitchRatio_;
-    if ((loopStart < loopEnd) && (sourceSamplePosition > loopEnd))
+    if (fixedPoint)
+    {
+      phase += phaseIncrement_;
+      if ((loopStartPhase < loopEndPhase) && (phase > loopEndPhase))
+      {
+        phase = loopStartPhase;
+        numLoops_ += 1;
+      }
+    }
+    else
     {
-      sourceSamplePosition = loopStart;
-      numLoops_ += 1;
+      sourceSamplePosition += pitchRatio_;
+      if ((loopStart < loopEnd) && (sourceSamplePosition > loopEnd))
+      {
+        sourceSamplePosition = loopStart;
+        numLoops_ += 1;
+      }
     }
 
     // Update EG.
@@ -242,20 +404,31 @@ void sfzero::Voice::renderNextBlock(juce::AudioSampleBuffer &outputBuffer, int s
     {
       ampeg_.setLevel(ampegGain);
       ampeg_.nextSegment();
+      traceSegment();
       ampegGain = ampeg_.getLevel();
       ampegSlope = ampeg_.getSlope();
       samplesUntilNextAmpSegment = ampeg_.getSamplesUntilNextSegment();
       ampSegmentIsExponential = ampeg_.getSegmentIsExponential();
     }
 
-    if ((sourceSamplePosition >= sampleEnd) || ampeg_.isDone())
+    if ((fixedPoint ? (phase >= sampleEndPhase) : (sourceSamplePosition >= sampleEnd)) || ampeg_.isDone())
     {
       killNote();
       break;
     }
   }
 
+  // Both are kept, so the mode can change mid-note.
+  if (fixedPoint)
+  {
+    sourceSamplePosition = static_cast<double>(phase) / 4294967296.0;
+  }
+  else
+  {
+    phase = static_cast<juce::int64>(sourceSamplePosition * 4294967296.0);
+  }
   this->sourceSamplePosition_ = sourceSamplePosition;
+  this->phase_ = phase;
   ampeg_.setLevel(ampegGain);
   ampeg_.setSamplesUntilNextSegment(samplesUntilNextAmpSegment);
 }
@@ -264,9 +437,16 @@ bool sfzero::Voice::isPlayingNoteDown() { return region_ && region_->trigger !=
 
 bool sfzero::Voice::isPlayingOneShot() { return region_ && region_->loop_mode == sfzero::Region::one_shot; }
 
-int sfzero::Voice::getGroup() { return region_ ? region_->group : 0; }
+int sfzero::Voice::getGroup() { return region_ ? region_->parameters->group : 0; }
 
-juce::uint64 sfzero::Voice::getOffBy() { return region_ ? region_->off_by : 0; }
+juce::uint64 sfzero::Voice::getOffBy() { return region_ ? region_->parameters->off_by : 0; }
+
+juce::int64 sfzero::Voice::takeStartTicks()
+{
+  juce::int64 ticks = startTicks_;
+  startTicks_ = 0;
+  return ticks;
+}
 
 void sfzero::Voice::setRegion(sfzero::Region *nextRegion) { region_ = nextRegion; }
 
@@ -284,42 +464,147 @@ juce::String sfzero::Voice::infoString()
   }
 
   juce::String info;
-  info << "note: " << curMidiNote_ << ", vel: " << curVelocity_ << ", pan: " << region_->pan << ", eg: " << egSegmentName
-       << ", loops: " << numLoops_;
+  info << "note: " << curMidiNote_ << ", vel: " << curVelocity_ << ", pan: " << region_->parameters->pan
+       << ", eg: " << egSegmentName << ", loops: " << numLoops_;
   return info;
 }
 
 void sfzero::Voice::calcPitchRatio()
 {
+  const sfzero::RegionParameters &parameters = *region_->parameters;
   double note = curMidiNote_;
 
-  note += region_->transpose;
-  note += region_->tune / 100.0;
+  note += parameters.transpose;
+  note += parameters.tune / 100.0;
 
-  double adjustedPitch = region_->pitch_keycenter + (note - region_->pitch_keycenter) * (region_->pitch_keytrack / 100.0);
+  double adjustedPitch =
+      parameters.pitch_keycenter + (note - parameters.pitch_keycenter) * (parameters.pitch_keytrack / 100.0);
+  adjustedPitch += modulation_.pitch / 100.0;
   if (curPitchWheel_ != 8192)
   {
     double wheel = ((2.0 * curPitchWheel_ / 16383.0) - 1.0);
     if (wheel > 0)
     {
-      adjustedPitch += wheel * region_->bend_up / 100.0;
+      adjustedPitch += wheel * parameters.bend_up / 100.0;
     }
     else
     {
-      adjustedPitch += wheel * region_->bend_down / -100.0;
+      adjustedPitch += wheel * parameters.bend_down / -100.0;
     }
   }
-  double targetFreq = fractionalMidiNoteInHz(adjustedPitch);
-  double naturalFreq = juce::MidiMessage::getMidiNoteInHertz(region_->pitch_keycenter);
-  pitchRatio_ = (targetFreq * region_->sample->getSampleRate()) / (naturalFreq * getSampleRate());
+  if (fixedPointPhase_)
+  {
+    double semitones = adjustedPitch - parameters.pitch_keycenter;
+    pitchRatio_ = sfzero::PortableMath::exp2(semitones / 12.0) * region_->sample->getSampleRate() / getSampleRate();
+  }
+  else
+  {
+    double targetFreq = fractionalMidiNoteInHz(adjustedPitch);
+    double naturalFreq = juce::MidiMessage::getMidiNoteInHertz(parameters.pitch_keycenter);
+    pitchRatio_ = (targetFreq * region_->sample->getSampleRate()) / (naturalFreq * getSampleRate());
+  }
+  phaseIncrement_ = static_cast<juce::int64>(std::llround(pitchRatio_ * 4294967296.0));
+}
+
+void sfzero::Voice::calcNoteGain()
+{
+  const sfzero::RegionParameters &parameters = *region_->parameters;
+  double noteGainDB = globalGain + parameters.volume - modulation_.attenuation / 10.0;
+  // Thanks to <http:://www.drealm.info/sfz/plj-sfz.xhtml> for explaining the
+  // velocity curve in a way that I could understand, although they mean
+  // "log10" when they say "log".
+  const bool portableMath = fixedPointPhase_;
+  double velocityRatio = (127.0 * 127.0) / (curVelocity_ * curVelocity_);
+  double velocityGainDB = -20.0 * (portableMath ? sfzero::PortableMath::log10(velocityRatio) : log10(velocityRatio));
+  velocityGainDB *= parameters.amp_veltrack / 100.0;
+  noteGainDB += velocityGainDB;
+  noteGainLeft_ = noteGainRight_ = static_cast<float>(
+      portableMath ? sfzero::PortableMath::decibelsToGain(noteGainDB) : juce::Decibels::decibelsToGain(noteGainDB));
+  // The SFZ spec is silent about the pan curve, but a 3dB pan law seems
+  // common.  This sqrt() curve matches what Dimension LE does; Alchemy Free
+  // seems closer to sin(adjustedPan * pi/2).  Pan modulation is in the SF2
+  // generator's units.  (sqrt() is correctly rounded everywhere, so it's as
+  // portable as PortableMath.)
+  double pan = juce::jlimit(-100.0, 100.0, parameters.pan + modulation_.pan * (2.0 / 10.0));
+  double adjustedPan = (pan + 100.0) / 200.0;
+  noteGainLeft_ *= static_cast<float>(sqrt(1.0 - adjustedPan));
+  noteGainRight_ *= static_cast<float>(sqrt(adjustedPan));
+}
+
+void sfzero::Voice::calcModulation()
+{
+  const sfzero::ModulationProgram *program = region_->parameters->modulation;
+  if (program == nullptr)
+  {
+    modulation_.attenuation = modulation_.pan = modulation_.pitch = 0.0f;
+    return;
+  }
+
+  sfzero::ModulationSources sources;
+  sources.velocity = curVelocity_;
+  sources.key = curMidiNote_;
+  sources.pitchWheel = curPitchWheel_;
+  sources.polyPressure = curPolyPressure_;
+  sources.channel = channel_;
+  sources.portableMath = fixedPointPhase_;
+  program->evaluate(sources, modulation_);
+}
+
+void sfzero::Voice::modulationSourceChanged()
+{
+  // Modulation is only evaluated here and at the start of the note, so it
+  // costs nothing per sample.
+  if ((region_ == nullptr) || (region_->parameters->modulation == nullptr))
+  {
+    return;
+  }
+  calcModulation();
+  calcNoteGain();
+  calcPitchRatio();
 }
 
 void sfzero::Voice::killNote()
 {
+  if (region_)
+  {
+    sfzero::Trace::getInstance().add(sfzero::Trace::voiceKill, traceId_, 0, curMidiNote_, 0);
+  }
+  if (sample_)
+  {
+    sample_->release();
+    sample_ = nullptr;
+  }
   region_ = nullptr;
   clearCurrentNote();
 }
 
+void sfzero::Voice::traceSegment()
+{
+  sfzero::Trace::getInstance().add(sfzero::Trace::egSegment, traceId_, 0, curMidiNote_, ampeg_.segmentIndex());
+}
+
+void sfzero::Voice::decodeWindow(sfzero::CompressedSample *compressed, int endFrame)
+{
+  float *dest[2] = {window_.getWritePointer(0), window_.getWritePointer(1)};
+  bool looping = (loopStart_ < loopEnd_);
+  juce::int64 blockStart = static_cast<juce::int64>(windowCursor_.block) * sfzero::CompressedSample::blockFrames;
+  juce::int64 index = loopStart_ - blockStart; // Of the loop start, in the block.
+  if (looping && (loopCursor_.block < 0) && (index >= windowCursor_.numFrames) && (index < endFrame))
+  {
+    compressed->decode(windowCursor_, static_cast<int>(index), dest, 2);
+    loopCursor_ = windowCursor_;
+  }
+  compressed->decode(windowCursor_, endFrame, dest, 2);
+
+  if (looping && !loopStartKnown_ && (index >= 0) && (index < windowCursor_.numFrames))
+  {
+    loopStartLeft_ = window_.getSample(0, static_cast<int>(index));
+    loopStartRight_ =
+        (compressed->getNumChannels() > 1) ? window_.getSample(1, static_cast<int>(index)) : loopStartLeft_;
+    loopStartKnown_ = true;
+  }
+}
+
 double sfzero::Voice::fractionalMidiNoteInHz(double note, double freqOfA)
 {
   // Like MidiMessage::getMidiNoteInHertz(), but with a float note.
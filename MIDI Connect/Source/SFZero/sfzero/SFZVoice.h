@@ -7,11 +7,14 @@
 #ifndef SFZVOICE_H_INCLUDED
 #define SFZVOICE_H_INCLUDED
 
+#include "SFZCompressedSample.h"
 #include "SFZEG.h"
+#include "SFZModulation.h"
 
 namespace sfzero
 {
 struct Region;
+class Sample;
 
 class Voice : public juce::SynthesiserVoice
 {
@@ -26,6 +29,8 @@ public:
   void stopNoteQuick();
   void pitchWheelMoved(int newValue) override;
   void controllerMoved(int controllerNumber, int newValue) override;
+  void aftertouchChanged(int newAftertouchValue) override;
+  void channelPressureChanged(int newChannelPressureValue) override;
   void renderNextBlock(juce::AudioSampleBuffer &outputBuffer, int startSample, int numSamples) override;
   bool isPlayingNoteDown();
   bool isPlayingOneShot();
@@ -35,26 +40,63 @@ public:
 
   // Set the region to be used by the next startNote().
   void setRegion(Region *nextRegion);
+  // Set the state of the channel the next startNote() is on, for SF2
+  // modulators.  It must outlive the note.
+  void setChannelState(const ChannelState *channel) { channel_ = channel; }
+  // When the current note was started, until the first render after that.
+  juce::int64 takeStartTicks();
+  // Advance through the sample with a 32.32 fixed-point phase rather than a
+  // double, so the position never drifts with rounding, and work out each
+  // note's pitch, gain, envelope and modulator curves with PortableMath rather
+  // than libm.  The output then depends only on the input, provided the
+  // compiler doesn't fuse multiply-adds (SFZero Render builds with
+  // -ffp-contract=off).  The phase takes effect from the next block, the maths
+  // from the next note or envelope segment.
+  void setFixedPointPhase(bool shouldUseFixedPoint);
+  // Numbers the voice's lane in a Trace.
+  int getTraceId() const { return traceId_; }
 
   juce::String infoString();
 
 private:
   Region *region_;
+  Sample *sample_; // Acquired while the note plays.
   int trigger_;
   int curMidiNote_, curPitchWheel_;
+  int curPolyPressure_;
+  const ChannelState *channel_;
+  ModulationValues modulation_;
   double pitchRatio_;
   float noteGainLeft_, noteGainRight_;
   double sourceSamplePosition_;
+  bool fixedPointPhase_;
+  juce::int64 phase_, phaseIncrement_; // Frames, in 32.32 fixed point.
   EG ampeg_;
+  juce::int64 startTicks_;
+  int traceId_;
   juce::int64 sampleEnd_;
   juce::int64 loopStart_, loopEnd_;
+  // For compressed samples: the block around the playhead, decoded a little
+  // ahead of it on each render, and the frame at the loop start, for
+  // interpolating across the loop point, caught as the playhead passes it.
+  // So a wrap needn't decode the loop start's block from its beginning again,
+  // the cursor is also kept as it was on reaching the loop start.
+  juce::AudioSampleBuffer window_;
+  CompressedSample::Cursor windowCursor_, loopCursor_;
+  bool loopStartKnown_;
+  float loopStartLeft_, loopStartRight_;
 
   // Info only.
   int numLoops_;
-  int curVelocity_;
+  int curVelocity_; // Also read by the gain and modulators.
 
   void calcPitchRatio();
+  void calcNoteGain();
+  void calcModulation();
+  void modulationSourceChanged();
   void killNote();
+  void traceSegment();
+  void decodeWindow(CompressedSample *compressed, int endFrame);
   double fractionalMidiNoteInHz(double note, double freqOfA = 440.0);
 
   JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Voice)
@@ -1,6 +1,10 @@
 #include "SFZeroAudioProcessor.h"
 
-sfzero::SFZeroAudioProcessor::SFZeroAudioProcessor() : loadProgress(0.0), loadThread(this)
+sfzero::SFZeroAudioProcessor::SFZeroAudioProcessor()
+    : loadProgress(0.0), pendingSubsound(0), loadingPrograms(false), compressSamples(false), loadPresetsOnDemand(false),
+      cacheDecodedSamples(false), residency(formatManager), programBank(synth),
+      loadThread(this),
+      backgroundThread("SFZBackground")
 {
   formatManager.registerBasicFormats();
 
@@ -8,10 +12,28 @@ sfzero::SFZeroAudioProcessor::SFZeroAudioProcessor() : loadProgress(0.0), loadTh
   {
     synth.addVoice(new sfzero::Voice());
   }
-  
+
+  // Sounds replaced while voices were still playing them are deleted here,
+  // programs selected before they were loaded get loaded here, and samples
+  // are kept within the memory budget here.  Log messages are written, and
+  // traces of missed deadlines saved, by the shared diagnosticsThread.
+  synth.setProgramBank(&programBank);
+  synth.setTelemetry(&telemetry);
+  programBank.setResidencyManager(&residency);
+  backgroundThread.addTimeSliceClient(&synth);
+  backgroundThread.addTimeSliceClient(&programBank);
+  backgroundThread.addTimeSliceClient(&residency);
+  backgroundThread.startThread();
 }
 
-sfzero::SFZeroAudioProcessor::~SFZeroAudioProcessor() {}
+sfzero::SFZeroAudioProcessor::~SFZeroAudioProcessor()
+{
+  loadThread.stopThread(4000);
+  backgroundThread.removeTimeSliceClient(&residency);
+  backgroundThread.removeTimeSliceClient(&programBank);
+  backgroundThread.removeTimeSliceClient(&synth);
+  backgroundThread.stopThread(4000);
+}
 const juce::String sfzero::SFZeroAudioProcessor::getName() const {return "SFZero";}
 int sfzero::SFZeroAudioProcessor::getNumParameters() { return 0; }
 float sfzero::SFZeroAudioProcessor::getParameter(int /*index*/) { return 0.0f; }
@@ -21,7 +43,10 @@ const juce::String sfzero::SFZeroAudioProcessor::getParameterText(int /*index*/)
 
 void sfzero::SFZeroAudioProcessor::setSfzFile(juce::File *newSfzFile)
 {
+  loadThread.stopThread(2000);
   sfzFile = *newSfzFile;
+  pendingSubsound = 0;
+  loadingPrograms = false;
   loadSound();
 }
 
@@ -29,6 +54,60 @@ void sfzero::SFZeroAudioProcessor::setSfzFileThreaded(juce::File *newSfzFile)
 {
   loadThread.stopThread(2000);
   sfzFile = *newSfzFile;
+  pendingSubsound = 0;
+  loadingPrograms = false;
+  loadThread.startThread();
+}
+
+void sfzero::SFZeroAudioProcessor::clearPrograms()
+{
+  loadThread.stopThread(2000);
+  programBank.clear();
+}
+
+void sfzero::SFZeroAudioProcessor::addProgram(const juce::File &file, int subsound)
+{
+  loadThread.stopThread(2000);
+  programBank.addProgram(file, subsound);
+}
+
+void sfzero::SFZeroAudioProcessor::setCompressSamples(bool shouldCompress)
+{
+  compressSamples = shouldCompress;
+  programBank.setCompressSamples(shouldCompress);
+}
+
+void sfzero::SFZeroAudioProcessor::setLoadPresetsOnDemand(bool shouldLoadOnDemand)
+{
+  loadPresetsOnDemand = shouldLoadOnDemand;
+  programBank.setLoadPresetsOnDemand(shouldLoadOnDemand);
+}
+
+void sfzero::SFZeroAudioProcessor::setCacheDecodedSamples(bool shouldCache)
+{
+  cacheDecodedSamples = shouldCache;
+  sfzero::DecodeCache::getInstance().setDirectory(
+      shouldCache ? juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+                        .getChildFile("SFZero")
+                        .getChildFile("Decoded Samples")
+                  : juce::File());
+}
+
+void sfzero::SFZeroAudioProcessor::setSaveTracesOnDeadlineMiss(bool shouldSave)
+{
+  sfzero::Trace::getInstance().setAutoDumpDirectory(
+      shouldSave ? juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+                       .getChildFile("SFZero")
+                       .getChildFile("Traces")
+                 : juce::File());
+}
+
+void sfzero::SFZeroAudioProcessor::setProgramMemoryBudget(juce::int64 bytes) { programBank.setMemoryBudget(bytes); }
+
+void sfzero::SFZeroAudioProcessor::loadProgramsThreaded()
+{
+  loadThread.stopThread(2000);
+  loadingPrograms = true;
   loadThread.startThread();
 }
 
@@ -42,10 +121,10 @@ bool sfzero::SFZeroAudioProcessor::producesMidi() const
   return false;
 }
 
-int sfzero::SFZeroAudioProcessor::getNumPrograms() {return 1;}
-int sfzero::SFZeroAudioProcessor::getCurrentProgram() {return 0;}
-void sfzero::SFZeroAudioProcessor::setCurrentProgram(int /*index*/) {}
-const juce::String sfzero::SFZeroAudioProcessor::getProgramName(int /*index*/) {return "";}
+int sfzero::SFZeroAudioProcessor::getNumPrograms() {return juce::jmax(1, programBank.getNumPrograms());}
+int sfzero::SFZeroAudioProcessor::getCurrentProgram() {return programBank.getCurrentProgram();}
+void sfzero::SFZeroAudioProcessor::setCurrentProgram(int index) {programBank.selectProgram(index);}
+const juce::String sfzero::SFZeroAudioProcessor::getProgramName(int index) {return programBank.getProgramName(index);}
 void sfzero::SFZeroAudioProcessor::changeProgramName(int /*index*/, const juce::String & /*newName*/) {}
 void sfzero::SFZeroAudioProcessor::prepareToPlay(double _sampleRate_, int /*samplesPerBlock*/)
 {
@@ -62,10 +141,22 @@ void sfzero::SFZeroAudioProcessor::releaseResources()
 
 void sfzero::SFZeroAudioProcessor::processBlock(juce::AudioSampleBuffer &buffer, juce::MidiBuffer &midiMessages)
 {
+  // Records anything unsafe done from here on, in builds with SFZERO_REALTIME_CHECKS.
+  sfzero::RealtimeCheck::ScopedAudioThread audioThread;
+  juce::int64 start = juce::Time::getHighResolutionTicks();
   int numSamples = buffer.getNumSamples();
+  sfzero::Trace &trace = sfzero::Trace::getInstance();
+  trace.add(sfzero::Trace::blockBegin, 0, 0, 0, numSamples);
   keyboardState.processNextMidiBuffer(midiMessages, 0, numSamples, true);
   buffer.clear();
+  juce::int64 synthStart = juce::Time::getHighResolutionTicks();
   synth.renderNextBlock(buffer, midiMessages, 0, numSamples);
+  juce::int64 end = juce::Time::getHighResolutionTicks();
+  trace.add(sfzero::Trace::blockEnd, 0, 0, 0, 0);
+  if (telemetry.addBlock(numSamples, synth.getSampleRate(), end - start, end - synthStart, synth.numVoicesUsed()))
+  {
+    trace.deadlineMissed();
+  }
 }
 
 bool sfzero::SFZeroAudioProcessor::hasEditor() const
@@ -87,6 +178,38 @@ void sfzero::SFZeroAudioProcessor::getStateInformation(juce::MemoryBlock &destDa
       obj->setProperty("subsound", subsound);
   }
 
+  int numPrograms = programBank.getNumPrograms();
+  if (numPrograms > 0)
+  {
+    juce::Array<juce::var> programs;
+    for (int i = 0; i < numPrograms; ++i)
+    {
+      auto program = new juce::DynamicObject();
+      program->setProperty("path", programBank.getProgramFile(i).getFullPathName());
+      program->setProperty("subsound", programBank.getProgramSubsound(i));
+      programs.add(juce::var(program));
+    }
+    obj->setProperty("programs", programs);
+    obj->setProperty("program", programBank.getCurrentProgram());
+    obj->setProperty("programMemoryBudget", programBank.getMemoryBudget());
+  }
+  if (residency.getMemoryBudget() > 0)
+  {
+    obj->setProperty("sampleMemoryBudget", residency.getMemoryBudget());
+  }
+  if (compressSamples)
+  {
+    obj->setProperty("compressSamples", true);
+  }
+  if (loadPresetsOnDemand)
+  {
+    obj->setProperty("loadPresetsOnDemand", true);
+  }
+  if (cacheDecodedSamples)
+  {
+    obj->setProperty("cacheDecodedSamples", true);
+  }
+
   juce::MemoryOutputStream out(destData, false);
   juce::JSON::writeToStream(out, juce::var(obj));
 }
@@ -95,31 +218,54 @@ void sfzero::SFZeroAudioProcessor::setStateInformation(const void *data, int siz
 {
   juce::MemoryInputStream in(data, sizeInBytes, false);
   juce::var state = juce::JSON::parse(in);
+
+  juce::var sampleBudgetVar = state["sampleMemoryBudget"];
+  residency.setMemoryBudget((sampleBudgetVar.isInt() || sampleBudgetVar.isInt64()) ? juce::int64(sampleBudgetVar) : 0);
+  setCompressSamples(state["compressSamples"]);
+  setLoadPresetsOnDemand(state["loadPresetsOnDemand"]);
+  setCacheDecodedSamples(state["cacheDecodedSamples"]);
+
+  juce::var programsVar = state["programs"];
+  if (programsVar.isArray())
+  {
+    loadThread.stopThread(2000);
+    programBank.clear();
+    for (auto &program : *programsVar.getArray())
+    {
+      juce::var subsoundVar = program["subsound"];
+      programBank.addProgram(juce::File(program["path"].toString()), subsoundVar.isInt() ? int(subsoundVar) : 0);
+    }
+    juce::var budgetVar = state["programMemoryBudget"];
+    if (budgetVar.isInt() || budgetVar.isInt64())
+    {
+      programBank.setMemoryBudget(budgetVar);
+    }
+    programBank.selectProgram(state["program"]);
+    sfzFile = juce::File(state["sfzFilePath"].toString());
+    loadingPrograms = true;
+    loadThread.startThread();
+    return;
+  }
+
   juce::var pathVar = state["sfzFilePath"];
   if (pathVar.isString())
   {
     auto sfzFilePath = pathVar.toString();
     if (!sfzFilePath.isEmpty())
     {
-      juce::File file(sfzFilePath);
-      setSfzFile(&file);
-      auto sound = getSound();
-      if (sound)
-      {
-        juce::var subsoundVar = state["subsound"];
-        if (subsoundVar.isInt())
-          sound->useSubsound(int(subsoundVar));
-      }
+      // Load on the load thread; the current sound keeps playing until the
+      // new one is ready to be swapped in.
+      loadThread.stopThread(2000);
+      sfzFile = juce::File(sfzFilePath);
+      juce::var subsoundVar = state["subsound"];
+      pendingSubsound = subsoundVar.isInt() ? int(subsoundVar) : 0;
+      loadingPrograms = false;
+      loadThread.startThread();
     }
   }
 }
 
-sfzero::Sound *sfzero::SFZeroAudioProcessor::getSound()
-{
-  juce::SynthesiserSound *sound = synth.getSound(0).get();
-
-  return dynamic_cast<sfzero::Sound *>(sound);
-}
+sfzero::Sound *sfzero::SFZeroAudioProcessor::getSound() { return synth.getCurrentSound(); }
 
 int sfzero::SFZeroAudioProcessor::numVoicesUsed() {return synth.numVoicesUsed();}
 
@@ -128,32 +274,58 @@ juce::String sfzero::SFZeroAudioProcessor::voiceInfoString() {return synth.voice
 void sfzero::SFZeroAudioProcessor::loadSound(juce::Thread *thread)
 {
   loadProgress = 0.0;
-  synth.clearSounds();
 
   if (!sfzFile.existsAsFile())
   {
+    synth.setSound(nullptr);
     return;
   }
 
-  sfzero::Sound *sound;
-  auto extension = sfzFile.getFileExtension();
-  if ((extension == ".sf2") || (extension == ".SF2"))
+  // The new sound is built entirely on this thread and only then published
+  // to the synth, so the audio thread never waits on a load.
+  sfzero::Sound::Ptr sound = sfzero::ProgramBank::createSound(sfzFile);
+  sound->copyRecentNotesFrom(getSound());
+  sound->setCompressSamples(compressSamples);
+  if (sfzero::SF2Sound *sf2Sound = dynamic_cast<sfzero::SF2Sound *>(sound.get()))
   {
-    sound = new sfzero::SF2Sound(sfzFile);
+    sf2Sound->setLoadPresetsOnDemand(loadPresetsOnDemand);
+  }
+  sound->loadRegions();
+  if (pendingSubsound != 0)
+  {
+    sound->useSubsound(pendingSubsound);
+  }
+
+  // With nothing loaded yet, install the sound straight away; loadSamples()
+  // works outwards from the notes being played.  When replacing a sound, keep
+  // the old one until the new one has the samples for the recently played
+  // notes, so a reload or program change doesn't leave a silent gap.
+  bool published = false;
+  if (getSound() == nullptr)
+  {
+    synth.setSound(sound.get());
+    published = true;
   }
   else
   {
-    sound = new sfzero::Sound(sfzFile);
+    sfzero::Sound *newSound = sound.get();
+    sound->onPlayable = [this, newSound, &published]() {
+      synth.setSound(newSound);
+      published = true;
+    };
   }
-  sound->loadRegions();
   sound->loadSamples(&formatManager, &loadProgress, thread);
+  sound->onPlayable = nullptr;
   if (thread && thread->threadShouldExit())
   {
-    delete sound;
     return;
   }
 
-  synth.addSound(sound);
+  if (!published)
+  {
+    synth.setSound(sound.get());
+  }
+  residency.addSound(sound.get());
 }
 
 sfzero::SFZeroAudioProcessor::LoadThread::LoadThread(SFZeroAudioProcessor *processorIn)
@@ -161,6 +333,21 @@ sfzero::SFZeroAudioProcessor::LoadThread::LoadThread(SFZeroAudioProcessor *proce
 {
 }
 
-void sfzero::SFZeroAudioProcessor::LoadThread::run() {processor->loadSound(this);}
+void sfzero::SFZeroAudioProcessor::loadPrograms(juce::Thread *thread)
+{
+  programBank.load(&formatManager, &loadProgress, thread);
+}
+
+void sfzero::SFZeroAudioProcessor::LoadThread::run()
+{
+  if (processor->loadingPrograms)
+  {
+    processor->loadPrograms(this);
+  }
+  else
+  {
+    processor->loadSound(this);
+  }
+}
 
 juce::AudioProcessor *JUCE_CALLTYPE createPluginFilter() {return new sfzero::SFZeroAudioProcessor();}
@@ -1,7 +1,9 @@
 #ifndef INCLUDED_SFZEROAUDIOPROCESSOR_H
 #define INCLUDED_SFZEROAUDIOPROCESSOR_H
 
-#include "../JuceLibraryCode/JuceHeader.h"
+// Found on the include path rather than relative to this file, so the
+// console tools that build this processor get their own JuceHeader.h.
+#include "JuceHeader.h"
 
 namespace sfzero
 {
@@ -36,6 +38,43 @@ public:
   void setSfzFileThreaded(juce::File *newSfzFile);
 
   juce::File getSfzFile() { return (sfzFile); }
+
+  // Programs kept loaded so MIDI program changes switch between them
+  // instantly; see ProgramBank.  Build the bank, then load it.
+  void clearPrograms();
+  void addProgram(const juce::File &file, int subsound = 0);
+  void setProgramMemoryBudget(juce::int64 bytes);
+  void loadProgramsThreaded();
+  ProgramBank &getProgramBank() { return programBank; }
+
+  // Caps the memory used by samples; zero means no limit.  See
+  // ResidencyManager.
+  void setSampleMemoryBudget(juce::int64 bytes) { residency.setMemoryBudget(bytes); }
+  ResidencyManager &getResidencyManager() { return residency; }
+
+  // Keep samples losslessly compressed in memory, trading some CPU for RAM.
+  // Applies to sounds loaded after it's set.
+  void setCompressSamples(bool shouldCompress);
+
+  // For SF2 files, read only the samples of the selected preset (and of any
+  // that are programs); others are read in the background when selected.
+  // Applies to sounds loaded after it's set.
+  void setLoadPresetsOnDemand(bool shouldLoadOnDemand);
+
+  // Keep decoded copies of SF3 files' samples in the user's application data
+  // folder, so each is only decoded once.  See DecodeCache.
+  void setCacheDecodedSamples(bool shouldCache);
+
+  // When a block misses its deadline, save what the synth had been doing as
+  // a Chrome trace in the user's application data folder.  See Trace.
+  void setSaveTracesOnDeadlineMiss(bool shouldSave);
+
+  // Render deterministically: the voices step through samples in 32.32 fixed
+  // point and work out pitch and gain without libm, so the output depends only
+  // on the MIDI, sample rate and block size, and on the compiler not fusing
+  // multiply-adds.  For regression checks; see SFZero Render.
+  void setFixedPointPhase(bool shouldUseFixedPoint) { synth.setFixedPointPhase(shouldUseFixedPoint); }
+
   bool acceptsMidi() const override;
   bool producesMidi() const override;
 
@@ -55,6 +94,10 @@ public:
   int numVoicesUsed();
   juce::String voiceInfoString();
 
+  // Block timings, voice counts and note latencies, for a GUI or logging
+  // thread to take snapshots of while the audio thread runs.
+  Telemetry &getTelemetry() { return telemetry; }
+
 protected:
 
   class LoadThread : public juce::Thread
@@ -69,11 +112,22 @@ protected:
   friend class LoadThread;
 
   juce::File sfzFile;
+  int pendingSubsound;
+  bool loadingPrograms;
+  bool compressSamples;
+  bool loadPresetsOnDemand;
+  bool cacheDecodedSamples;
+  ResidencyManager residency;
+  Telemetry telemetry;
   Synth synth;
+  ProgramBank programBank;
   juce::AudioFormatManager formatManager;
   LoadThread loadThread;
+  juce::TimeSliceThread backgroundThread;
+  juce::SharedResourcePointer<DiagnosticsThread> diagnosticsThread;
 
   void loadSound(juce::Thread *thread = nullptr);
+  void loadPrograms(juce::Thread *thread);
 
 private:
   JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SFZeroAudioProcessor);
@@ -0,0 +1,785 @@
+//==============================================================================
+// SFZero Bench
+//
+// Times the parts of the SFZero module that playing and loading lean on, from
+// the voice's inner loop up to a whole processBlock(), using generated input
+// so the results don't depend on what's installed.  With --json, the results
+// are also written out for comparing between releases.  --stress instead
+// drives the processor hard and reports what it did on the audio thread that
+// it shouldn't have (Debug builds, which have SFZERO_REALTIME_CHECKS); with
+// --trace it also saves a Chrome trace of its last moments.
+//
+//   SFZero Bench [--regions N] [--runs N] [--voices N] [--only NAME]
+//                [--json FILE] [--stress SECONDS] [--trace FILE]
+//==============================================================================
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../../MIDI Connect/Source/SFZeroAudioProcessor.h"
+
+namespace {
+
+const double sampleRate = 48000.0;
+
+double median(Array<double> values) {
+    values.sort();
+    return values[values.size() / 2];
+}
+
+// Runs "run" numRuns times, returning how long each took in milliseconds.
+template <typename Function>
+Array<double> timeRuns(int numRuns, Function run) {
+    Array<double> times;
+    for (int i = 0; i < numRuns; ++i) {
+        double start = Time::getMillisecondCounterHiRes();
+        run();
+        times.add(Time::getMillisecondCounterHiRes() - start);
+    }
+    return times;
+}
+
+// Prints each result as it comes in and keeps it for the JSON file.  A
+// benchmark is named after what it times; the variant says which case it is,
+// and the two together stay the same between releases.
+class Results {
+public:
+    explicit Results(const String& only) : only_(only) {}
+
+    // --only takes a benchmark's full name, or a class or namespace to run
+    // everything in: "Reader" runs Reader::read and Reader::read includes, but
+    // not SF2Reader::read.
+    bool wants(const String& name) const {
+        return only_.isEmpty() || name == only_ || name.startsWith(only_ + "::");
+    }
+
+    void add(const String& name, const String& variant, const Array<double>& times, double itemsPerRun,
+             const String& items) {
+        if (times.isEmpty())
+            return;
+        double typical = median(times);
+        double fastest = *std::min_element(times.begin(), times.end());
+        double perSecond = typical > 0.0 ? itemsPerRun / (typical / 1000.0) : 0.0;
+        double nsEach = itemsPerRun > 0.0 ? typical * 1e6 / itemsPerRun : 0.0;
+        std::cout << "  " << variant << ": median " << String(typical, 3) << " ms, min " << String(fastest, 3)
+                  << " ms, " << String(perSecond / 1e6, 2) << " M " << items << "/s (" << String(nsEach, 1)
+                  << " ns each)\n";
+
+        DynamicObject::Ptr result = new DynamicObject();
+        result->setProperty("name", name);
+        result->setProperty("variant", variant);
+        result->setProperty("runs", times.size());
+        result->setProperty("median_ms", typical);
+        result->setProperty("min_ms", fastest);
+        result->setProperty("items", items);
+        result->setProperty("items_per_run", itemsPerRun);
+        result->setProperty("items_per_second", perSecond);
+        result->setProperty("ns_per_item", nsEach);
+        results_.add(var(result.get()));
+    }
+
+    bool writeJSON(const File& file) const {
+        DynamicObject::Ptr root = new DynamicObject();
+        root->setProperty("suite", "SFZero Bench");
+        root->setProperty("version", ProjectInfo::versionString);
+        root->setProperty("date", Time::getCurrentTime().toISO8601(true));
+        root->setProperty("os", SystemStats::getOperatingSystemName());
+        root->setProperty("cpus", SystemStats::getNumCpus());
+        root->setProperty("cpu", SystemStats::getCpuModel());
+        root->setProperty("sample_rate", sampleRate);
+        root->setProperty("results", var(results_));
+        return file.replaceWithText(JSON::toString(var(root.get())));
+    }
+
+private:
+    String only_;
+    Array<var> results_;
+};
+
+//==============================================================================
+// Generated instruments.
+
+// Regions shaped like an orchestral patch: groups of 16 spread over the
+// keyboard, velocity layers and round robins, using the opcodes such
+// libraries use most.
+void writeRegions(MemoryOutputStream& text, int numRegions) {
+    static const char* const noteNames[] = { "c", "c#", "d", "d#", "e", "f", "f#", "g", "g#", "a", "a#", "b" };
+
+    for (int i = 0; i < numRegions; ++i) {
+        int note = 21 + (i / 16) % 88;
+        int layer = (i / 4) % 4;
+        int roundRobin = i % 4;
+        if (i % 16 == 0)
+            text << "\n<group> amp_veltrack=80 ampeg_release=0.65 loop_mode=one_shot group=" << (i / 16) % 64 << "\n";
+
+        String key = String(noteNames[note % 12]) + String(note / 12 - 1);
+        text << "<region> sample=Violins sus " << key << " vl" << layer + 1 << " rr" << roundRobin + 1 << ".wav"
+             << " lokey=" << key << " hikey=" << key << " pitch_keycenter=" << key
+             << " lovel=" << layer * 32 + 1 << " hivel=" << layer * 32 + 32
+             << " tune=" << (i % 7) - 3 << " volume=-" << String(1.5 + (i % 5) * 0.25, 2)
+             << " pan=" << String((i % 9) * 2.5 - 10.0, 1) << " offset=" << (i % 3) * 120
+             << " ampeg_attack=0.003 ampeg_decay=" << String(0.8 + layer * 0.2, 1) << " ampeg_sustain=85\n";
+    }
+}
+
+File writeLargeSfz(int numRegions) {
+    MemoryOutputStream text;
+    text << "// Generated by SFZero Bench\n<control> default_path=samples/\n";
+    writeRegions(text, numRegions);
+
+    File file = File::createTempFile(".sfz");
+    file.replaceWithData(text.getData(), text.getDataSize());
+    return file;
+}
+
+// A few seconds of a harmonic tone, so the voices have real audio to play.
+bool writeTone(const File& file, int numChannels, int numFrames) {
+    AudioSampleBuffer buffer(numChannels, numFrames);
+    for (int channel = 0; channel < numChannels; ++channel) {
+        for (int i = 0; i < numFrames; ++i) {
+            double phase = MathConstants<double>::twoPi * 261.63 * i / sampleRate + channel * 0.5;
+            buffer.setSample(channel, i, (float) (0.4 * std::sin(phase) + 0.2 * std::sin(2.0 * phase)
+                                                  + 0.1 * std::sin(3.0 * phase)));
+        }
+    }
+
+    WavAudioFormat wav;
+    std::unique_ptr<AudioFormatWriter> writer(wav.createWriterFor(file.createOutputStream(), sampleRate, numChannels, 16,
+                                                                  StringPairArray(), 0));
+    return writer != nullptr && writer->writeFromAudioSampleBuffer(buffer, 0, numFrames);
+}
+
+// The instruments the playing benchmarks use, written to a directory of
+// their own: "voices.sfz" has one region per sample layout, in the order of
+// voiceLayouts, and "keys.sfz" covers every key and velocity with looped
+// stereo regions, the way a sustained patch does.
+struct TestInstruments {
+    File directory, voices, keys;
+
+    bool write() {
+        directory = File::getSpecialLocation(File::tempDirectory).getNonexistentChildFile("SFZero Bench", "");
+        const int numFrames = (int) (4 * sampleRate);
+        if (!directory.createDirectory() || !writeTone(directory.getChildFile("mono.wav"), 1, numFrames)
+            || !writeTone(directory.getChildFile("stereo.wav"), 2, numFrames))
+            return false;
+
+        String loop = " loop_mode=loop_continuous loop_start=12000 loop_end=180000";
+        voices = directory.getChildFile("voices.sfz");
+        voices.replaceWithText("<region> sample=mono.wav pitch_keycenter=60\n"
+                               "<region> sample=mono.wav pitch_keycenter=60" + loop + "\n"
+                               "<region> sample=stereo.wav pitch_keycenter=60\n"
+                               "<region> sample=stereo.wav pitch_keycenter=60" + loop + "\n");
+
+        MemoryOutputStream text;
+        text << "<group> sample=stereo.wav ampeg_release=0.3" << loop << "\n";
+        for (int key = 0; key < 128; key += 4)
+            for (int layer = 0; layer < 4; ++layer)
+                text << "<region> lokey=" << key << " hikey=" << key + 3 << " pitch_keycenter=" << key + 2
+                     << " lovel=" << layer * 32 << " hivel=" << layer * 32 + 31 << " volume=-" << layer << "\n";
+        keys = directory.getChildFile("keys.sfz");
+        return keys.replaceWithData(text.getData(), text.getDataSize());
+    }
+
+    ~TestInstruments() {
+        if (directory != File())
+            directory.deleteRecursively();
+    }
+};
+
+sfzero::Sound::Ptr loadSound(const File& file, AudioFormatManager& formatManager) {
+    sfzero::Sound::Ptr sound(new sfzero::Sound(file));
+    sound->loadRegions();
+    sound->loadSamples(&formatManager);
+    return sound;
+}
+
+// An SF2 file with a preset per instrument, each splitting the keyboard into
+// zones over a pool of looped mono samples.
+File writeLargeSf2(int numPresets, int zonesPerInstrument, int numSamples, int sampleFrames) {
+    auto writeName = [](MemoryOutputStream& out, const String& name) {
+        char text[20] = {};
+        name.copyToUTF8(text, sizeof(text));
+        out.write(text, sizeof(text));
+    };
+    auto writeChunk = [](MemoryOutputStream& out, const char* id, const MemoryOutputStream& data) {
+        out.write(id, 4);
+        out.writeInt((int) data.getDataSize());
+        out.write(data.getData(), data.getDataSize());
+    };
+    auto writeList = [](MemoryOutputStream& out, const char* id, const char* type, const MemoryOutputStream& data) {
+        out.write(id, 4);
+        out.writeInt((int) data.getDataSize() + 4);
+        out.write(type, 4);
+        out.write(data.getData(), data.getDataSize());
+    };
+
+    MemoryOutputStream ifil, info;
+    ifil.writeShort(2);
+    ifil.writeShort(1);
+    writeChunk(info, "ifil", ifil);
+
+    // Each sample is followed by the 46 zeros the spec asks for.
+    const int sampleSpacing = sampleFrames + 46;
+    MemoryOutputStream smpl, sdta;
+    for (int sample = 0; sample < numSamples; ++sample) {
+        for (int i = 0; i < sampleFrames; ++i)
+            smpl.writeShort((short) (12000.0 * std::sin(MathConstants<double>::twoPi * (110.0 + sample) * i / sampleRate)));
+        for (int i = 0; i < 46; ++i)
+            smpl.writeShort(0);
+    }
+    writeChunk(sdta, "smpl", smpl);
+
+    MemoryOutputStream phdr, pbag, pmod, pgen, inst, ibag, imod, igen, shdr;
+    for (int preset = 0; preset <= numPresets; ++preset) {
+        bool terminal = preset == numPresets;
+        writeName(phdr, terminal ? String("EOP") : "Preset " + String(preset + 1));
+        phdr.writeShort((short) (preset % 128));
+        phdr.writeShort((short) (preset / 128));
+        phdr.writeShort((short) preset); // One zone each.
+        phdr.writeInt(0);
+        phdr.writeInt(0);
+        phdr.writeInt(0);
+
+        pbag.writeShort((short) preset);
+        pbag.writeShort(0);
+        if (!terminal) {
+            pgen.writeShort(sfzero::SF2Generator::instrument);
+            pgen.writeShort((short) preset);
+        }
+
+        writeName(inst, terminal ? String("EOI") : "Instrument " + String(preset + 1));
+        inst.writeShort((short) (preset * zonesPerInstrument));
+        for (int zone = 0; zone < zonesPerInstrument && !terminal; ++zone) {
+            int lokey = zone * 128 / zonesPerInstrument, hikey = (zone + 1) * 128 / zonesPerInstrument - 1;
+            ibag.writeShort((short) ((preset * zonesPerInstrument + zone) * 3));
+            ibag.writeShort(0);
+            igen.writeShort(sfzero::SF2Generator::keyRange);
+            igen.writeByte((char) lokey);
+            igen.writeByte((char) hikey);
+            igen.writeShort(sfzero::SF2Generator::sampleModes);
+            igen.writeShort(1);
+            igen.writeShort(sfzero::SF2Generator::sampleID);
+            igen.writeShort((short) ((preset * zonesPerInstrument + zone) % numSamples));
+        }
+    }
+    ibag.writeShort((short) (numPresets * zonesPerInstrument * 3));
+    ibag.writeShort(0);
+    for (auto* terminal : { &pgen, &igen })
+        terminal->writeInt(0);
+    for (auto* terminal : { &pmod, &imod })
+        for (int i = 0; i < 5; ++i)
+            terminal->writeShort(0);
+
+    for (int sample = 0; sample <= numSamples; ++sample) {
+        bool terminal = sample == numSamples;
+        int start = terminal ? 0 : sample * sampleSpacing;
+        writeName(shdr, terminal ? String("EOS") : "Sample " + String(sample + 1));
+        shdr.writeInt(start);
+        shdr.writeInt(terminal ? 0 : start + sampleFrames);
+        shdr.writeInt(terminal ? 0 : start + sampleFrames / 4);
+        shdr.writeInt(terminal ? 0 : start + sampleFrames * 3 / 4);
+        shdr.writeInt(terminal ? 0 : (int) sampleRate);
+        shdr.writeByte(60);
+        shdr.writeByte(0);
+        shdr.writeShort(0);
+        shdr.writeShort(terminal ? 0 : 1); // Mono.
+    }
+
+    MemoryOutputStream pdta;
+    writeChunk(pdta, "phdr", phdr);
+    writeChunk(pdta, "pbag", pbag);
+    writeChunk(pdta, "pmod", pmod);
+    writeChunk(pdta, "pgen", pgen);
+    writeChunk(pdta, "inst", inst);
+    writeChunk(pdta, "ibag", ibag);
+    writeChunk(pdta, "imod", imod);
+    writeChunk(pdta, "igen", igen);
+    writeChunk(pdta, "shdr", shdr);
+
+    MemoryOutputStream contents, riff;
+    writeList(contents, "LIST", "INFO", info);
+    writeList(contents, "LIST", "sdta", sdta);
+    writeList(contents, "LIST", "pdta", pdta);
+    writeList(riff, "RIFF", "sfbk", contents);
+
+    File file = File::createTempFile(".sf2");
+    file.replaceWithData(riff.getData(), riff.getDataSize());
+    return file;
+}
+
+//==============================================================================
+// Playing.
+
+void benchmarkVoice(Results& results, const TestInstruments& instruments, int numRuns) {
+    // Regions of voices.sfz.
+    static const char* const voiceLayouts[] = { "mono", "mono looped", "stereo", "stereo looped" };
+    // Notes around the key centre of 60, for pitch ratios of 0.5, 1, 1.5 and 2.
+    static const int notes[] = { 48, 60, 67, 72 };
+
+    AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+    sfzero::Sound::Ptr sound = loadSound(instruments.voices, formatManager);
+    if (sound->getNumRegions() != numElementsInArray(voiceLayouts)) {
+        std::cout << "Voice::renderNextBlock: couldn't load the test instrument\n";
+        return;
+    }
+
+    // A second of output per run, which the 4 s samples last for even at 2x.
+    const int blockSize = 256;
+    const int numBlocks = (int) sampleRate / blockSize;
+    AudioSampleBuffer output(2, blockSize);
+    std::cout << "Voice::renderNextBlock, " << blockSize << "-sample blocks\n";
+    for (int layout = 0; layout < numElementsInArray(voiceLayouts); ++layout) {
+        for (int note : notes) {
+            sfzero::Voice voice;
+            voice.setCurrentPlaybackSampleRate(sampleRate);
+            Array<double> times = timeRuns(numRuns, [&]() {
+                voice.setRegion(sound->regionAt(layout));
+                voice.startNote(note, 0.8f, sound.get(), 8192);
+                for (int block = 0; block < numBlocks; ++block) {
+                    output.clear();
+                    voice.renderNextBlock(output, 0, blockSize);
+                }
+                voice.stopNote(0.0f, false);
+            });
+            String ratio(std::pow(2.0, (note - 60) / 12.0), 2);
+            results.add("Voice::renderNextBlock", String(voiceLayouts[layout]) + ", ratio " + ratio, times,
+                        numBlocks * blockSize, "samples");
+        }
+    }
+}
+
+// Steps envelopes through every segment the way Voice::renderNextBlock()
+// does, with segments short enough that moving between them (EG's part of
+// the work) counts for as much as the stepping.
+void benchmarkEG(Results& results, int numRuns) {
+    sfzero::EGParameters parameters;
+    parameters.clear();
+    parameters.delay = 0.001f;
+    parameters.attack = 0.002f;
+    parameters.hold = 0.001f;
+    parameters.decay = 0.005f;
+    parameters.sustain = 50.0f;
+    parameters.release = 0.005f;
+    const int numEnvelopes = 1000;
+    const int sustainSamples = 64;
+
+    std::cout << "EG, " << numEnvelopes << " envelopes\n";
+    for (bool exponentialDecay : { true, false }) {
+        sfzero::EG eg;
+        eg.setExponentialDecay(exponentialDecay);
+        float sum = 0.0f;
+
+        auto run = [&](int numSamples) {
+            float level = eg.getLevel(), slope = eg.getSlope();
+            int samplesUntilNextSegment = eg.getSamplesUntilNextSegment();
+            bool exponential = eg.getSegmentIsExponential();
+            for (int i = 0; i < numSamples && !eg.isDone(); ++i) {
+                sum += level;
+                level = exponential ? level * slope : level + slope;
+                if (--samplesUntilNextSegment < 0) {
+                    eg.setLevel(level);
+                    eg.nextSegment();
+                    level = eg.getLevel();
+                    slope = eg.getSlope();
+                    samplesUntilNextSegment = eg.getSamplesUntilNextSegment();
+                    exponential = eg.getSegmentIsExponential();
+                }
+            }
+            eg.setLevel(level);
+            eg.setSamplesUntilNextSegment(samplesUntilNextSegment);
+        };
+
+        Array<double> times = timeRuns(numRuns, [&]() {
+            for (int i = 0; i < numEnvelopes; ++i) {
+                eg.startNote(&parameters, 0.8f, sampleRate);
+                while (eg.segmentIndex() < 4) // Up to sustain.
+                    run(sustainSamples);
+                run(sustainSamples);
+                eg.noteOff();
+                while (!eg.isDone())
+                    run(sustainSamples);
+            }
+        });
+        results.add("EG", exponentialDecay ? "exponential decay" : "linear decay", times, numEnvelopes, "envelopes");
+        if (sum < 0.0f)
+            std::cout << "  (envelopes went negative)\n";
+    }
+}
+
+void benchmarkGetRegionFor(Results& results, int numRegions, int numRuns) {
+    const int numLookups = 100000;
+    Array<int> notes, velocities;
+    Random random(1);
+    for (int i = 0; i < numLookups; ++i) {
+        notes.add(21 + random.nextInt(88));
+        velocities.add(1 + random.nextInt(127));
+    }
+
+    std::cout << "Sound::getRegionFor, " << numLookups << " notes\n";
+    for (int size : { jmin(1000, numRegions), numRegions }) {
+        File file = writeLargeSfz(size);
+        sfzero::Sound::Ptr sound(new sfzero::Sound(file));
+        sound->loadRegions();
+        file.deleteFile();
+
+        int numFound = 0;
+        Array<double> times = timeRuns(numRuns, [&]() {
+            for (int i = 0; i < numLookups; ++i)
+                if (sound->getRegionFor(notes[i], velocities[i]) != nullptr)
+                    ++numFound;
+        });
+        results.add("Sound::getRegionFor", String(size) + " regions", times, numLookups, "lookups");
+        if (numFound == 0)
+            std::cout << "  (no regions found)\n";
+        if (size == numRegions)
+            break;
+    }
+}
+
+// Chords of different sizes, started on a synth with the processor's voice
+// count.  Only the noteOn() calls are timed, not stopping the notes.
+void benchmarkNoteOn(Results& results, const TestInstruments& instruments, int numRuns) {
+    AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+    sfzero::Sound::Ptr sound = loadSound(instruments.keys, formatManager);
+
+    sfzero::Synth synth;
+    for (int i = 0; i < 128; ++i)
+        synth.addVoice(new sfzero::Voice());
+    synth.setCurrentPlaybackSampleRate(sampleRate);
+    synth.setSound(sound.get());
+
+    const int numBursts = 100;
+    std::cout << "Synth::noteOn, " << numBursts << " bursts\n";
+    for (int burstSize : { 1, 8, 32, 96 }) {
+        Array<double> times;
+        for (int run = 0; run < numRuns; ++run) {
+            double elapsed = 0.0;
+            for (int burst = 0; burst < numBursts; ++burst) {
+                double start = Time::getMillisecondCounterHiRes();
+                for (int i = 0; i < burstSize; ++i)
+                    synth.noteOn(1 + i / 64, 28 + (i * 5 + burst) % 64, 0.25f + (i % 4) * 0.2f);
+                elapsed += Time::getMillisecondCounterHiRes() - start;
+                synth.allNotesOff(0, false);
+            }
+            times.add(elapsed);
+        }
+        results.add("Synth::noteOn", String(burstSize) + "-note bursts", times, numBursts * burstSize, "notes");
+    }
+}
+
+// The whole processor, holding "numVoices" looped notes, for a second of
+// audio at each block size.
+void benchmarkProcessBlock(Results& results, const TestInstruments& instruments, int numVoices, int numRuns) {
+    std::cout << "SFZeroAudioProcessor::processBlock, " << numVoices << " voices\n";
+    for (int blockSize : { 64, 128, 256 }) {
+        sfzero::SFZeroAudioProcessor processor;
+        File keys = instruments.keys;
+        processor.setSfzFile(&keys);
+        processor.prepareToPlay(sampleRate, blockSize);
+
+        AudioSampleBuffer buffer(2, blockSize);
+        MidiBuffer midi;
+        for (int i = 0; i < numVoices; ++i)
+            midi.addEvent(MidiMessage::noteOn(1 + i / 64, 28 + i % 64, (uint8) (24 + (i * 29) % 100)), 0);
+        processor.processBlock(buffer, midi);
+        midi.clear();
+        if (processor.numVoicesUsed() != numVoices)
+            std::cout << "  (" << processor.numVoicesUsed() << " voices playing)\n";
+
+        const int numBlocks = (int) sampleRate / blockSize;
+        Array<double> times = timeRuns(numRuns, [&]() {
+            for (int block = 0; block < numBlocks; ++block)
+                processor.processBlock(buffer, midi);
+        });
+        results.add("SFZeroAudioProcessor::processBlock", String(blockSize) + "-sample blocks, " + String(numVoices)
+                    + " voices", times, numBlocks * blockSize, "samples");
+        processor.releaseResources();
+    }
+}
+
+//==============================================================================
+// Loading.
+
+void benchmarkReader(Results& results, int numRegions, int numRuns) {
+    File file = writeLargeSfz(numRegions);
+    double megabytes = file.getSize() / (1024.0 * 1024.0);
+    std::cout << "Reader::read, " << numRegions << " regions (" << String(megabytes, 1) << " MB)\n";
+
+    Array<double> times;
+    sfzero::Sound::Ptr sound;
+    for (int run = 0; run < numRuns; ++run) {
+        sound = new sfzero::Sound(file);
+        double start = Time::getMillisecondCounterHiRes();
+        sound->loadRegions();
+        times.add(Time::getMillisecondCounterHiRes() - start);
+
+        if (sound->getNumRegions() != numRegions || sound->getErrors().size() > 0) {
+            std::cout << "  read " << sound->getNumRegions() << " regions, "
+                      << sound->getErrors().size() << " errors\n";
+            break;
+        }
+    }
+    file.deleteFile();
+
+    results.add("Reader::read", String(numRegions) + " regions", times, numRegions, "regions");
+    if (!times.isEmpty())
+        std::cout << "  " << String(megabytes / (median(times) / 1000.0), 1) << " MB/s\n";
+    if (sound != nullptr)
+        std::cout << "  regions take " << String(sound->getRegionMemoryUsage() / (1024.0 * 1024.0), 2) << " MB, sharing "
+                  << sound->getNumRegionParameters() << " parameter blocks\n";
+}
+
+// A library split the way commercial ones are: articulation files that
+// each #define a few variables and #include the same key map.  Times loading
+// all of them with the parse cache emptied before each file, then with it
+// kept.
+void benchmarkIncludes(Results& results, int numRegions, int numArticulations, int numRuns) {
+    File directory = File::getSpecialLocation(File::tempDirectory).getNonexistentChildFile("SFZero Bench", "");
+    directory.createDirectory();
+
+    MemoryOutputStream map;
+    map << "<group> volume=$VOLUME\n";
+    writeRegions(map, numRegions);
+    directory.getChildFile("map.sfz").replaceWithData(map.getData(), map.getDataSize());
+
+    Array<File> articulations;
+    for (int i = 0; i < numArticulations; ++i) {
+        File file = directory.getChildFile("articulation " + String(i + 1) + ".sfz");
+        file.replaceWithText("<control> default_path=samples/\n#define $VOLUME -" + String(i) + "\n#include \"map.sfz\"\n");
+        articulations.add(file);
+    }
+
+    std::cout << "Reader::read, " << numArticulations << " files including one " << numRegions << "-region map\n";
+    for (bool keepCache : { false, true }) {
+        Array<double> times;
+        for (int run = 0; run < numRuns; ++run) {
+            sfzero::ParseCache::getInstance().clear();
+            double start = Time::getMillisecondCounterHiRes();
+            for (auto& file : articulations) {
+                if (!keepCache)
+                    sfzero::ParseCache::getInstance().clear();
+                sfzero::Sound::Ptr sound(new sfzero::Sound(file));
+                sound->loadRegions();
+                jassert(sound->getNumRegions() == numRegions);
+            }
+            times.add(Time::getMillisecondCounterHiRes() - start);
+        }
+        results.add("Reader::read includes", String(numArticulations) + " files, " + (keepCache ? "cached" : "uncached"),
+                    times, numArticulations * numRegions, "regions");
+    }
+
+    sfzero::ParseCache::getInstance().clear();
+    directory.deleteRecursively();
+}
+
+// The hydra (every preset's zones, made into regions) and then the sample
+// data, read as one block.
+void benchmarkSF2(Results& results, int numRuns) {
+    const int numPresets = 128, zonesPerInstrument = 16, numSamples = 256, sampleFrames = 24000;
+    File file = writeLargeSf2(numPresets, zonesPerInstrument, numSamples, sampleFrames);
+    double megabytes = file.getSize() / (1024.0 * 1024.0);
+    std::cout << "SF2Reader, " << numPresets << " presets of " << zonesPerInstrument << " zones, " << numSamples
+              << " samples (" << String(megabytes, 1) << " MB)\n";
+
+    AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+    Array<double> hydraTimes, sampleTimes;
+    for (int run = 0; run < numRuns; ++run) {
+        sfzero::Sound::Ptr sound(new sfzero::SF2Sound(file));
+        double start = Time::getMillisecondCounterHiRes();
+        sound->loadRegions();
+        hydraTimes.add(Time::getMillisecondCounterHiRes() - start);
+        if (sound->getErrors().size() > 0) {
+            std::cout << "  " << sound->getErrors().joinIntoString("; ") << "\n";
+            break;
+        }
+
+        start = Time::getMillisecondCounterHiRes();
+        sound->loadSamples(&formatManager);
+        sampleTimes.add(Time::getMillisecondCounterHiRes() - start);
+    }
+    file.deleteFile();
+
+    results.add("SF2Reader::read", "hydra", hydraTimes, numPresets * zonesPerInstrument, "zones");
+    results.add("SF2Reader::read", "samples", sampleTimes, (double) numSamples * sampleFrames, "samples");
+}
+
+//==============================================================================
+// Real-time safety.
+
+// Plays a processor the way a busy live set would: chords big enough to
+// steal voices, controllers, pitch bends and program changes on four
+// channels, with the block size changing from one block to the next.
+class StressThread : public Thread {
+public:
+    explicit StressThread(sfzero::SFZeroAudioProcessor& processor)
+        : Thread("SFZero Bench stress"), processor_(processor) {}
+
+    void run() override {
+        Random random(1);
+        AudioSampleBuffer buffer(2, maxBlockSize);
+        MidiBuffer midi;
+        midi.ensureSize(8192);
+        while (!threadShouldExit()) {
+            int blockSize = 16 + random.nextInt(maxBlockSize - 15);
+            buffer.setSize(2, blockSize, false, false, true);
+            midi.clear();
+            addEvents(midi, random, blockSize);
+            processor_.processBlock(buffer, midi);
+            ++numBlocks_;
+        }
+    }
+
+    int getNumBlocks() const { return numBlocks_; }
+
+private:
+    enum { maxBlockSize = 512 };
+
+    static void addEvents(MidiBuffer& midi, Random& random, int blockSize) {
+        static const int controllers[] = { 1, 7, 10, 11, 64 };
+        for (int numEvents = random.nextInt(6); --numEvents >= 0;) {
+            int channel = 1 + random.nextInt(4);
+            int note = 24 + random.nextInt(80);
+            int position = random.nextInt(blockSize);
+            int choice = random.nextInt(100);
+            if (choice < 8) {
+                for (int i = 0; i < 24; ++i)
+                    midi.addEvent(MidiMessage::noteOn(channel, jmin(127, note + i * 2), (uint8) (1 + random.nextInt(127))),
+                                  position);
+            }
+            else if (choice < 45)
+                midi.addEvent(MidiMessage::noteOn(channel, note, (uint8) (1 + random.nextInt(127))), position);
+            else if (choice < 75)
+                midi.addEvent(MidiMessage::noteOff(channel, note), position);
+            else if (choice < 82)
+                midi.addEvent(MidiMessage::pitchWheel(channel, random.nextInt(16384)), position);
+            else if (choice < 90)
+                midi.addEvent(MidiMessage::controllerEvent(channel, controllers[random.nextInt(numElementsInArray(controllers))],
+                                                           random.nextInt(128)), position);
+            else if (choice < 94)
+                midi.addEvent(MidiMessage::channelPressureChange(channel, random.nextInt(128)), position);
+            else if (choice < 97)
+                midi.addEvent(MidiMessage::aftertouchChange(channel, note, random.nextInt(128)), position);
+            else if (choice < 99)
+                midi.addEvent(MidiMessage::programChange(channel, random.nextInt(4)), position);
+            else
+                midi.addEvent(MidiMessage::allNotesOff(channel), position);
+        }
+    }
+
+    sfzero::SFZeroAudioProcessor& processor_;
+    int numBlocks_ = 0;
+};
+
+// Runs the stress thread while this one keeps loading other instruments into
+// the processor, then lists what RealtimeCheck caught on the stress thread.
+// Locks that were free are listed, but only the other kinds fail the run.
+int runStress(const TestInstruments& instruments, double seconds, const File& traceFile) {
+    if (!sfzero::RealtimeCheck::isAvailable()) {
+        std::cout << "--stress needs a build with SFZERO_REALTIME_CHECKS=1, such as the Debug one\n";
+        return 1;
+    }
+
+    sfzero::SFZeroAudioProcessor processor;
+    File keys = instruments.keys, voices = instruments.voices;
+    processor.setSfzFile(&keys);
+    processor.prepareToPlay(sampleRate, 512);
+    sfzero::RealtimeCheck::clear();
+
+    std::cout << "Stressing SFZeroAudioProcessor::processBlock for " << seconds << " s\n";
+    StressThread audioThread(processor);
+    audioThread.startThread(9);
+    double end = Time::getMillisecondCounterHiRes() + seconds * 1000.0;
+    for (int load = 0; Time::getMillisecondCounterHiRes() < end; ++load) {
+        Thread::sleep(250);
+        File next = load % 2 == 0 ? voices : keys;
+        processor.setSfzFileThreaded(&next);
+    }
+    audioThread.stopThread(2000);
+
+    int numFailures = 0;
+    Array<sfzero::RealtimeCheck::Violation> violations = sfzero::RealtimeCheck::getViolations();
+    for (auto& violation : violations) {
+        std::cout << "\n" << sfzero::RealtimeCheck::getKindName(violation.kind) << " (" << violation.call << "), "
+                  << violation.count << " times, at:\n" << violation.stack;
+        if (violation.kind != sfzero::RealtimeCheck::lock)
+            ++numFailures;
+    }
+    if (traceFile != File() && !sfzero::Trace::getInstance().writeChromeJSON(traceFile))
+        std::cout << "couldn't write " << traceFile.getFullPathName() << "\n";
+    std::cout << "\n" << audioThread.getNumBlocks() << " blocks, " << sfzero::RealtimeCheck::getNumViolations()
+              << " violations in " << violations.size() << " places, " << numFailures << " of them not free locks\n";
+
+    // Read from this thread while the audio thread ran, as a GUI would.
+    sfzero::TelemetrySnapshot telemetry;
+    processor.getTelemetry().getSnapshot(telemetry);
+    std::cout << "processBlock: median " << String(telemetry.blockMedian, 1) << " us, p99 "
+              << String(telemetry.blockP99, 1) << " us, max " << String(telemetry.blockMax, 1) << " us, "
+              << (int64) telemetry.numDeadlineMisses << " deadline misses\n"
+              << "voices: peak " << telemetry.peakVoices << ", " << (int64) telemetry.numNotes << " started, "
+              << (int64) telemetry.numSteals << " stolen, " << (int64) telemetry.numCulls << " culled; note latency median "
+              << String(telemetry.noteLatencyMedian, 1) << " us, max " << String(telemetry.noteLatencyMax, 1) << " us\n"
+              << "per block: events " << String(telemetry.eventMicros, 1) << " us, voices "
+              << String(telemetry.voiceMicros, 1) << " us, other " << String(telemetry.otherMicros, 1) << " us\n";
+    return numFailures > 0 ? 1 : 0;
+}
+
+} // namespace
+
+//==============================================================================
+
+int main(int argc, char* argv[]) {
+    StringArray args(argv + 1, argc - 1);
+    int numRegions = 100000, numRuns = 10, numVoices = 64;
+    double stressSeconds = 0.0;
+    String only;
+    File jsonFile, traceFile;
+    for (int i = 0; i + 1 < args.size(); ++i) {
+        if (args[i] == "--regions")
+            numRegions = jmax(1, args[i + 1].getIntValue());
+        else if (args[i] == "--runs")
+            numRuns = jmax(1, args[i + 1].getIntValue());
+        else if (args[i] == "--voices")
+            numVoices = jlimit(1, 128, args[i + 1].getIntValue());
+        else if (args[i] == "--only")
+            only = args[i + 1];
+        else if (args[i] == "--json")
+            jsonFile = File::getCurrentWorkingDirectory().getChildFile(args[i + 1]);
+        else if (args[i] == "--trace")
+            traceFile = File::getCurrentWorkingDirectory().getChildFile(args[i + 1]);
+        else if (args[i] == "--stress")
+            stressSeconds = jmax(1.0, args[i + 1].getDoubleValue());
+    }
+
+    Results results(only);
+    TestInstruments instruments;
+    if (!instruments.write()) {
+        std::cout << "couldn't write the test instruments\n";
+        return 1;
+    }
+    if (stressSeconds > 0.0)
+        return runStress(instruments, stressSeconds, traceFile);
+
+    if (results.wants("Voice::renderNextBlock"))
+        benchmarkVoice(results, instruments, numRuns);
+    if (results.wants("EG"))
+        benchmarkEG(results, numRuns);
+    if (results.wants("Sound::getRegionFor"))
+        benchmarkGetRegionFor(results, numRegions, numRuns);
+    if (results.wants("Synth::noteOn"))
+        benchmarkNoteOn(results, instruments, numRuns);
+    if (results.wants("SFZeroAudioProcessor::processBlock"))
+        benchmarkProcessBlock(results, instruments, numVoices, numRuns);
+    if (results.wants("Reader::read"))
+        benchmarkReader(results, numRegions, numRuns);
+    if (results.wants("Reader::read includes"))
+        benchmarkIncludes(results, jmax(1, numRegions / 10), 24, numRuns);
+    if (results.wants("SF2Reader::read"))
+        benchmarkSF2(results, numRuns);
+
+    if (jsonFile != File() && !results.writeJSON(jsonFile)) {
+        std::cout << "couldn't write " << jsonFile.getFullPathName() << "\n";
+        return 1;
+    }
+    return 0;
+}
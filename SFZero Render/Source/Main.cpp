@@ -0,0 +1,388 @@
+//==============================================================================
+// SFZero Render
+//
+// Renders MIDI files through SFZeroAudioProcessor to WAV files, without an
+// audio device, for batch bounces and regression checks.  Each file (or with
+// --tracks, each track) renders on its own processor, as many at once as
+// there are cores.  --fixed-point renders deterministically and prints a hash
+// of each file's output.
+//
+// --regression renders a built-in set of reference sequences (scales, pedalled
+// chords, pitch bends, repeated notes and more notes than there are voices)
+// deterministically at 48 kHz in 256-sample blocks, and compares the hashes
+// with those in FILE, which --update writes.  Before a change that shouldn't
+// alter the output, write the bundled piano's hashes with --update; after it,
+// check them, from the top of the repository:
+//
+//   SFZero Render "MIDI Connect/Resources/A112-Piano1d-2/G800-A112-Piano1d-2-3f.sfz"
+//                 --regression piano-hashes.txt [--update]
+//
+// The .jucer builds with -ffp-contract=off so the compiler never fuses a
+// multiply and an add, which it would otherwise do on Apple silicon and
+// change the hashes; with that, every build should give the same ones.
+//
+//   SFZero Render <instrument.sfz|.sf2|.sf3> <file.mid>... [--output DIR]
+//                 [--preset N] [--rate HZ] [--block N] [--tail SECONDS]
+//                 [--tracks] [--jobs N] [--fixed-point]
+//   SFZero Render <instrument.sfz|.sf2|.sf3> --regression FILE [--update]
+//                 [--output DIR] [--preset N] [--jobs N]
+//==============================================================================
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../../MIDI Connect/Source/SFZeroAudioProcessor.h"
+
+namespace {
+
+struct Options {
+    File instrument;
+    File outputDirectory;     // Beside each MIDI file if not set.
+    int preset = 0;
+    double sampleRate = 48000.0;
+    int blockSize = 256;
+    double maxTailSeconds = 10.0; // Rendered after the last event until the voices finish.
+    bool splitTracks = false;
+    int numJobs = 0;          // One per core if zero.
+    bool fixedPoint = false;  // See SFZeroAudioProcessor::setFixedPointPhase().
+    File regressionFile;      // Hashes of the reference sequences.
+    bool updateRegression = false;
+};
+
+struct RenderJob {
+    File midiFile;
+    int track = -1;           // All tracks if negative.
+    String name;              // For a reference sequence, in place of a MIDI file.
+    MidiMessageSequence sequence;
+    File outputFile;          // Not written if not set.
+
+    // Results.
+    double audioSeconds = 0.0;
+    double renderSeconds = 0.0;
+    uint64 hash = 0;
+    String error;
+};
+
+// FNV-1a over the bits of the output samples, interleaved, so any change at
+// all shows.
+const uint64 initialHash = 14695981039346656037ULL;
+
+uint64 hashBlock(uint64 hash, const AudioSampleBuffer& buffer, int numSamples) {
+    for (int i = 0; i < numSamples; ++i) {
+        for (int channel = 0; channel < buffer.getNumChannels(); ++channel) {
+            uint32 bits;
+            float sample = buffer.getSample(channel, i);
+            memcpy(&bits, &sample, sizeof(bits));
+            for (int byte = 0; byte < 4; ++byte) {
+                hash ^= (bits >> (byte * 8)) & 0xFF;
+                hash *= 1099511628211ULL;
+            }
+        }
+    }
+    return hash;
+}
+
+String hashToString(uint64 hash) {
+    return String::toHexString((int64) hash).paddedLeft('0', 16);
+}
+
+bool readMidiFile(const File& file, MidiFile& midi) {
+    FileInputStream in(file);
+    if (in.failedToOpen() || !midi.readFrom(in))
+        return false;
+    midi.convertTimestampTicksToSeconds();
+    return true;
+}
+
+bool hasNotes(const MidiMessageSequence& sequence) {
+    for (int i = 0; i < sequence.getNumEvents(); ++i)
+        if (sequence.getEventPointer(i)->message.isNoteOn())
+            return true;
+    return false;
+}
+
+// The reference sequences --regression renders, on MIDI channel 1.
+void addNote(MidiMessageSequence& sequence, int note, int velocity, double start, double length) {
+    sequence.addEvent(MidiMessage::noteOn(1, note, (uint8) velocity), start);
+    sequence.addEvent(MidiMessage::noteOff(1, note), start + length);
+}
+
+void addRegressionJobs(OwnedArray<RenderJob>& jobs, const Options& options) {
+    auto addJob = [&](const String& name) -> MidiMessageSequence& {
+        auto* job = jobs.add(new RenderJob());
+        job->name = name;
+        if (options.outputDirectory != File())
+            job->outputFile = options.outputDirectory.getChildFile(name + ".wav");
+        return job->sequence;
+    };
+
+    // Every key, at velocities spread over the range.
+    auto& scale = addJob("scale");
+    for (int note = 21; note <= 108; ++note)
+        addNote(scale, note, 1 + (note * 37) % 127, (note - 21) * 0.15, 0.12);
+
+    // Overlapping chords under the sustain pedal, then released together.
+    auto& chords = addJob("chords");
+    chords.addEvent(MidiMessage::controllerEvent(1, 64, 127), 0.0);
+    const int roots[] = { 36, 43, 48, 53, 60, 67 };
+    for (int i = 0; i < 6; ++i)
+        for (int interval : { 0, 4, 7, 12 })
+            addNote(chords, roots[i] + interval, 60 + i * 10, i * 0.8, 0.4);
+    chords.addEvent(MidiMessage::controllerEvent(1, 64, 0), 5.5);
+
+    // A held note bent all the way up, down, and back.
+    auto& bend = addJob("bend");
+    addNote(bend, 60, 100, 0.0, 3.0);
+    for (int step = 0; step <= 240; ++step) {
+        double phase = step / 240.0;
+        double wheel = phase < 0.25 ? phase * 4.0 : phase < 0.75 ? 2.0 - phase * 4.0 : phase * 4.0 - 4.0;
+        bend.addEvent(MidiMessage::pitchWheel(1, jlimit(0, 16383, 8192 + (int) (wheel * 8191.0))), 0.2 + step * 0.01);
+    }
+
+    // One key struck again before each strike has died away.
+    auto& repeats = addJob("repeats");
+    for (int i = 0; i < 40; ++i)
+        addNote(repeats, 64, i % 2 == 0 ? 110 : 50, i * 0.03, 0.02);
+
+    // Every key twice under the pedal: more notes than voices, so some are
+    // stolen.
+    auto& cluster = addJob("cluster");
+    cluster.addEvent(MidiMessage::controllerEvent(1, 64, 127), 0.0);
+    for (int pass = 0; pass < 2; ++pass)
+        for (int note = 21; note <= 108; ++note)
+            addNote(cluster, note, 90, pass * 0.5 + (note - 21) * 0.001, 0.3);
+    cluster.addEvent(MidiMessage::controllerEvent(1, 64, 0), 2.0);
+}
+
+// Compares the jobs' hashes with those in the regression file, or with
+// --update rewrites it.  Returns the number that differ.
+int checkRegression(const OwnedArray<RenderJob>& jobs, const Options& options) {
+    if (options.updateRegression) {
+        String text = "# SFZero Render --regression hashes for " + options.instrument.getFileName() + "\n";
+        for (auto* job : jobs)
+            text << job->name << " " << hashToString(job->hash) << "\n";
+        if (!options.regressionFile.replaceWithText(text)) {
+            std::cout << "couldn't write " << options.regressionFile.getFullPathName() << "\n";
+            return 1;
+        }
+        std::cout << "Wrote " << jobs.size() << " hash(es) to " << options.regressionFile.getFullPathName() << "\n";
+        return 0;
+    }
+
+    StringPairArray expected;
+    StringArray lines;
+    lines.addLines(options.regressionFile.loadFileAsString());
+    for (auto& line : lines)
+        if (line.trim().isNotEmpty() && !line.startsWith("#"))
+            expected.set(line.upToFirstOccurrenceOf(" ", false, false),
+                         line.fromFirstOccurrenceOf(" ", false, false).trim());
+
+    int numChanged = 0;
+    for (auto* job : jobs) {
+        String hash = hashToString(job->hash);
+        String was = expected[job->name];
+        if (was == hash)
+            continue;
+        std::cout << "  " << job->name << ": " << (was.isEmpty() ? String("no hash to compare with") : "was " + was)
+                  << ", now " << hash << "\n";
+        ++numChanged;
+    }
+    std::cout << (numChanged == 0 ? String("Regression check passed") : String(numChanged) + " of "
+                  + String(jobs.size()) + " outputs changed") << "\n";
+    return numChanged;
+}
+
+void render(RenderJob& job, const Options& options) {
+    MidiMessageSequence sequence;
+    if (job.midiFile == File()) {
+        sequence = job.sequence;
+    } else {
+        MidiFile midi;
+        if (!readMidiFile(job.midiFile, midi)) {
+            job.error = "couldn't read " + job.midiFile.getFullPathName();
+            return;
+        }
+        for (int track = 0; track < midi.getNumTracks(); ++track)
+            if (job.track < 0 || track == job.track)
+                sequence.addSequence(*midi.getTrack(track), 0.0);
+    }
+    sequence.sort();
+
+    sfzero::SFZeroAudioProcessor processor;
+    File instrument = options.instrument;
+    processor.setSfzFile(&instrument);
+    sfzero::Sound* sound = processor.getSound();
+    if (sound == nullptr || sound->getErrors().size() > 0) {
+        job.error = "couldn't load " + instrument.getFullPathName()
+                    + (sound ? ": " + sound->getErrors().joinIntoString("; ") : String());
+        return;
+    }
+    if (options.preset != 0)
+        sound->useSubsound(options.preset);
+    processor.setFixedPointPhase(options.fixedPoint);
+
+    WavAudioFormat wav;
+    std::unique_ptr<AudioFormatWriter> writer;
+    if (job.outputFile != File()) {
+        job.outputFile.getParentDirectory().createDirectory();
+        job.outputFile.deleteFile();
+        writer.reset(wav.createWriterFor(job.outputFile.createOutputStream(), options.sampleRate, 2, 24,
+                                         StringPairArray(), 0));
+        if (writer == nullptr) {
+            job.error = "couldn't write " + job.outputFile.getFullPathName();
+            return;
+        }
+    }
+
+    // Events go into each block at the sample they fall on.
+    double start = Time::getMillisecondCounterHiRes();
+    processor.prepareToPlay(options.sampleRate, options.blockSize);
+    AudioSampleBuffer buffer(2, options.blockSize);
+    MidiBuffer midiBlock;
+    int64 lastEventSample = (int64) (sequence.getEndTime() * options.sampleRate + 0.5);
+    int64 maxEndSample = lastEventSample + (int64) (options.maxTailSeconds * options.sampleRate);
+    int nextEvent = 0;
+    int64 position = 0;
+    job.hash = initialHash;
+    for (;;) {
+        midiBlock.clear();
+        for (; nextEvent < sequence.getNumEvents(); ++nextEvent) {
+            const MidiMessage& message = sequence.getEventPointer(nextEvent)->message;
+            int64 eventSample = (int64) (message.getTimeStamp() * options.sampleRate + 0.5);
+            if (eventSample >= position + options.blockSize)
+                break;
+            if (!message.isMetaEvent())
+                midiBlock.addEvent(message, (int) jmax((int64) 0, eventSample - position));
+        }
+
+        processor.processBlock(buffer, midiBlock);
+        job.hash = hashBlock(job.hash, buffer, options.blockSize);
+        if (writer != nullptr)
+            writer->writeFromAudioSampleBuffer(buffer, 0, options.blockSize);
+        position += options.blockSize;
+
+        if (position > lastEventSample && (processor.numVoicesUsed() == 0 || position >= maxEndSample))
+            break;
+    }
+    processor.releaseResources();
+
+    job.renderSeconds = (Time::getMillisecondCounterHiRes() - start) / 1000.0;
+    job.audioSeconds = position / options.sampleRate;
+}
+
+String speed(double audioSeconds, double renderSeconds) {
+    return renderSeconds > 0.0 ? String(audioSeconds / renderSeconds, 1) + "x real time" : String("-");
+}
+
+} // namespace
+
+//==============================================================================
+
+int main(int argc, char* argv[]) {
+    StringArray args(argv + 1, argc - 1);
+    Options options;
+    Array<File> midiFiles;
+    for (int i = 0; i < args.size(); ++i) {
+        bool hasValue = i + 1 < args.size();
+        if (args[i] == "--output" && hasValue)
+            options.outputDirectory = File::getCurrentWorkingDirectory().getChildFile(args[++i]);
+        else if (args[i] == "--preset" && hasValue)
+            options.preset = jmax(0, args[++i].getIntValue());
+        else if (args[i] == "--rate" && hasValue)
+            options.sampleRate = jlimit(8000.0, 384000.0, args[++i].getDoubleValue());
+        else if (args[i] == "--block" && hasValue)
+            options.blockSize = jlimit(1, 8192, args[++i].getIntValue());
+        else if (args[i] == "--tail" && hasValue)
+            options.maxTailSeconds = jmax(0.0, args[++i].getDoubleValue());
+        else if (args[i] == "--jobs" && hasValue)
+            options.numJobs = jmax(1, args[++i].getIntValue());
+        else if (args[i] == "--tracks")
+            options.splitTracks = true;
+        else if (args[i] == "--fixed-point")
+            options.fixedPoint = true;
+        else if (args[i] == "--regression" && hasValue)
+            options.regressionFile = File::getCurrentWorkingDirectory().getChildFile(args[++i]);
+        else if (args[i] == "--update")
+            options.updateRegression = true;
+        else if (options.instrument == File())
+            options.instrument = File::getCurrentWorkingDirectory().getChildFile(args[i]);
+        else
+            midiFiles.add(File::getCurrentWorkingDirectory().getChildFile(args[i]));
+    }
+    bool regression = options.regressionFile != File();
+    if (!options.instrument.existsAsFile() || midiFiles.isEmpty() == !regression
+        || (regression && !options.updateRegression && !options.regressionFile.existsAsFile())) {
+        std::cout << "usage: SFZero Render <instrument.sfz|.sf2|.sf3> <file.mid>... [--output DIR] [--preset N]\n"
+                     "                     [--rate HZ] [--block N] [--tail SECONDS] [--tracks] [--jobs N]\n"
+                     "                     [--fixed-point]\n"
+                     "       SFZero Render <instrument.sfz|.sf2|.sf3> --regression FILE [--update] [--output DIR]\n"
+                     "                     [--preset N] [--jobs N]\n";
+        return 1;
+    }
+
+    OwnedArray<RenderJob> jobs;
+    if (regression) {
+        // Fixed, so the hashes only change when the output does.
+        options.sampleRate = 48000.0;
+        options.blockSize = 256;
+        options.maxTailSeconds = 10.0;
+        options.fixedPoint = true;
+        addRegressionJobs(jobs, options);
+    }
+    for (auto& midiFile : midiFiles) {
+        File directory = options.outputDirectory == File() ? midiFile.getParentDirectory() : options.outputDirectory;
+        if (!options.splitTracks) {
+            auto* job = jobs.add(new RenderJob());
+            job->midiFile = midiFile;
+            job->outputFile = directory.getChildFile(midiFile.getFileNameWithoutExtension() + ".wav");
+            continue;
+        }
+
+        MidiFile midi;
+        if (!readMidiFile(midiFile, midi)) {
+            std::cout << "couldn't read " << midiFile.getFullPathName() << "\n";
+            return 1;
+        }
+        for (int track = 0; track < midi.getNumTracks(); ++track) {
+            if (!hasNotes(*midi.getTrack(track)))
+                continue;
+            auto* job = jobs.add(new RenderJob());
+            job->midiFile = midiFile;
+            job->track = track;
+            job->outputFile = directory.getChildFile(midiFile.getFileNameWithoutExtension() + " track "
+                                                     + String(track + 1) + ".wav");
+        }
+    }
+
+    int numJobs = options.numJobs > 0 ? options.numJobs : jmax(1, SystemStats::getNumCpus());
+    std::cout << "Rendering " << jobs.size() << " file(s) with " << options.instrument.getFileName() << " at "
+              << options.sampleRate << " Hz, " << options.blockSize << "-sample blocks, " << numJobs << " at a time\n";
+
+    double start = Time::getMillisecondCounterHiRes();
+    {
+        ThreadPool pool(numJobs);
+        for (auto* job : jobs)
+            pool.addJob([job, &options]() { render(*job, options); });
+        while (pool.getNumJobs() > 0)
+            Thread::sleep(10);
+    }
+    double wallSeconds = (Time::getMillisecondCounterHiRes() - start) / 1000.0;
+
+    int numFailed = 0;
+    double audioSeconds = 0.0;
+    for (auto* job : jobs) {
+        String name = job->name.isNotEmpty() ? job->name : job->outputFile.getFullPathName();
+        if (job->error.isNotEmpty()) {
+            std::cout << "  " << name << ": " << job->error << "\n";
+            ++numFailed;
+            continue;
+        }
+        audioSeconds += job->audioSeconds;
+        std::cout << "  " << name << ": " << String(job->audioSeconds, 1) << " s in "
+                  << String(job->renderSeconds, 2) << " s, " << speed(job->audioSeconds, job->renderSeconds)
+                  << (options.fixedPoint ? ", hash " + hashToString(job->hash) : String()) << "\n";
+    }
+    std::cout << "Total: " << String(audioSeconds, 1) << " s of audio in " << String(wallSeconds, 2) << " s, "
+              << speed(audioSeconds, wallSeconds) << "\n";
+    if (numFailed > 0)
+        return 1;
+    return regression && checkRegression(jobs, options) > 0 ? 1 : 0;
+}